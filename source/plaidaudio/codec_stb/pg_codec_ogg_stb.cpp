@@ -3,6 +3,7 @@
 #include <cstring>
 #include <fstream>
 #include <cstdio>
+#include <memory>
 
 
 #include <plaid/audio/implementation.h>
@@ -37,7 +38,16 @@ namespace plaidgadget
 
 				//OGG file
 				int error = 0;
-				ogg = stb_vorbis_open_filename(&name[0], &error, NULL);
+				//Files the host has in memory get decoded straight from there
+				source.reset(AudioCodec::Open(file));
+				if (source.get())
+				{
+					ogg = stb_vorbis_open_memory((unsigned char*) source->data(), int(source->size()), &error, NULL);
+				}
+				else
+				{
+					ogg = stb_vorbis_open_filename(&name[0], &error, NULL);
+				}
 				if (!ogg) {cout << " VORBIS FAIL" << endl; return;}
 				info = stb_vorbis_get_info(ogg);
 
@@ -144,6 +154,7 @@ namespace plaidgadget
 			AudioFormat output;
 
 			FILE *file;
+			std::unique_ptr<AudioFile> source;
 			stb_vorbis *ogg;
 			stb_vorbis_info info;
 		};
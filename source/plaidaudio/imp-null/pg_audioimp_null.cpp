@@ -0,0 +1,15 @@
+#include <plaid/audio.h>
+#include <plaid/audio/implementation.h>
+
+/*
+	An implementation layer with no device behind it, for builds that have
+		no audio library to link against.  Every system runs as if headless.
+*/
+
+namespace plaidgadget
+{
+	AudioImp *Implementation_Audio(Audio &audio, AudioScheduler &scheduler)
+	{
+		return Implementation_Dummy(audio, scheduler);
+	}
+}
@@ -1,6 +1,8 @@
 #include <cassert>
 #include <ctime>
 #include <cstring>
+#include <fstream>
+#include <vector>
 
 #include "audio.h"
 #include "implementation.h"
@@ -154,8 +156,135 @@ namespace plaidgadget
 		bool started;
 		float t;
 	};
+
+	AudioImp *Implementation_Dummy(Audio &audio, AudioScheduler &scheduler)
+	{
+		return new AudioImp_Dummy(audio, scheduler);
+	}
 }
 
+/*
+	Renders only when updated, for as long as asked, as fast as it can.
+
+	Time is counted in samples rendered.  It reads as the end of the block
+		the next update will render (plus half a sample, against rounding),
+		so the frame the scheduler queues in update() covers exactly the
+		audio rendered right after.
+*/
+class Audio::Offline : public AudioImp
+{
+public:
+	enum {BLOCK = 1024};
+
+	Offline(Audio &audio, AudioScheduler &scheduler, AudioFormat format,
+		const String &wavFile) :
+		AudioImp(audio, scheduler), last(0), output(format),
+		started(false), rendered(0), next(0), carry(0.0), bytes(0),
+		buffer(BLOCK * format.channels), mike(BLOCK, 0)
+	{
+		if (!output.channels || output.channels > PG_MAX_CHANNELS)
+			reportError(L"Invalid channel count for offline audio!");
+		step(1.0/60.0);
+
+		if (wavFile.length())
+		{
+			wav.open(ToStdString(wavFile).c_str(),
+				std::ios::out | std::ios::binary | std::ios::trunc);
+			if (!wav) reportWarning(L"Couldn't open WAV file for audio output");
+			else header();
+		}
+	}
+	virtual ~Offline()
+	{
+		//Now the sizes are known
+		if (wav.is_open()) {wav.seekp(0); header(); wav.close();}
+	}
+
+	virtual void startStream() {started = true;}
+	virtual AudioFormat format() {return output;}
+	virtual double time() {return (double(rendered + next) + .5) / output.rate;}
+	virtual float load() {return 0.0f;}
+
+	virtual void update()
+	{
+		last = 0;
+		if (!started) return;
+
+		Sint32 *out[PG_MAX_CHANNELS];
+		std::vector<Sint16> pcm(wav.is_open() ? BLOCK * output.channels : 0);
+		while (last < next)
+		{
+			Uint32 n = std::min(next - last, Uint32(BLOCK));
+			for (Uint32 c = 0; c < output.channels; ++c)
+				out[c] = &buffer[c * BLOCK];
+
+			double t = double(rendered + last) / output.rate;
+			scheduler.render(out, &mike[0], n, t, t + double(n) / output.rate);
+			last += n;
+
+			//Same 24->16 conversion as the device backends
+			if (wav.is_open())
+			{
+				for (Uint32 i = 0; i < n; ++i)
+					for (Uint32 c = 0; c < output.channels; ++c)
+				{
+					Sint32 samp = out[c][i] >> 8;
+					if (samp > +32767) samp = +32767;
+					if (samp < -32767) samp = -32767;
+					pcm[i * output.channels + c] = Sint16(samp);
+				}
+				write(&pcm[0], 2 * n * output.channels);
+			}
+		}
+		rendered += last;
+		step(1.0/60.0);
+	}
+
+	//Sets how far the next update renders.  Fractions of a sample carry over.
+	void step(double seconds)
+	{
+		double want = std::max(seconds, 0.0) * output.rate + carry;
+		next = Uint32(want);
+		carry = want - next;
+	}
+
+	Uint32 last;
+
+private:
+	void write(const void *data, Uint32 size)
+	{
+		wav.write((const char*) data, size);
+		bytes += size;
+	}
+
+	//Canonical 44-byte header; written with zero sizes, then patched
+	void header()
+	{
+		Uint32 rate = output.rate, channels = output.channels;
+		Uint8 h[44] = {'R','I','F','F', 0,0,0,0, 'W','A','V','E',
+			'f','m','t',' ', 16,0,0,0, 1,0, Uint8(channels),0};
+		Uint32 fields[4][2] = {{4, 36 + bytes}, {24, rate},
+			{28, rate * channels * 2}, {40, bytes}};
+		for (int f = 0; f < 4; ++f)
+			for (int i = 0; i < 4; ++i)
+				h[fields[f][0] + i] = Uint8(fields[f][1] >> (8*i));
+		h[32] = Uint8(channels * 2); h[34] = 16;
+		h[36] = 'd'; h[37] = 'a'; h[38] = 't'; h[39] = 'a';
+		wav.write((const char*) h, 44);
+	}
+
+	AudioFormat output;
+	bool started;
+	Uint64 rendered;
+	Uint32 next;
+	double carry;
+
+	std::ofstream wav;
+	Uint32 bytes;
+
+	std::vector<Sint32> buffer, mike;
+};
+
 class ExampleGen : public AudioStream
 {
 public:
@@ -246,23 +375,35 @@ private:
 class Audio::Scratch
 {
 public:
-	Scratch();
+	/*
+		Worst case the arena is sized for: how many scratch chunks can be
+			alive at once (nested mixers and effects each hold one), and how
+			long each one can be.  This matches the old 128K-sample default
+			at stereo.
+	*/
+	enum {MAX_DEPTH = 16, MAX_FRAMES = 4096};
+
+	Scratch(Uint32 channels);
 	~Scratch();
 
 	void alloc(Sint32 **ptr, Uint32 length, Uint32 channels);
 	void release(Sint32 **ptr);
 
-	typedef std::vector<Sint32> Buffer;
-	typedef std::map<Sint32*, Uint32> Allocs;
-	typedef Allocs::value_type Alloc;
+	//Readable from any thread
+	Uint32 size() const   {return Uint32(buffer.size());}
+	Uint32 peak() const   {return AtomicAcquire(highWater);}
+	Uint32 denied() const {return AtomicAcquire(failures);}
 
-	struct Back
-	{
-		Buffer buffer;
-		Allocs allocs;
-		Uint32 resize;
-	};
-	Back *back;
+private:
+	//Stacked allocations; a release that isn't on top is marked and popped
+	//	along with whatever is above it, once that goes.
+	enum {MAX_ALLOCS = 64};
+	struct Mark {Uint32 end; Sint32 *first; bool freed;};
+
+	std::vector<Sint32> buffer;
+	Mark marks[MAX_ALLOCS];
+	Uint32 depth, top;
+	volatile Uint32 highWater, failures;
 };
 
 
@@ -275,16 +416,32 @@ public:
 {
 	scheduler = new AudioScheduler(*this);
 
+	offline = NULL;
+
 	//headless = true;
 
 	if (headless)
 	{
-		imp = new AudioImp_Dummy(*this, *scheduler);
+		setup(new AudioImp_Dummy(*this, *scheduler));
 	}
 	else
 	{
-		imp = Implementation_Audio(*this, *scheduler);
+		setup(Implementation_Audio(*this, *scheduler));
 	}
+}
+
+#if !PLAIDGADGET
+Audio::Audio(AudioFormat format, String wavFile)
+{
+	scheduler = new AudioScheduler(*this);
+	offline = new Offline(*this, *scheduler, format, wavFile);
+	setup(offline);
+}
+#endif
+
+void Audio::setup(AudioImp *implementation)
+{
+	imp = implementation;
 
 	//Set up the scheduler
 	scheduler->setupFront(imp->format(), imp->time());
@@ -292,8 +449,8 @@ public:
 	vol = 1.0f;
 	master->volume(1.0f);
 
-	//Create scratch buffer
-	scratch = new Scratch;
+	//Create scratch buffer, before the audio thread can ask for any
+	scratch = new Scratch(imp->format().channels);
 
 	//Start the audio stream
 	imp->startStream();
@@ -332,6 +489,33 @@ float Audio::load()
 	return imp->load();
 }
 
+double Audio::time()
+{
+	return imp->time();
+}
+
+Uint32 Audio::render(double seconds)
+{
+	if (!offline) return 0;
+	offline->step(seconds);
+	update();
+	return offline->last;
+}
+
+AudioStats Audio::stats()
+{
+	AudioStats s = scheduler->stats;
+	s.scratchSize = scratch->size();
+	s.scratchPeak = scratch->peak();
+	s.scratchDenied = scratch->denied();
+	s.load = imp->load();
+	return s;
+}
+
+Uint32 Audio::scratchSize()   {return scratch->size();}
+Uint32 Audio::scratchPeak()   {return scratch->peak();}
+Uint32 Audio::scratchDenied() {return scratch->denied();}
+
 #if PLAIDGADGET
 void Audio::handle(Command &command)
 {
@@ -483,79 +667,54 @@ float plaidgadget::ToSemitones(float mult)
 //------------------------------------------------------------------------
 
 /*
-	A very simple nonfragmenting allocator designed for stack-type allocations.
+	A stack allocator for scratch space used by audio processors.
 
-	Used to get scratch space for audio processors.
+	Everything is allocated up front, so the audio thread never allocates,
+		locks or logs here; a request that doesn't fit is denied and counted,
+		which AudioChunk already treats as a failed scratch-alloc.
 */
-Audio::Scratch::Scratch()
+Audio::Scratch::Scratch(Uint32 channels) :
+	buffer(MAX_DEPTH * MAX_FRAMES * std::max(channels, Uint32(1))),
+	depth(0), top(0), highWater(0), failures(0)
 {
-	back = NULL;
 }
 
 Audio::Scratch::~Scratch()
 {
-	if (back) delete back;
 }
 
 void Audio::Scratch::alloc(Sint32 **ptr, Uint32 length, Uint32 channels)
 {
-	Uint32 size = length*channels;
+	//Keep each channel 16-byte aligned relative to the buffer
+	Uint32 stride = (length+3) & ~Uint32(3), size = stride*channels;
 	if (!size) return;
 
-	//Possibly initialize
-	if (!back)
+	Uint32 start = top, end = start+size;
+	if (end > buffer.size() || end < start || depth == MAX_ALLOCS)
 	{
-		back = new Back();
-		back->buffer.resize(1024*128); //1 MB, about 2.7 seconds at stereo 48K
-		back->resize = 0;
-	}
-
-	//Find starting position, after most recent alloc
-	Uint32 start = 0, end;
-	if (back->allocs.size()) start = back->allocs.rbegin()->second;
-	end = start+size;
-
-	//Is there enough space?
-	if (end > back->buffer.size())
-	{
-		std::cout << back->allocs.size()
-			<< " stacked allocs -- Expanding audio-scratch to "
-			<< ((end+1023)/1024) << " KB";
-
-		if (!start)
-		{
-			//Buffer is free; we can resize now
-			std::cout << " (immediate)" << std::endl;
-			back->buffer.resize(end);
-		}
-		else
-		{
-			//Unsafe to resize with buffer in use
-			std::cout << " (delayed)" << std::endl;
-			back->resize = std::max(back->resize, end);
-			return;
-		}
+		AtomicRelease(failures, failures+1);
+		return;
 	}
 
-	//Allocate
 	for (Uint32 i = 0; i < channels; ++i)
-		ptr[i] = &back->buffer[start + i*length];
-	back->allocs.insert(Alloc(ptr[0], end));
+		ptr[i] = &buffer[start + i*stride];
+
+	Mark mark = {end, ptr[0], false};
+	marks[depth++] = mark;
+	top = end;
+	if (top > highWater) AtomicRelease(highWater, top);
 }
+
 void Audio::Scratch::release(Sint32 **ptr)
 {
-	Allocs::iterator i = back->allocs.find(ptr[0]);
-	if (i == back->allocs.end())
-	{
-		std::cout << "WARNING: NO SUCH ALLOC ON AUDIO SCRATCH" << std::endl;
-		return;
-	}
-	back->allocs.erase(i);
-	if (back->allocs.size() == 0 && back->resize)
-	{
-		back->buffer.resize(back->resize);
-		back->resize = 0;
-	}
+	//Normally the most recent allocation; scan down in case it isn't
+	Uint32 i = depth;
+	while (i && marks[i-1].first != ptr[0]) --i;
+	if (!i) return;
+	marks[i-1].freed = true;
+
+	while (depth && marks[depth-1].freed) --depth;
+	top = depth ? marks[depth-1].end : 0;
 }
 
 void Audio::alloc  (Sint32 **p, Uint32 s, Uint32 c)  {scratch->alloc(p,s,c);}
@@ -603,6 +762,7 @@ typedef std::map<String, AudioCodec*> Codecs;
 typedef Codecs::value_type Codec;
 static Codecs &codecRegistry() {static Codecs c; return c;}
 static bool &lockCodecs() {static bool b = false; return b;}
+static AudioCodec::Opener &codecOpener() {static AudioCodec::Opener o = NULL; return o;}
 
 AudioCodec::AudioCodec(String ext)
 {
@@ -631,6 +791,17 @@ void AudioCodec::LockRegistry()
 	lockCodecs() = true;
 }
 
+void AudioCodec::SetOpener(Opener opener)
+{
+	codecOpener() = opener;
+}
+
+AudioFile *AudioCodec::Open(const String &file)
+{
+	Opener opener = codecOpener();
+	return opener ? opener(file) : NULL;
+}
+
 
 AudioCodec *AudioCodec::Find(const String &file)
 {
@@ -32,6 +32,34 @@ namespace plaidgadget
 	class File;
 #endif
 
+	/*
+		Render statistics, gathered from the report the audio thread sends
+			back after each callback.  Counts are totals since startup.
+
+		Callback times are bucketed by powers of two microseconds: bucket i
+			holds callbacks that took under 2^i us (and at least half that),
+			and the last bucket also takes anything slower.
+	*/
+	struct AudioStats
+	{
+		enum {BUCKETS = 16};
+
+		Uint32 callbacks;
+		Uint32 lost;              //Reports the audio thread had to drop
+		Uint32 histogram[BUCKETS];
+		double average, longest;  //Callback time, in seconds
+
+		Uint32 underflows;        //Callbacks that ran out of queued frames
+		Uint32 overflows;         //Callbacks that trimmed frames to catch up
+		Uint64 padded, trimmed;   //Samples affected by each of the above
+
+		Uint32 voices, peakVoices;       //Heard in the last callback, and ever
+		double pullAverage, pullLongest; //Time to pull one voice, in seconds
+
+		Uint32 scratchSize, scratchPeak, scratchDenied;
+		float load;
+	};
+
 	/*
 		Provides audio functionality, either through its own simple interface
 			or through the highly flexible streams system which allows user-made
@@ -50,6 +78,14 @@ namespace plaidgadget
 #else
 		//Standalone audio system
 		Audio(bool headless = false);
+
+		/*
+			Offline audio system, with no device behind it.  Audio is rendered
+				only when updated, as fast as the CPU allows, and time is
+				measured in samples rendered.  If a filename is given, all
+				output is recorded there as a 16-bit WAV file.
+		*/
+		Audio(AudioFormat format, String wavFile = String());
 #endif
         virtual ~Audio();
 
@@ -78,6 +114,23 @@ namespace plaidgadget
         //Get audio stream CPU load -- keep this well under 1.0!
         float load();
 
+        //Audio device clock, in seconds.  Advances with playback only.
+        double time();
+
+        //Render statistics, as of the last update().
+        AudioStats stats();
+
+        //Offline systems only: update, rendering the given number of seconds
+        //  as a single frame.  Returns samples per channel rendered.
+        //  (A plain update() renders 1/60th of a second.)
+        Uint32 render(double seconds);
+
+        //Audio-scratch use, in samples: the arena's fixed size, the most it
+        //  has held at once, and how many requests it had to turn down.
+        Uint32 scratchSize();
+        Uint32 scratchPeak();
+        Uint32 scratchDenied();
+
 
         //Buffer a file or prep it for streaming.
 		//  (These return null sounds when loading fails)
@@ -105,7 +158,11 @@ namespace plaidgadget
 #endif
 
 	private:
+		void setup(AudioImp *implementation);
+
 		AudioImp *imp;
+		class Offline;
+		Offline *offline;
 		AudioScheduler *scheduler;
 		Mixer *master;
 		float vol;
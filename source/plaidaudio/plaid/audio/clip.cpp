@@ -1,5 +1,3 @@
-#include <iostream>
-
 #include "clip.h"
 
 
@@ -47,9 +45,9 @@ AudioClip::~AudioClip()
 	}
 }
 
-Ref<AudioClip::Player> AudioClip::player(bool loop)
+Ref<AudioClip::Player> AudioClip::player(bool loop, Uint32 start)
 {
-	return Ref<Player>(new Player(this, loop));
+	return Ref<Player>(new Player(this, loop, start));
 }
 
 bool AudioClip::locked()
@@ -95,7 +93,6 @@ float AudioClip::load(Audio &audio, Sound sound, float limit)
 		AudioChunk chunk(audio, data->format, chanPtr, amt, frame, 0.0f, 1.0f);
 		source.tick(frame);
 		source.pull(chunk);
-		std::cout << ".";
 
 		//Determine amount of audio received
 		got = (source.exhausted() ? chunk.cutoff() : amt);
@@ -123,8 +120,6 @@ float AudioClip::load(Audio &audio, Sound sound, float limit)
 	//Block further editing for now
 	data->locks++;
 
-	std::cout << "loaded " << total << " samples." << std::endl;
-
 	return total / float(data->format.rate);
 }
 
@@ -136,7 +131,7 @@ float AudioClip::load(Audio &audio, Sound sound, float limit)
 }*/
 
 
-AudioClip::Player::Player(AudioClip *_clip, bool _loop) :
+AudioClip::Player::Player(AudioClip *_clip, bool _loop, Uint32 start) :
 	loop(_loop)
 {
 	if (!_clip)
@@ -153,6 +148,24 @@ AudioClip::Player::Player(AudioClip *_clip, bool _loop) :
 	pos = 0;
 	frac = 0.0f;
 
+	//Start partway through by walking the link chain; past the end is done
+	Uint32 length = clip->data->length;
+	if (start && length)
+	{
+		if (loop) start %= length;
+		if (start < length)
+		{
+			pos = start;
+			for (Uint32 c = 0; c < clip->data->format.channels; ++c)
+			{
+				link[c] = clip->data->root[c];
+				for (Uint32 i = start / (Link::SIZE/4); i; --i)
+					link[c] = link[c]->next;
+			}
+		}
+		else pos = length;
+	}
+
 	++clip->data->locks;
 }
 AudioClip::Player::~Player()
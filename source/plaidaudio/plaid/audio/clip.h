@@ -31,7 +31,8 @@ namespace plaidgadget
 		class Player : public AudioStream
 		{
 		public:
-			Player(AudioClip *clip, bool loop = false);
+			//Playback begins 'start' samples in (wrapped around if looping).
+			Player(AudioClip *clip, bool loop = false, Uint32 start = 0);
 			virtual ~Player();
 
 		protected:
@@ -89,7 +90,7 @@ namespace plaidgadget
 			Create a player -- you may have as many as you like.
 				Players lock the AudioClip while they exist.
 		*/
-		Ref<Player> player(bool loop = false);
+		Ref<Player> player(bool loop = false, Uint32 start = 0);
 
 
 		/*
@@ -7,10 +7,98 @@
 #include "../bindings.h"
 #endif
 
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || \
+	(defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define PG_PITCH_SSE2
+	#include <emmintrin.h>
+#endif
+
 
 using namespace plaidgadget;
 
 
+namespace
+{
+	/*
+		Every resampler interpolates between in[LATENCY-1] and in[LATENCY]
+			of a window reaching LATENCY samples either side, so they all
+			have the same latency and can be switched mid-stream.  The last
+			MEMORY samples of each pull are kept for the next one.
+	*/
+	const Uint32 LATENCY = 16, MEMORY = 2*LATENCY;
+
+	/*
+		Polyphase windowed-sinc coefficients, one row per fractional position.
+
+		Pitching up squeezes the input's spectrum past the output's Nyquist
+			limit, so each band of rates gets its own table with the cutoff
+			lowered by 1/rate and the span widened by the same factor to keep
+			the transition sharp.  Rates above the last band alias somewhat.
+	*/
+	const Uint32 SINC_PHASES = 256, SINC_BANDS = 5, SINC_MAX_TAPS = 2*LATENCY;
+	const float  sincRates[SINC_BANDS] = {1.0f, 1.5f, 2.0f, 3.0f, 4.0f};
+	const Uint32 sincTaps[SINC_BANDS]  = {8, 16, 24, 32, 32};
+	float sincTable[SINC_BANDS][SINC_PHASES+1][SINC_MAX_TAPS];
+	bool sincReady = false;
+
+	void BuildSinc()
+	{
+		const double pi = 3.14159265358979323846;
+		for (Uint32 b = 0; b < SINC_BANDS; ++b)
+		{
+			Uint32 taps = sincTaps[b];
+			double cutoff = .92 / sincRates[b];
+			for (Uint32 p = 0; p <= SINC_PHASES; ++p)
+			{
+				double f = double(p) / SINC_PHASES, sum = 0.0, w[SINC_MAX_TAPS];
+				for (Uint32 k = 0; k < taps; ++k)
+				{
+					//Distance from the interpolation point; Blackman window
+					double x = double(k) - (double(taps/2 - 1) + f);
+					double t = pi * cutoff * x;
+					double sinc = (std::fabs(t) < 1e-9) ? 1.0 : std::sin(t)/t;
+					double n = (x + taps/2) / taps;
+					double win = (n <= 0.0 || n >= 1.0) ? 0.0 :
+						.42 - .5*std::cos(2*pi*n) + .08*std::cos(4*pi*n);
+					sum += (w[k] = sinc * win);
+				}
+				for (Uint32 k = 0; k < taps; ++k)
+					sincTable[b][p][k] = float(w[k] / sum);
+			}
+		}
+		sincReady = true;
+	}
+
+	//The narrowest band that filters enough for the rate.
+	Uint32 SincBand(double rate)
+	{
+		Uint32 b = 0;
+		while (b+1 < SINC_BANDS && rate > sincRates[b]) ++b;
+		return b;
+	}
+
+	//Taps is a multiple of 4; in points at the first of them.
+	inline float SincTap(const Sint32 *in, float f, Uint32 band, Uint32 taps)
+	{
+		const float *c = sincTable[band][Uint32(f * SINC_PHASES + .5f)];
+#ifdef PG_PITCH_SSE2
+		__m128 sum = _mm_setzero_ps();
+		for (Uint32 k = 0; k < taps; k += 4)
+			sum = _mm_add_ps(sum, _mm_mul_ps(
+				_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*) (in+k))),
+				_mm_loadu_ps(c+k)));
+		sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+		sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+		return _mm_cvtss_f32(sum);
+#else
+		float sum = 0.0f;
+		for (Uint32 k = 0; k < taps; ++k) sum += c[k] * float(in[k]);
+		return sum;
+#endif
+	}
+}
+
+
 #if PLAIDGADGET
 
 static Pitch *pitchFac2(Sound source, float rate)
@@ -53,8 +141,9 @@ static Bindings bindings(L"Audio_Pitch", pitchBindings);
 Pitch::Pitch(Signal source, float rate, Uint32 alg) :
 	AudioEffect<Pitch_Node>(source, Pitch_Node(rate, alg))
 {
-	offset = 0.0f;
-	for (int i = 4*source.format().channels; i--;) mem.push_back(0);
+	offset = 0.0;
+	mem.resize(MEMORY*source.format().channels, 0);
+	if (!sincReady) BuildSinc();
 }
 Pitch::~Pitch()
 {
@@ -66,32 +155,48 @@ void Pitch::resampling(Uint32 alg)
 }
 
 
+void Pitch::bypass(AudioChunk &chunk)
+{
+	//Snap to the nearest whole sample; the jump is a fraction of a sample
+	offset = 0.0;
+
+	Uint32 length = chunk.length(), chans = chunk.format().channels;
+	source.pull(chunk);
+	for (Uint32 i = 0; i < chans; ++i)
+	{
+		//Delay by LATENCY samples, same as the resamplers would
+		Sint32 *out = chunk.start(i), *history = &mem[MEMORY*i];
+		Sint32 tail[MEMORY];
+		std::memcpy((void*) tail, (void*) (out+length-MEMORY), 4*MEMORY);
+		std::memmove((void*) (out+LATENCY), (void*) out, 4*(length-LATENCY));
+		std::memcpy((void*) out, (void*) (history+MEMORY-LATENCY), 4*LATENCY);
+		std::memcpy((void*) history, (void*) tail, 4*MEMORY);
+	}
+}
+
 void Pitch::pull(AudioChunk &chunk, const Pitch_Node &a, const Pitch_Node &b)
 {
 	Uint32 length = chunk.length(), chan = source.format().channels;
+	if (!length) return;
 
-	/*{
-		static float sanity = 0.0f;
-		if (a.rate != sanity)
-			std::cout << "TIME BREAK " << sanity << " -> " << a.rate << std::endl;
-		sanity = b.rate;
-	}*/
+	//A rate of zero would break the geometric ramp, so treat it as very slow
+	double ra = std::max(a.rate, 1e-6f), rb = std::max(b.rate, 1e-6f);
 
-	//Compute rate and offset
-	float rate = a.rate, inc = std::pow(b.rate/a.rate, 1.0f/float(length));
-	float off = offset;
-
-	//"simulate" the render to figure out how many samples are needed.
-	Uint32 count = 0, steps;
-	for (Uint32 i = length; i--;)
+	if (ra == 1.0 && rb == 1.0 && length >= MEMORY)
 	{
-		off += rate; rate *= inc;
-		steps = off; off -= steps;
-		count += steps;
+		bypass(chunk);
+		return;
 	}
 
+	//The rate ramps geometrically across the chunk; the input consumed is
+	//	the sum of that series, which gives the count in closed form.
+	double inc = std::pow(rb/ra, 1.0/double(length));
+	double end = offset + ((std::fabs(inc-1.0) < 1e-9) ?
+		ra*double(length) : (rb - ra)/(inc - 1.0));
+	Uint32 count = Uint32(end);
+
 	//Allocate temp buffer from scratch pool; account for failure
-	AudioChunk sub(chunk.audio, source.format(), NULL, (4 + count),
+	AudioChunk sub(chunk.audio, source.format(), NULL, (MEMORY + count),
 		chunk.frame(), chunk.a(), chunk.b());
 	if (!sub.ok()) {chunk.silence(); return;}
 
@@ -101,58 +206,90 @@ void Pitch::pull(AudioChunk &chunk, const Pitch_Node &a, const Pitch_Node &b)
 		Sint32 *forward[PG_MAX_CHANNELS];
 		for (Uint32 i=0; i<chunk.format().channels; ++i)
 		{
-			std::memcpy((void*) sub.start(i), (void*) &mem[4*i], 4*4);
-			forward[i]=sub.start(i)+4;
+			std::memcpy((void*) sub.start(i), (void*) &mem[MEMORY*i], 4*MEMORY);
+			forward[i]=sub.start(i)+MEMORY;
 		}
 
 		//Fill rest of buffer with new data from source stream
-		AudioChunk subsub(chunk.audio, chunk.format(), forward, sub.length()-4,
+		AudioChunk subsub(chunk.audio, chunk.format(), forward, count,
 			sub.frame(), sub.a(), sub.b());
 		source.pull(subsub);
 
 		//Copy from end of buffer to memory
 		for (Uint32 i=0; i<chunk.format().channels; ++i)
 		{
-			std::memcpy((void*) &mem[4*i], (void*) (sub.end(i)-4), 4*4);
+			std::memcpy((void*) &mem[MEMORY*i], (void*) (sub.end(i)-MEMORY), 4*MEMORY);
+		}
+	}
+
+	//Work out where every output sample falls, once for all channels
+	if (index.size() < length) {index.resize(length); frac.resize(length);}
+	{
+		double pos = offset, rate = ra;
+		for (Uint32 j = 0; j < length; ++j)
+		{
+			pos += rate; rate *= inc;
+			Uint32 k = Uint32(pos);
+			float f = float(pos - double(k));
+			if (k > count) {k = count; f = 0.0f;}
+			index[j] = k;
+			frac[j] = (f < 1.0f) ? f : 0.0f;
 		}
 	}
+	offset = end - double(count);
 
 	//Resample
 	for (Uint32 i = 0; i < chan; ++i)
 	{
-		float c1, c2, c3;
-		rate = a.rate;
-		off = offset;
-		Sint32 *in = sub.start(i), *out = chunk.start(i), *end = chunk.end(i);
+		const Sint32 *in = sub.start(i);
+		Sint32 *out = chunk.start(i);
+		const Uint32 *k = &index[0];
+		const float *f = &frac[0];
 
-		while (out < end)
+		switch (b.alg)
 		{
-			//4-point, 3rd order hermite resampling
-			off += rate; rate *= inc;
-			steps = off; off -= steps;
-			in += steps;
-
-			//*data++ = s0;
-
-			/*sampL = l1*off + l0*(1.0f-off);
-			sampR = r1*off + r0*(1.0f-off);
-			*data++ = Sint16(sampL + .5f - (sampL < 0.0f));
-			*data++ = Sint16(sampR + .5f - (sampR < 0.0f));*/
-
-			c1 = .5f*(in[2]-in[0]);
-			c2 = in[0] - 2.5f*in[1] + 2.0f*in[2] - .5f*in[3];
-			c3 = .5f*(in[3]-in[0]) + 1.5f*(in[1]-in[2]);
-			*out = in[1] + ((c3*off+c2)*off+c1)*off;
+		case NONE:
+			for (Uint32 j = 0; j < length; ++j)
+				out[j] = in[k[j] + LATENCY-1 + (f[j] >= .5f)];
+			break;
+
+		case LINEAR:
+			for (Uint32 j = 0; j < length; ++j)
+			{
+				const Sint32 *w = in + k[j] + LATENCY-1;
+				out[j] = Sint32(w[0] + f[j]*float(w[1]-w[0]));
+			}
+			break;
+
+		case SINC:
+		{
+			Uint32 band = SincBand(std::max(ra, rb)), taps = sincTaps[band];
+			in += LATENCY - taps/2;
+			for (Uint32 j = 0; j < length; ++j)
+				out[j] = Sint32(SincTap(in + k[j], f[j], band, taps));
+			break;
+		}
 
-			++out;
+		default:
+			for (Uint32 j = 0; j < length; ++j)
+			{
+				//4-point, 3rd order hermite resampling
+				const Sint32 *w = in + k[j] + LATENCY-2;
+				float x = f[j], c1, c2, c3;
+				c1 = .5f*(w[2]-w[0]);
+				c2 = w[0] - 2.5f*w[1] + 2.0f*w[2] - .5f*w[3];
+				c3 = .5f*(w[3]-w[0]) + 1.5f*(w[1]-w[2]);
+				out[j] = Sint32(w[1] + ((c3*x+c2)*x+c1)*x);
+			}
+			break;
 		}
 	}
-
-	offset = off;
 }
 
 Pitch_Node Pitch::interpolate(const Pitch_Node &a, const Pitch_Node &b,
 	float mid)
 {
+	if (a.rate <= 0.0f || b.rate <= 0.0f)
+		return Pitch_Node(a.rate + (b.rate-a.rate)*mid, b.alg);
 	return Pitch_Node(a.rate*std::pow(b.rate/a.rate, mid), b.alg);
 }
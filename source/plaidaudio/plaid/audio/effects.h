@@ -125,7 +125,9 @@ namespace plaidgadget
 			NONE=0, //Bottom-of-the-barrel
 			LINEAR=1, //Low-quality linear
 			HERMITE=2, HERMITE_43=2, //4-point 3rd order hermite.
-			//Coming: sinc interpolation
+			SINC=3, //Windowed sinc, 256 phases, band-limited for the rate.
+			        //  8 taps up to a rate of 1, 32 from a rate of 3.
+			        //  Best and slowest.
 			};
 
 	public:
@@ -153,8 +155,15 @@ namespace plaidgadget
 		virtual void effectTick(Uint64) {}
 
 	private:
-		float offset;
+		//Pass-through for a rate of exactly 1.0
+		void bypass(AudioChunk &chunk);
+
+		double offset;
 		std::vector<Sint32> mem;
+
+		//Where each output sample falls in the input, shared by all channels
+		std::vector<Uint32> index;
+		std::vector<float> frac;
 	};
 
 
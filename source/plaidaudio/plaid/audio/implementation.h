@@ -43,6 +43,10 @@ namespace plaidgadget
 
 		Sound microphone();
 
+		//Totals built up from MixReports, in the game thread
+		AudioStats stats;
+		Uint64 renderTicks, pullTicks, pulls;
+
 		Audio      &audio;
 		AudioImp   *imp;
 		AudioFormat format;
@@ -101,6 +105,23 @@ namespace plaidgadget
 	// This function is called to instantiate the audio implementation.
 	AudioImp *Implementation_Audio(Audio &audio, AudioScheduler &scheduler);
 
+	// The silent implementation headless systems use, with no device at all.
+	AudioImp *Implementation_Dummy(Audio &audio, AudioScheduler &scheduler);
+
+
+	/*
+		A file the host application already has in memory, such as one
+			packed in an archive.  Codecs free it when they're done decoding.
+	*/
+	class AudioFile
+	{
+	public:
+		virtual ~AudioFile() {}
+
+		virtual const void *data() = 0;
+		virtual Uint32 size() = 0;
+	};
+
 
 	/*
 		Declare a global static instance of your AudioCodec subclass in its
@@ -120,6 +141,16 @@ namespace plaidgadget
 
 		static AudioCodec *Find(const String &ext);
 
+		/*
+			The host can hand codecs files from memory instead of the disk.
+			The opener returns NULL for files it doesn't have, and Open()
+				returns NULL if there is no opener, so codecs fall back to
+				reading the file themselves.
+		*/
+		typedef AudioFile *(*Opener)(const String &file);
+		static void SetOpener(Opener opener);
+		static AudioFile *Open(const String &file);
+
 		virtual Sound stream(const String &file, bool loop) = 0;
 	};
 }
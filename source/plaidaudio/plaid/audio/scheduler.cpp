@@ -1,6 +1,5 @@
-#include <iomanip>
 #include <cstring>
-#include <fstream>
+#include <algorithm>
 #include <vector>
 #include <deque>
 #include <iostream>
@@ -13,13 +12,7 @@
 #endif //PLAIDGADGET
 
 #include "../thread/lockfree.h"
-
-/*
-	Change this to 1 to duplicate all audio output into a PCM file.
-		This may cause performance issues with audio rendering.
-*/
-#define PCM_OUT 0
-
+#include "../util/clock.h"
 
 using namespace std;
 
@@ -28,6 +21,8 @@ namespace plaidgadget
 {
 	struct AudioScheduler::Front
 	{
+		Front() : frames(256) {}
+
 		//Frame timing
 		Uint64 prepFrame;
 
@@ -37,9 +32,22 @@ namespace plaidgadget
 
 	struct AudioScheduler::Back
 	{
+		//The mixer drops reports rather than allocating when the game thread
+		//	falls behind, and says how many went missing in the next one.
+		Back() : feedback(64, QUEUE_REJECT), lost(0) {}
+
+		//Sent back to the game thread after every render
+		struct MixReport
+		{
+			Uint32 lost;              //Reports dropped since the last one
+			Uint32 padded, trimmed;   //Samples rendered with no frame, or cut
+			Uint32 voices, pulls;
+			Uint64 duration, pullTotal, pullSlowest; //Clock ticks
+		};
+
 		//Queues from the audio mixer back to the game thread (shared)
-		struct MixReport {char rep[120];};
 		LockFreeQueue<MixReport> feedback;
+		Uint32 lost;
 
 		//Frame timing
 		std::deque<double> queued;
@@ -56,10 +64,6 @@ namespace plaidgadget
 		const Sint32 *mikeData;
 		Uint32 mikeLength;
 		Uint32 mikeFrame;
-
-#if PCM_OUT
-		std::ofstream pcmOut;
-#endif
 	};
 
 
@@ -126,14 +130,13 @@ AudioScheduler::AudioScheduler(Audio &_audio) :
 	front = NULL;
 	back = NULL;
 	master = NULL;
+
+	std::memset(&stats, 0, sizeof(stats));
+	renderTicks = pullTicks = pulls = 0;
 }
 
 AudioScheduler::~AudioScheduler()
 {
-#if PCM_OUT
-	pcmOut.close();
-#endif
-
 	delete front;
 	delete back;
 }
@@ -169,10 +172,6 @@ void AudioScheduler::setupBack(double time)
 	back->frameSamples = back->leftover = 0;
 	back->frameCut = 0.0f;
 
-#if PCM_OUT
-	data->pcmOut.open("pg.pcm", ios_base::out|ios_base::binary|ios_base::trunc);
-#endif
-
 	//Microphone buffers
 	back->mikeData = NULL;
 	back->mikeLength = 0;
@@ -201,9 +200,34 @@ void AudioScheduler::tick(double time)
 		Back::MixReport rep;
 		while (back->feedback.pull(rep))
 		{
+			++stats.callbacks;
+			stats.lost += rep.lost;
+
+			double seconds = ClockSeconds(rep.duration);
+			Uint32 bucket = 0;
+			while (bucket < AudioStats::BUCKETS-1 &&
+				seconds * 1e6 >= double(1u << bucket)) ++bucket;
+			++stats.histogram[bucket];
+			renderTicks += rep.duration;
+			stats.average = ClockSeconds(renderTicks) / stats.callbacks;
+			stats.longest = std::max(stats.longest, seconds);
+
+			if (rep.padded) {++stats.underflows; stats.padded += rep.padded;}
+			if (rep.trimmed) {++stats.overflows; stats.trimmed += rep.trimmed;}
+
+			stats.voices = rep.voices;
+			stats.peakVoices = std::max(stats.peakVoices, rep.voices);
+			pulls += rep.pulls;
+			pullTicks += rep.pullTotal;
+			if (pulls) stats.pullAverage = ClockSeconds(pullTicks) / pulls;
+			stats.pullLongest = std::max(stats.pullLongest,
+				ClockSeconds(rep.pullSlowest));
+
 #if PLAIDGADGET
 			if (audio.console.monitoring())
-				std::cout << "audio: " << rep.rep << std::endl;
+				std::cout << "audio: " << (seconds*1e3) << "ms, "
+					<< rep.voices << " voices, +" << rep.padded
+					<< " -" << rep.trimmed << std::endl;
 #endif // PLAIDGADGET
 		}
 	}
@@ -222,12 +246,17 @@ void AudioScheduler::render(Sint32 **speaker, const Sint32 *microphone,
 	}*/
 
 
+	Uint64 started = ClockTicks();
+
 	//Possibly setup backend data
 	if (!back)
 	{
 		setupBack(time);
 	}
 
+	Back::MixReport rep;
+	std::memset(&rep, 0, sizeof(rep));
+
 
 	//Microphone stuff
 	back->mikeData = microphone;
@@ -244,11 +273,6 @@ void AudioScheduler::render(Sint32 **speaker, const Sint32 *microphone,
 		pos[i] = speaker[i];
 	}
 
-	//A little output
-	std::stringstream mixReport;
-	mixReport << std::setw(5) << require << ' ';
-
-
 	//Main rendering loop
 	while (require)
 	{
@@ -304,6 +328,7 @@ void AudioScheduler::render(Sint32 **speaker, const Sint32 *microphone,
 					int(back->overflow));
 				back->frameSamples -= reduc;
 				back->overflow -= reduc;
+				rep.trimmed += reduc;
 			}
 
 			//And prep...
@@ -317,7 +342,6 @@ void AudioScheduler::render(Sint32 **speaker, const Sint32 *microphone,
 		if (length > require)
 		{
 			//We can't fit this whole frame in...
-			mixReport << (back->leftover?'-':'[');
 			back->leftover = length - require;
 			b = back->frameCut = 1.0f-back->leftover/float(back->frameSamples);
 			length = require;
@@ -325,7 +349,6 @@ void AudioScheduler::render(Sint32 **speaker, const Sint32 *microphone,
 		else
 		{
 			//Smooth sailing.
-			mixReport << (back->leftover?']':'#');
 			b = 1.0f;
 			back->leftover = 0;
 		}
@@ -345,7 +368,7 @@ void AudioScheduler::render(Sint32 **speaker, const Sint32 *microphone,
 	if (require)
 	{
 		//EXTRA RENDARR
-		mixReport << "+" << require;
+		rep.padded = require;
 		if (back->leftover) std::cout <<
 			"FRAME LEFTOVER DETECTED DURING EXTRA-MIX" << std::endl;
 		AudioChunk chunk(audio, format, pos, require,
@@ -361,37 +384,21 @@ void AudioScheduler::render(Sint32 **speaker, const Sint32 *microphone,
 		while (front->frames.pull(hold)) back->queued.push_back(hold);
 	}
 
-	mixReport << " // ";
-
 	//Calculate overflow (tolerance of one frame-length)
 	if (back->queued.size() > 1)
 	{
 		back->overflow = format.rate*(*(back->queued.end()-2)-back->lastFrame);
-		mixReport << " -" << std::setw(5) << back->overflow;
-	}
-	/*mixReport << " LATENCY > " << fixed << setprecision(2)
-		<< (capTime-back->lastFrame);*/
-	if (back->queued.size())
-	{
-		double waste = back->queued.back()-back->lastFrame;
-		mixReport << ", WASTE = " << waste;
 	}
 
 
-#if PCM_OUT
-	//DEBUG OUTPUT
-	pcmOut.write((const char*) outBuffer, obSize);
-#endif
-
-
-	/*if (Pa_GetStreamTime(stream) > criticalTime)
-		mixReport << " (LATE FOR CAPTURE!)";
-	if (obFill != obSize) mixReport << " (INCOMPLETE RENDER)";*/
-
-
 	//Compose report and send back
-	std::string s = mixReport.str();
-	Back::MixReport rep;
-	std::memcpy(rep.rep, s.c_str(), std::min(s.length()+1,size_t(120)));
-	back->feedback.push(rep);
+	Mixer::PullStats pull = master->takePullStats();
+	rep.voices = pull.voices;
+	rep.pulls = pull.pulls;
+	rep.pullTotal = pull.total;
+	rep.pullSlowest = pull.slowest;
+	rep.lost = back->lost;
+	rep.duration = ClockTicks() - started;
+	if (back->feedback.push(rep)) back->lost = 0;
+	else ++back->lost;
 }
@@ -104,8 +104,8 @@ namespace plaidgadget
 				(usually what you want for mixers/effects)
 
 				*** NOTE ***
-				The scratch pool can't be resized while it's in use.
-				Thus, it's possible for an allocation to be denied.
+				The scratch pool is a fixed-size stack, sized before the audio
+				thread starts.  Thus, it's possible for an allocation to be denied.
 				This will produce a NULL-data, 0-length chunk.
 				Account for this in your code!
 		*/
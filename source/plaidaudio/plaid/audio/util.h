@@ -3,6 +3,7 @@
 
 
 #include "../thread/lockfree.h"
+#include <list>
 #include <map>
 #include <vector>
 
@@ -64,6 +65,19 @@ namespace plaidgadget
 		//Check if mixer is clipping
 		//bool clipping(bool reset = false);
 
+		/*
+			Profiling for the pulling thread: how many voices were heard and
+				how long pulling them took, since the last call.
+			Times are in clock ticks (see util/clock.h).  Audio thread only.
+		*/
+		struct PullStats
+		{
+			Uint32 voices; //Most voices heard in any one pull
+			Uint32 pulls;  //Voice pulls made
+			Uint64 total, slowest;
+		};
+		PullStats takePullStats();
+
 	protected:
 		//All that audio goodness
 		virtual AudioFormat format();
@@ -78,8 +92,20 @@ namespace plaidgadget
 		class Channel
 		{
 		public:
-			Channel() : play(false), drop(false), volume(1.0f) {}
-			bool play, drop; float volume;
+			Channel(Uint32 _slot=0) :
+				play(false), drop(false), volume(1.0f), slot(_slot) {}
+			bool play, drop; float volume; Uint32 slot;
+		};
+
+		//Mixer-side state of a sound; kept in a dense array.
+		struct Voice
+		{
+			Signal *signal;
+			Uint32 slot;
+			bool play;
+			float volume;
+			float gain; //Gain the last block ended on; negative when stopped
+			bool dropping; //Finished, waiting for room in the drop queue
 		};
 
 		typedef std::map<Sound, Signal> Signals;
@@ -90,14 +116,17 @@ namespace plaidgadget
 
 		enum ACTIONS {NONE=0,
 			GPLAY=1, GVOLUME=2, ADD=3, DROP=4, PLAY=5, VOLUME=6};
+		enum {NO_VOICE = 0xFFFFFFFF};
 		struct Action
 		{
 			Uint32 code;
+			Uint32 slot;
 			Signal *signal;
 			float value;
 
-			Action(Uint32 _c=0, Signal *_s=NULL, float _v=0.0f) :
-				code(_c), signal(_s), value(_v) {}
+			Action(Uint32 _c=0, Uint32 _slot=NO_VOICE, Signal *_s=NULL,
+				float _v=0.0f) :
+				code(_c), slot(_slot), signal(_s), value(_v) {}
 		};
 
 	private:
@@ -109,13 +138,23 @@ namespace plaidgadget
 		Uint64 extFrame;
 		float extPlay; float extVolume;
 		Channels external;
+		std::vector<Uint32> freeSlots;
+		Uint32 slotCount;
 		TimedEventQueue<Action> actions;
 		//bool clipped;
 
 		//Mixer-side data
 		bool intPlay; float intVolume;
-		Channels internal;
+		std::vector<Voice> voices;     //Dense, in no particular order
+		std::vector<Uint32> voiceIndex; //Slot -> index in voices, or NO_VOICE
+		std::vector<float> mix;         //Accumulator, one run per channel
 		LockFreeQueue<Signal*> drops;
+		Uint32 pendingDrops;
+		PullStats pullStats;
+
+		void removeVoice(Uint32 index);
+		bool dropVoice(Uint32 index);
+		void pullVoice(Signal *signal, AudioChunk &chunk);
 	};
 
 	/*
@@ -1,19 +1,122 @@
 #include <iostream>
 #include <cstring>
+#include <algorithm>
 
 #include "../util.h"
+#include "../../util/clock.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+	#define PG_MIX_SSE2
+	#include <emmintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+	#else
+		#include <cpuid.h>
+	#endif
+#endif
 
 
 using namespace plaidgadget;
 
 
+namespace
+{
+	/*
+		Mixing kernels.  Voices are summed into a float accumulator with a
+			gain that ramps linearly across the block, so volume changes
+			don't click, and the sum is saturated to Sint32 exactly once.
+	*/
+	typedef void (*AccumulateFunc)(float *out, const Sint32 *in, Uint32 count,
+		float gain, float step);
+	typedef void (*ResolveFunc)(Sint32 *out, const float *in, Uint32 count);
+
+	//Largest float below 2^31, so the conversion back can't overflow.
+	const float MIX_CLIP = 2147483520.0f;
+
+	void AccumulateScalar(float *out, const Sint32 *in, Uint32 count,
+		float gain, float step)
+	{
+		for (Uint32 i = 0; i < count; ++i)
+			out[i] += float(in[i]) * (gain + float(i)*step);
+	}
+
+	void ResolveScalar(Sint32 *out, const float *in, Uint32 count)
+	{
+		for (Uint32 i = 0; i < count; ++i)
+		{
+			float v = in[i];
+			v = (v > MIX_CLIP) ? MIX_CLIP : ((v < -MIX_CLIP) ? -MIX_CLIP : v);
+			out[i] = Sint32(v);
+		}
+	}
+
+#ifdef PG_MIX_SSE2
+	bool HasSSE2()
+	{
+#if defined(_M_X64) || defined(__x86_64__)
+		return true;
+#elif defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 1);
+		return (info[3] & (1 << 26)) != 0;
+#else
+		unsigned int a, b, c, d;
+		return __get_cpuid(1, &a, &b, &c, &d) && (d & (1 << 26)) != 0;
+#endif
+	}
+
+	//Unaligned loads and stores throughout; chunk buffers are only 4-aligned.
+	void AccumulateSSE2(float *out, const Sint32 *in, Uint32 count,
+		float gain, float step)
+	{
+		Uint32 blocks = count/4, i = 0;
+		__m128 g = _mm_set1_ps(gain), gstep = _mm_set1_ps(step),
+			index = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f), four = _mm_set1_ps(4.0f);
+		for (; blocks--; i += 4)
+		{
+			__m128 s = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*) (in+i)));
+			__m128 gi = _mm_add_ps(g, _mm_mul_ps(index, gstep));
+			_mm_storeu_ps(out+i, _mm_add_ps(_mm_loadu_ps(out+i), _mm_mul_ps(s, gi)));
+			index = _mm_add_ps(index, four);
+		}
+		AccumulateScalar(out+i, in+i, count-i, gain + float(i)*step, step);
+	}
+
+	void ResolveSSE2(Sint32 *out, const float *in, Uint32 count)
+	{
+		Uint32 blocks = count/4, i = 0;
+		__m128 hi = _mm_set1_ps(MIX_CLIP), lo = _mm_set1_ps(-MIX_CLIP);
+		for (; blocks--; i += 4)
+		{
+			__m128 v = _mm_max_ps(_mm_min_ps(_mm_loadu_ps(in+i), hi), lo);
+			_mm_storeu_si128((__m128i*) (out+i), _mm_cvttps_epi32(v));
+		}
+		ResolveScalar(out+i, in+i, count-i);
+	}
+#endif
+
+	AccumulateFunc Accumulate = AccumulateScalar;
+	ResolveFunc    Resolve    = ResolveScalar;
+
+	void ChooseKernels()
+	{
+#ifdef PG_MIX_SSE2
+		if (HasSSE2())
+		{
+			Accumulate = AccumulateSSE2;
+			Resolve    = ResolveSSE2;
+		}
+#endif
+	}
+}
+
 
 
 void Mixer::play()
 {
 	if (!extPlay)
 	{
-		actions.push(Action(GPLAY, NULL, true), extFrame);
+		actions.push(Action(GPLAY, NO_VOICE, NULL, true), extFrame);
 		extPlay = true;
 	}
 }
@@ -21,7 +124,7 @@ void Mixer::pause()
 {
 	if (extPlay)
 	{
-		actions.push(Action(GPLAY, NULL, false), extFrame);
+		actions.push(Action(GPLAY, NO_VOICE, NULL, false), extFrame);
 		extPlay = false;
 	}
 }
@@ -30,7 +133,7 @@ void Mixer::volume(float volume)
 	if (volume < 0.0f) volume = 0.0f;
 	if (extVolume != volume)
 	{
-		actions.push(Action(GVOLUME, NULL, volume), extFrame);
+		actions.push(Action(GVOLUME, NO_VOICE, NULL, volume), extFrame);
 		extVolume = volume;
 	}
 }
@@ -45,10 +148,15 @@ Signal *Mixer::findOrAdd(Sound sound)
 	Signal sig(sound, output);
 	if (sig.null()) return NULL;
 	Signal *p = &signals.insert(SignalsEntry(sound, sig)).first->second;
-	external.insert(ChannelsEntry(p, Channel()));
+
+	//Give it a voice slot; freed again once the pull thread lets go of it
+	Uint32 slot = slotCount;
+	if (freeSlots.size()) {slot = freeSlots.back(); freeSlots.pop_back();}
+	else ++slotCount;
+	external.insert(ChannelsEntry(p, Channel(slot)));
 
 	//Notify pull thread
-	actions.push(Action(ADD, p, 1.0f), extFrame);
+	actions.push(Action(ADD, slot, p, 1.0f), extFrame);
 
 	return p;
 }
@@ -72,7 +180,7 @@ void Mixer::drop(Sound sound)
 	c.drop = true;
 
 	//Notify pull thread
-	actions.push(Action(DROP, &it->second, 0.0f), extFrame);
+	actions.push(Action(DROP, c.slot, &it->second, 0.0f), extFrame);
 }
 
 void Mixer::play(Sound sound)
@@ -85,7 +193,7 @@ void Mixer::play(Sound sound)
 	//State change
 	if (!c.play)
 	{
-		actions.push(Action(PLAY, p, true), extFrame);
+		actions.push(Action(PLAY, c.slot, p, true), extFrame);
 		c.play = true;
 	}
 }
@@ -99,7 +207,7 @@ void Mixer::pause(Sound sound)
 	//State change
 	if (c.play)
 	{
-		actions.push(Action(PLAY, p, false), extFrame);
+		actions.push(Action(PLAY, c.slot, p, false), extFrame);
 		c.play = false;
 	}
 }
@@ -115,7 +223,7 @@ void Mixer::volume(Sound sound, float volume)
 	//State change
 	if (c.volume != volume)
 	{
-		actions.push(Action(VOLUME, p, volume), extFrame);
+		actions.push(Action(VOLUME, c.slot, p, volume), extFrame);
 		c.volume = volume;
 	}
 }
@@ -149,11 +257,22 @@ AudioFormat Mixer::format()
 
 
 Mixer::Mixer(AudioFormat format) :
-	output(format)
+	output(format), slotCount(0), actions(256), drops(256, QUEUE_REJECT),
+	pendingDrops(0)
 {
 	extVolume = intVolume = 1.0f;
 	extPlay = intPlay = true;
 	extFrame = 0;
+
+	PullStats none = {0, 0, 0, 0};
+	pullStats = none;
+
+	//Room for a typical number of voices before the pull thread allocates
+	voices.reserve(128);
+	voiceIndex.resize(128, NO_VOICE);
+
+	static bool chosen = false;
+	if (!chosen) {ChooseKernels(); chosen = true;}
 }
 
 Mixer::~Mixer()
@@ -162,7 +281,7 @@ Mixer::~Mixer()
 
 bool Mixer::exhausted()
 {
-	return !internal.size();
+	return !voices.size();
 }
 
 void Mixer::tick(Uint64 frame)
@@ -174,6 +293,8 @@ void Mixer::tick(Uint64 frame)
 	Signal *drop;
 	while (drops.pull(drop))
 	{
+		Channels::iterator c = external.find(drop);
+		if (c != external.end()) freeSlots.push_back(c->second.slot);
 		if (!external.erase(drop))        reportError("Mixer drop fail A");
 		if (!signals.erase(Sound(*drop))) reportError("Mixer drop fail B");
 	}
@@ -198,109 +319,159 @@ void Mixer::tick(Uint64 frame)
 	}*/
 }
 
+void Mixer::removeVoice(Uint32 index)
+{
+	//Swap the last voice into the hole to keep the array dense
+	voiceIndex[voices[index].slot] = NO_VOICE;
+	if (index+1 != voices.size())
+	{
+		voices[index] = voices.back();
+		voiceIndex[voices[index].slot] = index;
+	}
+	voices.pop_back();
+}
+
+//Hands a voice back to the game thread for disposal.  If the queue is full
+//	the voice stays, silenced, and is retried next block; returns whether
+//	it was removed.
+bool Mixer::dropVoice(Uint32 index)
+{
+	Voice &v = voices[index];
+	if (drops.push(v.signal))
+	{
+		if (v.dropping) --pendingDrops;
+		removeVoice(index);
+		return true;
+	}
+	if (!v.dropping) {v.dropping = true; ++pendingDrops;}
+	v.play = false;
+	return false;
+}
+
+void Mixer::pullVoice(Signal *signal, AudioChunk &chunk)
+{
+	Uint64 start = ClockTicks();
+	signal->pull(chunk);
+	Uint64 spent = ClockTicks() - start;
+
+	++pullStats.pulls;
+	pullStats.total += spent;
+	if (spent > pullStats.slowest) pullStats.slowest = spent;
+}
+
+Mixer::PullStats Mixer::takePullStats()
+{
+	PullStats stats = pullStats, none = {0, 0, 0, 0};
+	pullStats = none;
+	return stats;
+}
+
 void Mixer::pull(AudioChunk &chunk)
 {
 	//First handle state changes
 	if (chunk.first())
 	{
-		//std::cout << "Mixer:" << now << std::endl;
+		//Retry drops that didn't fit in the queue last time
+		for (Uint32 i = 0; pendingDrops && i < voices.size();)
+		{
+			if (!voices[i].dropping || !dropVoice(i)) ++i;
+		}
+
 		Action act;
-		Channels::iterator i, e = internal.end();
-		//if (pend.frame > now) std::cout << " wait: " << pend.frame << std::endl;
 		while (actions.pull(act, chunk.frame()))
 		{
-			i = internal.find(act.signal);
+			Uint32 index = (act.slot < voiceIndex.size()) ?
+				voiceIndex[act.slot] : Uint32(NO_VOICE);
+			if (index != NO_VOICE && voices[index].signal != act.signal)
+				index = NO_VOICE;
 			switch (act.code)
 			{
 			case GPLAY:   intPlay =   act.value; break;
 			case GVOLUME: intVolume = act.value; break;
-			case PLAY:    if (i!=e) i->second.play =   act.value; break;
-			case VOLUME:  if (i!=e) i->second.volume = act.value; break;
+			case PLAY:
+				if (index != NO_VOICE && !voices[index].dropping)
+					voices[index].play = act.value;
+				break;
+			case VOLUME:
+				if (index != NO_VOICE) voices[index].volume = act.value;
+				break;
 			case ADD:
-				//std::cout << "Mixer added a sound!" << std::endl;
-				if (i==e) internal.insert(ChannelsEntry(act.signal,Channel()));
+				if (index == NO_VOICE)
+				{
+					if (act.slot >= voiceIndex.size())
+						voiceIndex.resize(2*act.slot + 1, NO_VOICE);
+					Voice v = {act.signal, act.slot, false, 1.0f, -1.0f, false};
+					voiceIndex[act.slot] = voices.size();
+					voices.push_back(v);
+				}
 				break;
 			case DROP:
-				//std::cout << "Mixer stopped a sound!" << std::endl;
-				if (i!=e) {internal.erase(i); drops.push(act.signal);}
+				if (index != NO_VOICE && !voices[index].dropping)
+					dropVoice(index);
 				break;
 			}
-			/*std::cout << "  " << "0PVadpv"[act.code] << " "
-				<< " " << act.signal << " " << act.value << " "
-				<< "/" << now << std::endl;*/
 		}
 	}
 
-
-	//Prep mix
-	AudioChunk temp(chunk.audio, chunk.format(),
-		NULL, chunk.length(), chunk.frame(), chunk.a(), chunk.b());
-	bool tempOK = temp.ok();
-
 	Uint32 count = chunk.length(), chans = chunk.format().channels;
 
-	bool first = true;
+	//Count voices that will be heard this block
+	Uint32 playing = 0, last = 0;
+	if (intPlay) for (Uint32 i = 0; i < voices.size(); ++i)
+		if (voices[i].play) {++playing; last = i;}
+	pullStats.voices = std::max(pullStats.voices, playing);
 
-	//GET ON WITH THE MIXIN'
-	if (intPlay)
-		for (Channels::iterator i=internal.begin(), e=internal.end(); i!=e;)
+	if (!playing || !count)
 	{
-		//Skip paused sounds
-		if (!i->second.play) {++i; continue;}
+		chunk.silence();
+		return;
+	}
 
-		//Compute volume
-		float v = i->second.volume*intVolume;
-		Sint32 mult = Sint32(256.0f * v);
+	//Shortcut: a lone voice at unity gain renders straight into the output
+	Voice &lone = voices[last];
+	if (playing == 1 && lone.volume * intVolume == 1.0f &&
+		(lone.gain == 1.0f || lone.gain < 0.0f))
+	{
+		lone.gain = 1.0f;
+		pullVoice(lone.signal, chunk);
+		if (lone.signal->exhausted()) dropVoice(last);
+		return;
+	}
 
-		if (first && mult == 256)
-		{
-			//Shortcut!
-			i->first->pull(chunk);
-			//break;
-		}
-		else
-		{
-			if (!tempOK) continue;
+	//Prep mix
+	AudioChunk temp(chunk.audio, chunk.format(),
+		NULL, count, chunk.frame(), chunk.a(), chunk.b());
+	if (mix.size() < chans*count) mix.resize(chans*count);
+	std::memset((void*) &mix[0], 0, sizeof(float)*chans*count);
 
-			//Render channel chunk
-			i->first->pull(temp);
+	//GET ON WITH THE MIXIN'
+	for (Uint32 i = 0; i < voices.size();)
+	{
+		Voice &v = voices[i];
 
-			//Compute volume and (if not silent) mix!
-			if (mult) for (Uint32 chan = 0; chan < chans; ++chan)
-			{
-				//Core mixer code lives here!
-				Sint32 *ip = temp.start(chan), *op = chunk.start(chan);
-				Uint32 blocks = count/16, mod = count%16;
-	#define UNROLLED(X) do {while (mod--) {X;} \
-		while (blocks--) {X;X;X;X;X;X;X;X;X;X;X;X;X;X;X;X;}} while(0)
-				if (first)
-				{
-					//First case should never happen in practice
-					if (mult == 256) std::memcpy((void*)op, (void*)ip, 4*count);
-					else UNROLLED(*(op++) =  (mult*(*(ip++)))>>8);
-				}
-				else
-				{
-					if (mult == 256) UNROLLED(*(op++) += *(ip++));
-					else UNROLLED(*(op++) += (mult*(*(ip++)))>>8);
-				}
-	#undef UNROLLED
-			}
-		}
+		//Sounds start (or resume) at full volume; only changes are ramped
+		if (!v.play) {v.gain = -1.0f; ++i; continue;}
+		if (!temp.ok()) {++i; continue;}
 
-		first = false;
+		//Render channel chunk
+		pullVoice(v.signal, temp);
 
-		//Drop if exhausted
-		if (i->first->exhausted())
+		//Ramp from the last block's gain to the current one
+		float target = v.volume * intVolume;
+		if (v.gain < 0.0f) v.gain = target;
+		if (target != 0.0f || v.gain != 0.0f)
 		{
-			drops.push(i->first);
-			internal.erase(i++);
+			float step = (target - v.gain) / float(count);
+			for (Uint32 chan = 0; chan < chans; ++chan)
+				Accumulate(&mix[chan*count], temp.start(chan), count, v.gain, step);
 		}
-		else ++i;
-	}
+		v.gain = target;
 
-	if (first)
-	{
-		chunk.silence();
+		//Drop if exhausted; a removed voice's place is taken by the last one
+		if (!v.signal->exhausted() || !dropVoice(i)) ++i;
 	}
+
+	//Single saturating output stage
+	for (Uint32 chan = 0; chan < chans; ++chan)
+		Resolve(chunk.start(chan), &mix[chan*count], count);
 }
@@ -2,13 +2,43 @@
 #define PLAIDGADGET_LOCKFREE_H
 
 
-#include <list>
+#if defined(_MSC_VER)
+	#include <intrin.h>
+#endif
 
 #include "../util/types.h"
 
 
 namespace plaidgadget
 {
+	/*
+		Acquire/release access to a value shared between two threads.
+
+		MSVC gives volatile accesses acquire/release semantics on x86 and x64;
+			the barrier just keeps the compiler from moving other accesses
+			across them.  Elsewhere the GCC atomic builtins are used.
+	*/
+#if defined(_MSC_VER)
+	template<typename T> inline T AtomicAcquire(const volatile T &v)
+		{T r = v; _ReadWriteBarrier(); return r;}
+	template<typename T> inline void AtomicRelease(volatile T &v, T x)
+		{_ReadWriteBarrier(); v = x;}
+#else
+	template<typename T> inline T AtomicAcquire(const volatile T &v)
+		{return __atomic_load_n(&v, __ATOMIC_ACQUIRE);}
+	template<typename T> inline void AtomicRelease(volatile T &v, T x)
+		{__atomic_store_n(&v, x, __ATOMIC_RELEASE);}
+#endif
+
+	/*
+		What a LockFreeQueue does when push() finds it full.
+	*/
+	enum QUEUE_OVERFLOW
+	{
+		QUEUE_GROW = 0,   //Link in a ring of twice the size.  Nothing is lost.
+		QUEUE_REJECT = 1, //Discard the new item; push() returns false.
+	};
+
 	/*
 		A simple lock-free queue.
 
@@ -16,6 +46,11 @@ namespace plaidgadget
 			which creates and fills it, and a designated consumer which takes
 			data out.
 
+		Items live in a preallocated ring whose size is a power of two, with
+			the producer and consumer positions kept on separate cache lines.
+			Neither push nor pull allocates unless the ring overflows under
+			QUEUE_GROW, so size the queue for the expected backlog.
+
 		T must have a default constructor available, and should generally be a
 			cheaply-copied type that is safe to destroy in either thread.
 	*/
@@ -25,27 +60,43 @@ namespace plaidgadget
 	public:
 		/*
 			Creation and destruction should occur in 'producer' thread.
+			Capacity is rounded up to a power of two.
 		*/
-		LockFreeQueue()
-			{store.push_back(T()); store.push_back(T()); head=&store.front();
-			tail=&store.back(); head->next=tail; tail->next=head;}
-		~LockFreeQueue() {}
+		LockFreeQueue(Uint32 capacity = 64, QUEUE_OVERFLOW overflow = QUEUE_GROW)
+			: overflow(overflow)
+			{Uint32 size = 2; while (size < capacity) size <<= 1;
+			head = tail = new Ring(size);}
+		~LockFreeQueue()
+			{while (head) {Ring *next = head->next; delete head; head = next;}}
 
 		/*
 			Should only be called by ONE thread, the 'producer'.
+			Returns false if the item was rejected because the queue is full.
 		*/
-		void push(const T &t)
+		bool push(const T &t)
 		{
-			tail->t = t;
-			if (tail->next == head)
+			Ring *ring = tail;
+			Uint32 pos = ring->write;
+			if (pos - ring->readCache > ring->mask)
 			{
-				//Need to expand; tail blocks head from entering this territory
-				store.push_back(T());
-				Node *next = &store.back();
-				next->next = tail->next;
-				tail->next = next;
+				//Looks full; refresh our view of the consumer before deciding
+				ring->readCache = AtomicAcquire(ring->read);
+				if (pos - ring->readCache > ring->mask)
+				{
+					if (overflow == QUEUE_REJECT) return false;
+
+					//The consumer moves over once it drains the old ring
+					Ring *next = new Ring((ring->mask+1) * 2);
+					next->items[0] = t;
+					next->write = 1;
+					AtomicRelease(ring->next, next);
+					tail = next;
+					return true;
+				}
 			}
-			tail = tail->next;
+			ring->items[pos & ring->mask] = t;
+			AtomicRelease(ring->write, pos+1);
+			return true;
 		}
 
 		/*
@@ -56,24 +107,74 @@ namespace plaidgadget
 		*/
 		bool pull(T &t)
 		{
-			Node *next = head->next;
-			if (next==tail) return false;
-			t = next->t;
-			head = next;
-			return true;
+			while (true)
+			{
+				Ring *ring = head;
+				Uint32 pos = ring->read;
+				if (pos != ring->writeCache ||
+					pos != (ring->writeCache = AtomicAcquire(ring->write)))
+				{
+					t = ring->items[pos & ring->mask];
+					AtomicRelease(ring->read, pos+1);
+					return true;
+				}
+
+				//Empty.  If the producer has moved on, anything it wrote here
+				//	before doing so is visible once we've seen the link.
+				Ring *next = AtomicAcquire(ring->next);
+				if (!next) return false;
+				if (pos != (ring->writeCache = AtomicAcquire(ring->write)))
+					continue;
+				head = next;
+				delete ring;
+			}
 		}
 
+		/*
+			Size of the ring currently being written.  Producer only.
+		*/
+		Uint32 capacity() const {return tail->mask+1;}
+
 	private:
-		class Node
+		enum {CACHE_LINE = 64};
+
+		struct Ring
 		{
-		public:
-			Node(const T &_t) : t(_t) {}
-			T t;
-			Node *next;
+			Ring(Uint32 size) : items(new T[size]), mask(size-1),
+				write(0), readCache(0), read(0), writeCache(0), next(NULL) {}
+			~Ring() {delete[] items;}
+
+			T *items;
+			Uint32 mask;
+
+			//Producer side
+			char pad0[CACHE_LINE];
+			volatile Uint32 write;
+			Uint32 readCache;
+
+			//Consumer side
+			char pad1[CACHE_LINE];
+			volatile Uint32 read;
+			Uint32 writeCache;
+
+			//Set by the producer when it outgrows this ring
+			char pad2[CACHE_LINE];
+			Ring *volatile next;
+
+		private:
+			Ring(const Ring&);
+			void operator=(const Ring&);
 		};
-		typedef std::list<Node> Store;
-		Store store;
-		Node *head, *tail;
+
+		//Consumer's ring and producer's ring; the same unless the queue grew
+		char pad0[CACHE_LINE];
+		Ring *head;
+		char pad1[CACHE_LINE];
+		Ring *tail;
+		QUEUE_OVERFLOW overflow;
+
+		LockFreeQueue(const LockFreeQueue&);
+		void operator=(const LockFreeQueue&);
 	};
 
 	/*
@@ -89,7 +190,7 @@ namespace plaidgadget
 	class TimedEventQueue
 	{
 	public:
-		TimedEventQueue() {}
+		TimedEventQueue(Uint32 capacity = 64) : queue(capacity) {}
 
 		/*
 			Should only be called by producer thread, as with LockFreeQueue.
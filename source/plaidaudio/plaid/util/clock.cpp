@@ -0,0 +1,50 @@
+#include "clock.h"
+
+#if defined(_WIN32)
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+#else
+	#include <time.h>
+#endif
+
+
+using namespace plaidgadget;
+
+
+#if defined(_WIN32)
+
+static double TickPeriod()
+{
+	LARGE_INTEGER freq;
+	QueryPerformanceFrequency(&freq);
+	return 1.0 / double(freq.QuadPart);
+}
+
+Uint64 plaidgadget::ClockTicks()
+{
+	LARGE_INTEGER count;
+	QueryPerformanceCounter(&count);
+	return Uint64(count.QuadPart);
+}
+
+double plaidgadget::ClockSeconds(Uint64 ticks)
+{
+	static const double period = TickPeriod();
+	return double(ticks) * period;
+}
+
+#else
+
+Uint64 plaidgadget::ClockTicks()
+{
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return Uint64(now.tv_sec) * 1000000000u + Uint64(now.tv_nsec);
+}
+
+double plaidgadget::ClockSeconds(Uint64 ticks)
+{
+	return double(ticks) * 1e-9;
+}
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef PLAIDGADGET_CLOCK_H
+#define PLAIDGADGET_CLOCK_H
+
+
+#include "types.h"
+
+
+/*
+	A monotonic high-resolution clock, safe to read from any thread
+		(including the audio thread -- it never blocks or allocates).
+
+	Ticks have no fixed unit; convert differences with ClockSeconds.
+*/
+
+
+namespace plaidgadget
+{
+	Uint64 ClockTicks();
+	double ClockSeconds(Uint64 ticks);
+}
+
+
+#endif // PLAIDGADGET_CLOCK_H
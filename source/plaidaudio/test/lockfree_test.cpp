@@ -0,0 +1,130 @@
+/*
+	Stress test for LockFreeQueue: a producer and a consumer thread pass
+		numbered items through queues of several sizes under both overflow
+		policies, and the consumer checks nothing arrives torn, out of order,
+		or (with QUEUE_GROW) missing.
+
+	Build and run with the Makefile in this directory; "make tsan" runs it
+		under ThreadSanitizer.
+*/
+
+#include <cstdio>
+#include <thread>
+
+#include <plaid/thread/lockfree.h>
+
+using namespace plaidgadget;
+
+
+namespace
+{
+	//Two copies of the sequence number, so a torn copy is noticed
+	struct Item
+	{
+		Item(Uint32 n = 0) : seq(n), check(~n) {}
+		Uint32 seq, check;
+	};
+
+	const Uint32 ITEMS = 2000000;
+
+	int failures = 0;
+
+	void fail(const char *what, Uint32 capacity, QUEUE_OVERFLOW overflow)
+	{
+		std::printf("FAIL %s (capacity %u, %s)\n", what, unsigned(capacity),
+			overflow == QUEUE_GROW ? "grow" : "reject");
+		++failures;
+	}
+
+	void stress(Uint32 capacity, QUEUE_OVERFLOW overflow)
+	{
+		LockFreeQueue<Item> queue(capacity, overflow);
+		volatile Uint32 done = 0;
+		Uint32 rejected = 0;
+
+		std::thread producer([&]()
+		{
+			//Give the consumer a chance after a rejection, so the ring keeps
+			//	wrapping instead of the test rejecting nearly everything
+			for (Uint32 i = 1; i <= ITEMS; ++i)
+				if (!queue.push(Item(i))) {++rejected; std::this_thread::yield();}
+			AtomicRelease(done, Uint32(1));
+		});
+
+		Uint32 received = 0, last = 0;
+		bool torn = false, order = false;
+		Item item;
+		while (true)
+		{
+			if (queue.pull(item))
+			{
+				if (item.check != ~item.seq) torn = true;
+				if (item.seq <= last) order = true;
+				if (overflow == QUEUE_GROW && item.seq != last+1) order = true;
+				last = item.seq;
+				++received;
+			}
+			else if (AtomicAcquire(done))
+			{
+				//Anything pushed before done was set is visible by now
+				if (!queue.pull(item)) break;
+				if (item.check != ~item.seq) torn = true;
+				if (item.seq <= last) order = true;
+				last = item.seq;
+				++received;
+			}
+			else std::this_thread::yield();
+		}
+		producer.join();
+
+		if (torn)  fail("torn item", capacity, overflow);
+		if (order) fail("items out of order or skipped", capacity, overflow);
+		if (received + rejected != ITEMS)
+			fail("items lost", capacity, overflow);
+		if (overflow == QUEUE_GROW && rejected)
+			fail("push rejected while growing", capacity, overflow);
+
+		std::printf("capacity %2u %-6s received %u, rejected %u\n",
+			unsigned(capacity), overflow == QUEUE_GROW ? "grow" : "reject",
+			unsigned(received), unsigned(rejected));
+	}
+
+	//Single-threaded checks of what happens at the edges of the ring
+	void edges(Uint32 capacity)
+	{
+		LockFreeQueue<Item> reject(capacity, QUEUE_REJECT);
+		Uint32 size = reject.capacity();
+		for (Uint32 i = 0; i < size; ++i)
+			if (!reject.push(Item(i))) fail("rejected below capacity", capacity, QUEUE_REJECT);
+		if (reject.push(Item(size))) fail("accepted past capacity", capacity, QUEUE_REJECT);
+		if (reject.capacity() != size) fail("ring grew", capacity, QUEUE_REJECT);
+
+		Item item;
+		if (!reject.pull(item) || item.seq != 0) fail("wrong first item", capacity, QUEUE_REJECT);
+		if (!reject.push(Item(size))) fail("no room after a pull", capacity, QUEUE_REJECT);
+
+		LockFreeQueue<Item> grow(capacity, QUEUE_GROW);
+		for (Uint32 i = 0; i < size*4; ++i) grow.push(Item(i));
+		if (grow.capacity() <= size) fail("ring didn't grow", capacity, QUEUE_GROW);
+		for (Uint32 i = 0; i < size*4; ++i)
+			if (!grow.pull(item) || item.seq != i) {fail("lost item across rings", capacity, QUEUE_GROW); break;}
+		if (grow.pull(item)) fail("extra item", capacity, QUEUE_GROW);
+	}
+}
+
+
+int main()
+{
+	static const Uint32 capacities[] = {2, 8, 64};
+
+	for (Uint32 i = 0; i < 3; ++i)
+	{
+		edges(capacities[i]);
+		stress(capacities[i], QUEUE_GROW);
+		stress(capacities[i], QUEUE_REJECT);
+	}
+
+	if (failures) std::printf("%d failures\n", failures);
+	else          std::printf("All passed.\n");
+	return failures ? 1 : 0;
+}
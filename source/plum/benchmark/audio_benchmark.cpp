@@ -0,0 +1,66 @@
+#include <memory>
+#include <sstream>
+#include <plaid/audio.h>
+#include <plaid/audio/synth.h>
+#include <plaid/audio/effects.h>
+
+#include "benchmark.h"
+
+namespace plum
+{
+    namespace
+    {
+        const int Rate = 44100;
+        // How much each kernel call renders, the same as one frame of a plain update.
+        const double Step = 1.0 / 60.0;
+
+        // An offline system with a number of oscillators playing. With a rate other than 1,
+        // each one goes through a Pitch effect with the given resampler first.
+        std::shared_ptr<plaidgadget::Audio> makeVoices(int voices, float rate, plaidgadget::Uint32 resampler)
+        {
+            auto audio = std::make_shared<plaidgadget::Audio>(plaidgadget::AudioFormat(2, Rate));
+            for(int i = 0; i < voices; ++i)
+            {
+                plaidgadget::Sound voice(new plaidgadget::Oscillator(audio->format(), 110.0f + i * 27.5f, i % 4, 0.5f / voices));
+                if(rate != 1.0f)
+                {
+                    voice = plaidgadget::Sound(new plaidgadget::Pitch(voice, rate, resampler));
+                }
+                audio->play(voice);
+            }
+            return audio;
+        }
+    }
+
+    // Mixer::pull and Pitch::pull are only reachable through a render, so these time a whole step,
+    // and the mixer case with no pitching is the baseline to compare the resamplers against.
+    void addAudioBenchmarks(Benchmark& bench)
+    {
+        static const int Voices[] = { 8, 32 };
+        for(int i = 0; i < 2; ++i)
+        {
+            std::ostringstream name;
+            name << "audio/mixer/" << Voices[i];
+            auto audio = makeVoices(Voices[i], 1.0f, plaidgadget::Pitch::HERMITE);
+            bench.add(name.str(), [audio]() { audio->render(Step); });
+        }
+
+        static const struct
+        {
+            const char* name;
+            plaidgadget::Uint32 resampler;
+        } Resamplers[] = {
+            { "none", plaidgadget::Pitch::NONE },
+            { "linear", plaidgadget::Pitch::LINEAR },
+            { "hermite", plaidgadget::Pitch::HERMITE },
+            { "sinc", plaidgadget::Pitch::SINC },
+        };
+        for(int i = 0; i < 4; ++i)
+        {
+            std::ostringstream name;
+            name << "audio/pitch/" << Resamplers[i].name << "/32";
+            auto audio = makeVoices(32, 1.5f, Resamplers[i].resampler);
+            bench.add(name.str(), [audio]() { audio->render(Step); });
+        }
+    }
+}
@@ -0,0 +1,188 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <plaid/audio.h>
+#include <plaid/audio/synth.h>
+#include <plaid/audio/effects.h>
+#include <plaid/util/clock.h>
+
+// Renders mixes on an offline audio system, with no device behind it, and reports how fast they went.
+//
+//   audiorender [-voices N] [-seconds S] [-resampler none|linear|hermite|sinc] [-wav prefix] [source...]
+//
+// Each source is either "synth", or a file any codec can stream, such as an .ogg or an .it.
+// Every source gets its own mix, where each voice goes through a Pitch and a Pan into the master Mixer.
+// With no sources, only the synth mix is rendered.
+
+namespace
+{
+    const int Rate = 44100;
+    const double Step = 1.0 / 60.0;
+
+    struct Options
+    {
+        int voices;
+        double seconds;
+        plaidgadget::Uint32 resampler;
+        std::string wav;
+        std::vector<std::string> sources;
+
+        Options()
+            : voices(32), seconds(10.0), resampler(plaidgadget::Pitch::HERMITE)
+        {
+        }
+    };
+
+    bool parseResampler(const std::string& name, plaidgadget::Uint32& resampler)
+    {
+        static const struct
+        {
+            const char* name;
+            plaidgadget::Uint32 resampler;
+        } Resamplers[] = {
+            { "none", plaidgadget::Pitch::NONE },
+            { "linear", plaidgadget::Pitch::LINEAR },
+            { "hermite", plaidgadget::Pitch::HERMITE },
+            { "sinc", plaidgadget::Pitch::SINC },
+        };
+        for(int i = 0; i < 4; ++i)
+        {
+            if(name == Resamplers[i].name)
+            {
+                resampler = Resamplers[i].resampler;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool parseOptions(int argc, char** argv, Options& options)
+    {
+        for(int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            if(arg[0] != '-')
+            {
+                options.sources.push_back(arg);
+                continue;
+            }
+            if(i + 1 == argc)
+            {
+                return false;
+            }
+            std::string value = argv[++i];
+            if(arg == "-voices")
+            {
+                options.voices = std::atoi(value.c_str());
+            }
+            else if(arg == "-seconds")
+            {
+                options.seconds = std::atof(value.c_str());
+            }
+            else if(arg == "-resampler")
+            {
+                if(!parseResampler(value, options.resampler))
+                {
+                    return false;
+                }
+            }
+            else if(arg == "-wav")
+            {
+                options.wav = value;
+            }
+            else
+            {
+                return false;
+            }
+        }
+        if(options.sources.empty())
+        {
+            options.sources.push_back("synth");
+        }
+        return options.voices > 0 && options.seconds > 0.0;
+    }
+
+    // The name a source is reported under, and written out as: its file name without the path.
+    std::string baseName(const std::string& source)
+    {
+        size_t slash = source.find_last_of("/\\");
+        return slash == std::string::npos ? source : source.substr(slash + 1);
+    }
+
+    // Spreads the voices across the stereo field and a small range of pitches,
+    // so no two are pulled the same way and the resampler always has work to do.
+    bool addVoices(plaidgadget::Audio& audio, const Options& options, const std::string& source)
+    {
+        for(int i = 0; i < options.voices; ++i)
+        {
+            plaidgadget::Sound voice;
+            if(source == "synth")
+            {
+                voice = plaidgadget::Sound(new plaidgadget::Oscillator(plaidgadget::AudioFormat(1, Rate), 110.0f + i * 27.5f, i % 4));
+            }
+            else
+            {
+                voice = audio.stream(plaidgadget::ToPGString(source), true);
+                if(!voice)
+                {
+                    return false;
+                }
+            }
+
+            float spread = options.voices > 1 ? float(i) / (options.voices - 1) : 0.5f;
+            plaidgadget::Ref<plaidgadget::Pitch> pitch(new plaidgadget::Pitch(voice, 0.9f + 0.2f * spread, options.resampler));
+            plaidgadget::Ref<plaidgadget::Pan> pan(new plaidgadget::Pan(plaidgadget::Sound(pitch), spread * 2.0f - 1.0f, 1.0f / options.voices));
+            audio.play(plaidgadget::Sound(pan));
+        }
+        return true;
+    }
+
+    bool renderMix(const Options& options, const std::string& source)
+    {
+        std::string name = baseName(source);
+        std::string wav = options.wav.empty() ? std::string() : options.wav + name + ".wav";
+        plaidgadget::Audio audio(plaidgadget::AudioFormat(2, Rate), plaidgadget::ToPGString(wav));
+        if(!addVoices(audio, options, source))
+        {
+            std::fprintf(stderr, "Couldn't stream '%s'.\n", source.c_str());
+            return false;
+        }
+
+        // Frame by frame, the same as a game would update it.
+        plaidgadget::Uint64 samples = 0;
+        plaidgadget::Uint64 start = plaidgadget::ClockTicks();
+        int frames = int(options.seconds / Step + 0.5);
+        for(int i = 0; i < frames; ++i)
+        {
+            samples += audio.render(Step);
+        }
+        double elapsed = plaidgadget::ClockSeconds(plaidgadget::ClockTicks() - start);
+
+        plaidgadget::AudioStats stats = audio.stats();
+        std::printf("%-24s %4d voices %10llu samples %8.3f s %12.0f samples/s %7.1fx realtime, scratch peak %u denied %u\n",
+            name.c_str(), options.voices, (unsigned long long) samples, elapsed, samples / elapsed,
+            samples / elapsed / Rate, stats.scratchPeak, stats.scratchDenied);
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if(!parseOptions(argc, argv, options))
+    {
+        std::fprintf(stderr, "usage: %s [-voices N] [-seconds S] [-resampler none|linear|hermite|sinc] [-wav prefix] [synth|file...]\n", argv[0]);
+        return 2;
+    }
+
+    int status = 0;
+    for(auto it = options.sources.begin(), end = options.sources.end(); it != end; ++it)
+    {
+        if(!renderMix(options, *it))
+        {
+            status = 1;
+        }
+    }
+    return status;
+}
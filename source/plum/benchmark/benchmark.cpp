@@ -0,0 +1,383 @@
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <algorithm>
+
+#include "benchmark.h"
+#include "../core/file.h"
+#include "../core/font.h"
+#include "../core/image.h"
+#include "../core/canvas.h"
+#include "../core/screen.h"
+#include "../core/sprite.h"
+#include "../core/profile.h"
+#include "../core/tilemap.h"
+
+namespace plum
+{
+    namespace
+    {
+        // Caps the calibration, for kernels too quick for the clock to see at all.
+        const uint64_t MaxIterations = uint64_t(1) << 30;
+
+        uint64_t timeBatch(const Benchmark::Kernel& kernel, uint64_t iterations)
+        {
+            uint64_t start = profile::now();
+            for(uint64_t i = 0; i < iterations; ++i)
+            {
+                kernel();
+            }
+            return profile::now() - start;
+        }
+
+        // Pulls a field's value out of one line of write() output.
+        bool findField(const std::string& line, const char* field, std::string& value)
+        {
+            std::string key = std::string("\"") + field + "\":";
+            size_t start = line.find(key);
+            if(start == std::string::npos)
+            {
+                return false;
+            }
+            start += key.size();
+            if(start < line.size() && line[start] == '"')
+            {
+                size_t end = line.find('"', start + 1);
+                if(end == std::string::npos)
+                {
+                    return false;
+                }
+                value = line.substr(start + 1, end - start - 1);
+            }
+            else
+            {
+                value = line.substr(start, line.find_first_of(",}", start) - start);
+            }
+            return true;
+        }
+
+        // A canvas with every alpha level in it, so no blend takes a shortcut over the whole thing.
+        std::shared_ptr<Canvas> makePattern(int width, int height)
+        {
+            auto canvas = std::make_shared<Canvas>(width, height);
+            Color* data = canvas->getData();
+            for(int y = 0; y < height; ++y)
+            {
+                for(int x = 0; x < width; ++x)
+                {
+                    data[y * width + x] = Color(uint8_t(x * 7), uint8_t(y * 5), uint8_t((x + y) * 3), uint8_t((x * 13 + y * 17) & 0xFF));
+                }
+            }
+            return canvas;
+        }
+
+        template<BlendMode Blend> void addBlendMode(Benchmark& bench, const std::string& mode)
+        {
+            static const int Sizes[] = { 16, 256, 4096 };
+            for(int i = 0; i < 3; ++i)
+            {
+                int size = Sizes[i];
+                auto source = makePattern(size, 1);
+                auto dest = makePattern(size, 1);
+
+                std::ostringstream name;
+                name << "blend/" << mode << "/" << size;
+                bench.add(name.str(), [source, dest, size]()
+                {
+                    blendSpan<Blend>(source->getData(), dest->getData(), size, 255);
+                });
+
+                name << "/half";
+                bench.add(name.str(), [source, dest, size]()
+                {
+                    blendSpan<Blend>(source->getData(), dest->getData(), size, 128);
+                });
+            }
+        }
+
+        void addBlits(Benchmark& bench, const std::shared_ptr<Canvas>& dest, int size)
+        {
+            auto source = makePattern(size, size);
+            int w = dest->getWidth();
+            int h = dest->getHeight();
+            std::ostringstream prefix;
+            prefix << "canvas/blit/" << size;
+
+            bench.add(prefix.str() + "/opaque", [source, dest]() { source->blit<BlendOpaque>(8, 8, *dest); });
+            bench.add(prefix.str() + "/inside", [source, dest]() { source->blit<BlendPreserve>(8, 8, *dest); });
+            // Hangs off the bottom right corner, so only a quarter or less lands.
+            bench.add(prefix.str() + "/edge", [source, dest, w, h, size]()
+            {
+                source->blit<BlendPreserve>(w - size / 2, h - size / 2, *dest);
+            });
+            // Centered on a small clip region, which cuts down anything bigger than it.
+            bench.add(prefix.str() + "/cliprect", [source, dest, size]()
+            {
+                dest->setClipRegion(16, 16, 47, 47);
+                source->blit<BlendPreserve>(32 - size / 2, 32 - size / 2, *dest);
+                dest->restoreClipRegion();
+            });
+        }
+    }
+
+    const int Benchmark::Samples;
+
+    Benchmark::Benchmark(int caseTime)
+        : caseTime(std::max(caseTime, Samples))
+    {
+    }
+
+    Benchmark::~Benchmark()
+    {
+    }
+
+    void Benchmark::add(const std::string& name, const Kernel& kernel)
+    {
+        Case c;
+        c.name = name;
+        c.kernel = kernel;
+        cases.push_back(c);
+    }
+
+    void Benchmark::run(const std::string& filter)
+    {
+        results.clear();
+        uint64_t batchTime = caseTime / Samples;
+        for(auto it = cases.begin(), end = cases.end(); it != end; ++it)
+        {
+            if(!filter.empty() && it->name.find(filter) == std::string::npos)
+            {
+                continue;
+            }
+
+            // Double the batch until it shows up on the clock, then scale it to the batch time.
+            uint64_t iterations = 1;
+            uint64_t elapsed = 0;
+            it->kernel();
+            while(true)
+            {
+                elapsed = timeBatch(it->kernel, iterations);
+                if(elapsed >= batchTime / 4 || iterations >= MaxIterations)
+                {
+                    break;
+                }
+                iterations *= 2;
+            }
+            iterations = std::min(std::max<uint64_t>(iterations * batchTime / std::max<uint64_t>(elapsed, 1), 1), MaxIterations);
+
+            std::vector<double> samples;
+            for(int i = 0; i < Samples; ++i)
+            {
+                samples.push_back(timeBatch(it->kernel, iterations) * 1000.0 / iterations);
+            }
+            std::nth_element(samples.begin(), samples.begin() + Samples / 2, samples.end());
+
+            Result result;
+            result.name = it->name;
+            result.iterations = iterations * Samples;
+            result.nanoseconds = samples[Samples / 2];
+            result.baseline = 0.0;
+            results.push_back(result);
+        }
+    }
+
+    const std::vector<Benchmark::Result>& Benchmark::getResults() const
+    {
+        return results;
+    }
+
+    bool Benchmark::write(const std::string& filename) const
+    {
+        std::ostringstream out;
+        out << "{\"benchmarks\":[";
+        for(auto it = results.begin(), end = results.end(); it != end; ++it)
+        {
+            out << (it == results.begin() ? "\n" : ",\n")
+                << "{\"name\":\"" << it->name << "\",\"iterations\":" << it->iterations << ",\"ns\":" << it->nanoseconds;
+            if(it->baseline > 0.0)
+            {
+                out << ",\"baseline_ns\":" << it->baseline << ",\"change\":" << it->nanoseconds / it->baseline - 1.0;
+            }
+            out << "}";
+        }
+        out << "\n]}\n";
+
+        File f(filename, FileWrite);
+        if(!f.isActive())
+        {
+            return false;
+        }
+        auto s = out.str();
+        return f.writeRaw(s.data(), s.size()) == s.size();
+    }
+
+    bool Benchmark::compare(const std::string& filename)
+    {
+        File f(filename, FileRead);
+        if(!f.isActive())
+        {
+            return false;
+        }
+
+        std::string line;
+        while(f.readLine(line))
+        {
+            std::string name, ns;
+            if(!findField(line, "name", name) || !findField(line, "ns", ns))
+            {
+                continue;
+            }
+            for(auto it = results.begin(), end = results.end(); it != end; ++it)
+            {
+                if(it->name == name)
+                {
+                    it->baseline = atof(ns.c_str());
+                    break;
+                }
+            }
+        }
+        return true;
+    }
+
+    int Benchmark::countRegressions(double tolerance) const
+    {
+        int count = 0;
+        for(auto it = results.begin(), end = results.end(); it != end; ++it)
+        {
+            if(it->baseline > 0.0 && it->nanoseconds > it->baseline * (1.0 + tolerance))
+            {
+                ++count;
+            }
+        }
+        return count;
+    }
+
+    void Benchmark::report(double tolerance) const
+    {
+        for(auto it = results.begin(), end = results.end(); it != end; ++it)
+        {
+            if(it->baseline > 0.0)
+            {
+                double change = it->nanoseconds / it->baseline - 1.0;
+                std::printf("%-40s %12.1f ns %12.1f ns %+7.1f%%%s\n", it->name.c_str(), it->nanoseconds, it->baseline,
+                    change * 100.0, change > tolerance ? " SLOWER" : "");
+            }
+            else
+            {
+                std::printf("%-40s %12.1f ns\n", it->name.c_str(), it->nanoseconds);
+            }
+        }
+    }
+
+    void addBlendBenchmarks(Benchmark& bench)
+    {
+        addBlendMode<BlendOpaque>(bench, "opaque");
+        addBlendMode<BlendMerge>(bench, "merge");
+        addBlendMode<BlendPreserve>(bench, "preserve");
+        addBlendMode<BlendAdd>(bench, "add");
+        addBlendMode<BlendSubtract>(bench, "subtract");
+    }
+
+    // Everything draws onto a screen-sized canvas, the most common target.
+    void addCanvasBenchmarks(Benchmark& bench)
+    {
+        auto dest = makePattern(320, 240);
+        Color color(200, 120, 40, 160);
+
+        bench.add("canvas/line/short", [dest, color]() { dest->line<BlendPreserve>(100, 100, 110, 104, color); });
+        bench.add("canvas/line/long", [dest, color]() { dest->line<BlendPreserve>(0, 0, 319, 239, color); });
+        bench.add("canvas/line/horizontal", [dest, color]() { dest->line<BlendPreserve>(0, 120, 319, 120, color); });
+        bench.add("canvas/line/clipped", [dest, color]() { dest->line<BlendPreserve>(-400, -100, 700, 340, color); });
+
+        bench.add("canvas/ellipse/8", [dest, color]() { dest->ellipse<BlendPreserve>(160, 120, 8, 8, color); });
+        bench.add("canvas/ellipse/64", [dest, color]() { dest->ellipse<BlendPreserve>(160, 120, 64, 48, color); });
+        bench.add("canvas/ellipse/clipped", [dest, color]() { dest->ellipse<BlendPreserve>(0, 0, 200, 150, color); });
+        bench.add("canvas/fillEllipse/8", [dest, color]() { dest->fillEllipse<BlendPreserve>(160, 120, 8, 8, color); });
+        bench.add("canvas/fillEllipse/64", [dest, color]() { dest->fillEllipse<BlendPreserve>(160, 120, 64, 48, color); });
+        bench.add("canvas/fillEllipse/clipped", [dest, color]() { dest->fillEllipse<BlendPreserve>(0, 0, 200, 150, color); });
+
+        addBlits(bench, dest, 16);
+        addBlits(bench, dest, 64);
+        addBlits(bench, dest, 256);
+
+        auto source = makePattern(64, 64);
+        bench.add("canvas/scaleBlitRegion/64/up", [source, dest]() { source->scaleBlitRegion<BlendPreserve>(0, 0, 63, 63, 8, 8, 128, 128, *dest); });
+        bench.add("canvas/scaleBlitRegion/64/down", [source, dest]() { source->scaleBlitRegion<BlendPreserve>(0, 0, 63, 63, 8, 8, 32, 32, *dest); });
+        bench.add("canvas/scaleBlitRegion/64/edge", [source, dest]() { source->scaleBlitRegion<BlendPreserve>(0, 0, 63, 63, 256, 176, 128, 128, *dest); });
+        bench.add("canvas/rotateScaleBlitRegion/64/rotate", [source, dest]() { source->rotateScaleBlitRegion<BlendPreserve>(0, 0, 63, 63, 160, 120, 30.0, 1.0, *dest); });
+        bench.add("canvas/rotateScaleBlitRegion/64/scale", [source, dest]() { source->rotateScaleBlitRegion<BlendPreserve>(0, 0, 63, 63, 160, 120, 30.0, 2.0, *dest); });
+        bench.add("canvas/rotateScaleBlitRegion/64/edge", [source, dest]() { source->rotateScaleBlitRegion<BlendPreserve>(0, 0, 63, 63, 316, 236, 30.0, 2.0, *dest); });
+    }
+
+    void addTilemapBenchmarks(Benchmark& bench, Screen& screen)
+    {
+        auto map = std::make_shared<Tilemap>(256, 256);
+        auto small = std::make_shared<Tilemap>(32, 32);
+        small->clear(3);
+        for(int ty = 0; ty < 256; ++ty)
+        {
+            for(int tx = 0; tx < 256; ++tx)
+            {
+                map->setTile(tx, ty, (tx * 7 + ty * 3) % 256);
+            }
+        }
+
+        bench.add("tilemap/clear", [map]() { map->clear(1); });
+        bench.add("tilemap/solidRect", [map]() { map->solidRect(16, 16, 143, 143, 2); });
+        bench.add("tilemap/rect", [map]() { map->rect(16, 16, 143, 143, 2); });
+        bench.add("tilemap/line", [map]() { map->line(0, 0, 255, 200, 4); });
+        bench.add("tilemap/stamp", [map, small]() { small->stamp(40, 40, map.get()); });
+
+        // A 16x16 sheet of 16x16 tiles, with enough of the map to cover the screen.
+        auto sprite = std::make_shared<Sprite>(Image(*makePattern(256, 256)), 16, 16);
+        sprite->setColumns(16);
+        sprite->setPadding(0);
+        Screen* target = &screen;
+        int tilesWide = screen.getWidth() / 16 + 1;
+        int tilesHigh = screen.getHeight() / 16 + 1;
+        bench.add("tilemap/blit", [map, sprite, target, tilesWide, tilesHigh]()
+        {
+            map->blit(*target, *sprite, 37, 21, 0, 0, tilesWide, tilesHigh);
+        });
+    }
+
+    void addFontBenchmarks(Benchmark& bench, Screen& screen)
+    {
+        // Fonts find their glyph size from the grid lines, so draw a sheet of 6x8 cells.
+        const int GlyphWidth = 6;
+        const int GlyphHeight = 8;
+        Canvas sheet(Font::FontColumns * (GlyphWidth + 1) + 1, Font::FontRows * (GlyphHeight + 1) + 1);
+        Color* pixel = sheet.getData();
+        for(int y = 0; y < sheet.getHeight(); ++y)
+        {
+            for(int x = 0; x < sheet.getWidth(); ++x, ++pixel)
+            {
+                if(x % (GlyphWidth + 1) == 0 || y % (GlyphHeight + 1) == 0)
+                {
+                    *pixel = Color(255, 0, 255, 255);
+                }
+                else
+                {
+                    *pixel = (x * 3 + y) % 4 ? Color(0, 0, 0, 0) : Color(255, 255, 255, 255);
+                }
+            }
+        }
+        auto font = std::make_shared<Font>(sheet);
+
+        std::string text = "The quick brown fox jumps over the lazy dog. Pack my box with five dozen liquor jugs.";
+        std::string paragraph;
+        for(int i = 0; i < 8; ++i)
+        {
+            paragraph += text + " ";
+        }
+
+        Screen* target = &screen;
+        bench.add("font/print", [font, text, target]()
+        {
+            target->startBatch();
+            font->print(4, 4, text, BlendPreserve);
+            target->endBatch();
+        });
+        bench.add("font/wrapText", [font, paragraph]() { font->wrapText(paragraph, 200); });
+    }
+}
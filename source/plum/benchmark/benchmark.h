@@ -0,0 +1,79 @@
+#ifndef PLUM_BENCHMARK_H
+#define PLUM_BENCHMARK_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <functional>
+
+namespace plum
+{
+    class Screen;
+
+    // Times small kernels on their own, so a change can be measured against a saved run.
+    // Each case is run in batches until a batch is long enough to time, and the median
+    // of several batches is kept, which keeps one slow batch from skewing the result.
+    class Benchmark
+    {
+        public:
+            typedef std::function<void()> Kernel;
+
+            // Time spent on each case, in microseconds, split across the samples.
+            static const int DefaultCaseTime = 250 * 1000;
+            static const int Samples = 9;
+
+            struct Result
+            {
+                std::string name;
+                uint64_t iterations;
+                // Median time for one call of the kernel.
+                double nanoseconds;
+                // Same thing from the baseline, or zero if the case wasn't in it.
+                double baseline;
+            };
+
+            Benchmark(int caseTime = DefaultCaseTime);
+            ~Benchmark();
+
+            void add(const std::string& name, const Kernel& kernel);
+
+            // Runs every case with the filter somewhere in its name. An empty filter runs them all.
+            void run(const std::string& filter = "");
+            const std::vector<Result>& getResults() const;
+
+            // Saves the results as JSON, one case per line.
+            bool write(const std::string& filename) const;
+            // Reads a file saved by write(), and fills in the baseline of each matching result.
+            bool compare(const std::string& filename);
+            // Number of cases that got slower than their baseline by more than the tolerance, as a fraction.
+            int countRegressions(double tolerance) const;
+            // Prints a table of the results, marking regressions.
+            void report(double tolerance) const;
+
+        private:
+            struct Case
+            {
+                std::string name;
+                Kernel kernel;
+            };
+
+            int caseTime;
+            std::vector<Case> cases;
+            std::vector<Result> results;
+
+            Benchmark(const Benchmark&);
+            void operator =(const Benchmark&);
+    };
+
+    // The engine's own kernels. Tilemap and font cases draw onto the screen, so one needs to be open.
+    // plumbench builds on the software platform, so that's a canvas in memory, not a window.
+    void addBlendBenchmarks(Benchmark& bench);
+    void addCanvasBenchmarks(Benchmark& bench);
+    void addTilemapBenchmarks(Benchmark& bench, Screen& screen);
+    void addFontBenchmarks(Benchmark& bench, Screen& screen);
+    // Goes straight to plaidaudio, and renders on offline systems of its own, so no device is needed.
+    void addAudioBenchmarks(Benchmark& bench);
+}
+
+#endif
@@ -0,0 +1,115 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <algorithm>
+
+#include "benchmark.h"
+#include "../core/log.h"
+#include "../core/screen.h"
+#include "../core/engine.h"
+
+// Times the engine's kernels on their own, with no window, GL context or sound card.
+//
+//   plumbench [-baseline file] [-filter text] [-time ms] [-tolerance percent] [results.json]
+//
+// Results are saved as JSON, one case per line, to benchmark.json unless another file is given.
+// With a baseline saved by an earlier run, the table shows the change in each case,
+// and the exit status is 1 if anything slowed down by more than the tolerance (10% by default).
+
+namespace
+{
+    struct Options
+    {
+        std::string output;
+        std::string baseline;
+        std::string filter;
+        int caseTime;
+        int tolerance;
+
+        Options()
+            : output("benchmark.json"), caseTime(plum::Benchmark::DefaultCaseTime / 1000), tolerance(10)
+        {
+        }
+    };
+
+    bool parseOptions(int argc, char** argv, Options& options)
+    {
+        for(int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            if(arg[0] != '-')
+            {
+                options.output = arg;
+                continue;
+            }
+            if(i + 1 == argc)
+            {
+                return false;
+            }
+            std::string value = argv[++i];
+            if(arg == "-baseline")
+            {
+                options.baseline = value;
+            }
+            else if(arg == "-filter")
+            {
+                options.filter = value;
+            }
+            else if(arg == "-time")
+            {
+                options.caseTime = std::max(std::atoi(value.c_str()), 1);
+            }
+            else if(arg == "-tolerance")
+            {
+                options.tolerance = std::max(std::atoi(value.c_str()), 0);
+            }
+            else
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if(!parseOptions(argc, argv, options))
+    {
+        std::fprintf(stderr, "usage: %s [-baseline file] [-filter text] [-time ms] [-tolerance percent] [results.json]\n", argv[0]);
+        return 2;
+    }
+
+    plum::clearLog();
+    try
+    {
+        plum::Engine engine;
+        // The default game resolution, which is what the tilemap and font cases draw onto.
+        plum::Screen screen(engine, 320, 240, 1, true);
+
+        plum::Benchmark bench(options.caseTime * 1000);
+        plum::addBlendBenchmarks(bench);
+        plum::addCanvasBenchmarks(bench);
+        plum::addTilemapBenchmarks(bench, screen);
+        plum::addFontBenchmarks(bench, screen);
+        plum::addAudioBenchmarks(bench);
+        bench.run(options.filter);
+
+        if(!options.baseline.empty() && !bench.compare(options.baseline))
+        {
+            std::fprintf(stderr, "Couldn't read benchmark baseline '%s'.\n", options.baseline.c_str());
+        }
+        double tolerance = options.tolerance / 100.0;
+        bench.report(tolerance);
+        if(!bench.write(options.output))
+        {
+            engine.quit("Couldn't write benchmark results to '" + options.output + "'.\n");
+        }
+        return bench.countRegressions(tolerance) ? 1 : 0;
+    }
+    catch(const plum::SystemExit& e)
+    {
+        return e.status();
+    }
+}
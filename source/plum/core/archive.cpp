@@ -0,0 +1,360 @@
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <zlib.h>
+
+#include "file.h"
+#include "thread.h"
+#include "archive.h"
+
+namespace plum
+{
+    namespace
+    {
+        const char Magic[4] = { 'P', 'I', 'T', '1' };
+        const size_t HeaderSize = 8;
+        const size_t EntrySize = 28;
+        // Deflate can't shrink anything by more than this, so an entry that claims to has a bad size.
+        const uint64_t MaxCompression = 1032;
+
+        enum EntryField
+        {
+            FieldHash,
+            FieldFlags,
+            FieldNameOffset,
+            FieldNameLength,
+            FieldOffset,
+            FieldStoredSize,
+            FieldSize,
+        };
+
+        uint32_t decodeU32(const uint8_t* p)
+        {
+            return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+        }
+
+        void encodeU32(std::vector<uint8_t>& buffer, uint32_t value)
+        {
+            buffer.push_back(uint8_t(value));
+            buffer.push_back(uint8_t(value >> 8));
+            buffer.push_back(uint8_t(value >> 16));
+            buffer.push_back(uint8_t(value >> 24));
+        }
+
+        // FNV-1a
+        uint32_t hashName(const std::string& name)
+        {
+            uint32_t hash = 2166136261u;
+            for(auto it = name.begin(), end = name.end(); it != end; ++it)
+            {
+                hash ^= uint8_t(*it);
+                hash *= 16777619u;
+            }
+            return hash;
+        }
+
+        Mutex mountMutex;
+        std::vector<std::shared_ptr<Archive>> mounted;
+    }
+
+    class Archive::Impl
+    {
+        public:
+            Impl(const std::string& filename)
+                : mapping(filename), data(nullptr), size(0), entryCount(0)
+            {
+                if(!mapping.getData() || mapping.getSize() < HeaderSize)
+                {
+                    return;
+                }
+
+                uint32_t count = decodeU32(mapping.getData() + 4);
+                if(std::memcmp(mapping.getData(), Magic, sizeof(Magic)) != 0 || count > (mapping.getSize() - HeaderSize) / EntrySize)
+                {
+                    return;
+                }
+                data = mapping.getData();
+                size = mapping.getSize();
+                entryCount = count;
+            }
+
+            uint32_t field(uint32_t index, EntryField f) const
+            {
+                return decodeU32(data + HeaderSize + index * EntrySize + f * 4);
+            }
+
+            FileMapping mapping;
+            const uint8_t* data;
+            size_t size;
+            uint32_t entryCount;
+    };
+
+    Archive::Archive(const std::string& filename)
+        : impl(new Impl(filename))
+    {
+    }
+
+    Archive::~Archive()
+    {
+    }
+
+    bool Archive::isActive() const
+    {
+        return impl->data != nullptr;
+    }
+
+    int Archive::getEntryCount() const
+    {
+        return int(impl->entryCount);
+    }
+
+    bool Archive::read(const std::string& name, const uint8_t*& data, size_t& size, std::shared_ptr<void>& owner) const
+    {
+        if(!isActive())
+        {
+            return false;
+        }
+
+        auto key = normalize(name);
+        auto hash = hashName(key);
+
+        // Find the first entry with a matching hash, then check the names of everything that shares it.
+        uint32_t low = 0;
+        uint32_t high = impl->entryCount;
+        while(low < high)
+        {
+            uint32_t middle = low + (high - low) / 2;
+            if(impl->field(middle, FieldHash) < hash)
+            {
+                low = middle + 1;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+
+        for(uint32_t i = low; i < impl->entryCount && impl->field(i, FieldHash) == hash; ++i)
+        {
+            uint32_t nameOffset = impl->field(i, FieldNameOffset);
+            uint32_t nameLength = impl->field(i, FieldNameLength);
+            if(nameLength != key.size() || nameOffset > impl->size || nameLength > impl->size - nameOffset
+                || std::memcmp(impl->data + nameOffset, key.data(), nameLength) != 0)
+            {
+                continue;
+            }
+
+            uint32_t offset = impl->field(i, FieldOffset);
+            uint32_t storedSize = impl->field(i, FieldStoredSize);
+            uint32_t fullSize = impl->field(i, FieldSize);
+            if(offset > impl->size || storedSize > impl->size - offset)
+            {
+                return false;
+            }
+
+            if(impl->field(i, FieldFlags) & EntryCompressed)
+            {
+                if(fullSize > uint64_t(storedSize) * MaxCompression)
+                {
+                    return false;
+                }
+                auto buffer = std::make_shared<std::vector<uint8_t>>(fullSize);
+                uLongf length = fullSize;
+                if(fullSize && (uncompress(buffer->data(), &length, impl->data + offset, storedSize) != Z_OK || length != fullSize))
+                {
+                    return false;
+                }
+                data = buffer->data();
+                size = buffer->size();
+                owner = buffer;
+            }
+            else
+            {
+                data = impl->data + offset;
+                size = storedSize;
+                owner = impl;
+            }
+            return true;
+        }
+        return false;
+    }
+
+    bool Archive::mount(const std::string& filename)
+    {
+        auto archive = std::make_shared<Archive>(filename);
+        if(!archive->isActive())
+        {
+            return false;
+        }
+
+        Lock lock(mountMutex);
+        mounted.push_back(archive);
+        return true;
+    }
+
+    void Archive::unmountAll()
+    {
+        Lock lock(mountMutex);
+        mounted.clear();
+    }
+
+    bool Archive::find(const std::string& name, const uint8_t*& data, size_t& size, std::shared_ptr<void>& owner)
+    {
+        // Loader and audio threads open files too, so search a copy of the list.
+        std::vector<std::shared_ptr<Archive>> archives;
+        {
+            Lock lock(mountMutex);
+            if(mounted.empty())
+            {
+                return false;
+            }
+            archives = mounted;
+        }
+
+        for(auto it = archives.rbegin(), end = archives.rend(); it != end; ++it)
+        {
+            if((*it)->read(name, data, size, owner))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool Archive::write(const std::string& filename, const std::vector<std::string>& files, bool compress)
+    {
+        struct Pending
+        {
+            std::string name;
+            uint32_t hash;
+            uint32_t flags;
+            uint32_t size;
+            std::vector<uint8_t> contents;
+
+            bool operator <(const Pending& other) const
+            {
+                return hash < other.hash || (hash == other.hash && name < other.name);
+            }
+        };
+
+        std::vector<Pending> entries;
+        for(auto it = files.begin(), end = files.end(); it != end; ++it)
+        {
+            // Read straight off the disk, so that an archive being rebuilt doesn't get packed from itself.
+            std::FILE* source = std::fopen(it->c_str(), "rb");
+            if(!source)
+            {
+                return false;
+            }
+
+            Pending entry;
+            entry.name = normalize(*it);
+            entry.hash = hashName(entry.name);
+            entry.flags = 0;
+
+            char buffer[16384];
+            size_t count;
+            while((count = std::fread(buffer, 1, sizeof(buffer), source)) > 0)
+            {
+                entry.contents.insert(entry.contents.end(), buffer, buffer + count);
+            }
+            std::fclose(source);
+            entry.size = uint32_t(entry.contents.size());
+
+            if(compress && !entry.contents.empty())
+            {
+                // zlib 1.1 has no compressBound(), so this is the bound its documentation gives for compress2().
+                uLongf length = uLongf(entry.contents.size() + entry.contents.size() / 1000 + 12 + 1);
+                std::vector<uint8_t> packed(length);
+                if(compress2(packed.data(), &length, entry.contents.data(), uLong(entry.contents.size()), Z_BEST_COMPRESSION) == Z_OK
+                    && length < entry.contents.size())
+                {
+                    packed.resize(length);
+                    entry.contents.swap(packed);
+                    entry.flags |= EntryCompressed;
+                }
+            }
+            entries.push_back(entry);
+        }
+
+        std::sort(entries.begin(), entries.end());
+        for(size_t i = 1; i < entries.size(); ++i)
+        {
+            if(entries[i].name == entries[i - 1].name)
+            {
+                return false;
+            }
+        }
+
+        std::vector<uint8_t> header;
+        header.insert(header.end(), Magic, Magic + sizeof(Magic));
+        encodeU32(header, uint32_t(entries.size()));
+
+        size_t offset = HeaderSize + entries.size() * EntrySize;
+        std::vector<uint32_t> nameOffsets;
+        for(auto it = entries.begin(), end = entries.end(); it != end; ++it)
+        {
+            nameOffsets.push_back(uint32_t(offset));
+            offset += it->name.size();
+        }
+        for(size_t i = 0; i < entries.size(); ++i)
+        {
+            const Pending& entry(entries[i]);
+            encodeU32(header, entry.hash);
+            encodeU32(header, entry.flags);
+            encodeU32(header, nameOffsets[i]);
+            encodeU32(header, uint32_t(entry.name.size()));
+            encodeU32(header, uint32_t(offset));
+            encodeU32(header, uint32_t(entry.contents.size()));
+            encodeU32(header, entry.size);
+            offset += entry.contents.size();
+        }
+        if(offset > 0xFFFFFFFFu)
+        {
+            return false;
+        }
+
+        File f(filename, FileWrite);
+        if(!f.isActive() || f.writeRaw(header.data(), header.size()) != header.size())
+        {
+            return false;
+        }
+        for(auto it = entries.begin(), end = entries.end(); it != end; ++it)
+        {
+            if(!f.writeString(it->name))
+            {
+                return false;
+            }
+        }
+        for(auto it = entries.begin(), end = entries.end(); it != end; ++it)
+        {
+            if(!it->contents.empty() && f.writeRaw(it->contents.data(), it->contents.size()) != it->contents.size())
+            {
+                return false;
+            }
+        }
+        // The last of it is still buffered, and a full disk only shows up here.
+        return f.flush() && f.close();
+    }
+
+    std::string Archive::normalize(const std::string& name)
+    {
+        std::string result(name);
+        for(auto it = result.begin(), end = result.end(); it != end; ++it)
+        {
+            if(*it == '\\')
+            {
+                *it = '/';
+            }
+            else if(*it >= 'A' && *it <= 'Z')
+            {
+                *it = *it - 'A' + 'a';
+            }
+        }
+        while(result.compare(0, 2, "./") == 0)
+        {
+            result.erase(0, 2);
+        }
+        return result;
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef PLUM_ARCHIVE_H
+#define PLUM_ARCHIVE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+namespace plum
+{
+    // A .pit file, which packs a game's files into one. It gets mapped into memory once,
+    // and its table of contents is sorted by name hash, so finding a file never touches the disk.
+    //
+    // Layout, with every number a little-endian uint32:
+    //     header      "PIT1", entry count
+    //     entries     hash, flags, name offset, name length, data offset, stored size, size
+    //                 (sorted by hash, then name)
+    //     the names and contents of the files, wherever the entries point.
+    //
+    // Names are stored normalized (see normalize()), so lookups don't care about case or slash direction.
+    class Archive
+    {
+        public:
+            enum EntryFlags
+            {
+                // Contents are zlib-compressed. Anything else is stored as-is, and read without copying.
+                EntryCompressed = 1,
+            };
+
+            // Maps an archive into memory. Check isActive() to see if it worked.
+            Archive(const std::string& filename);
+            ~Archive();
+
+            bool isActive() const;
+            int getEntryCount() const;
+
+            // Gets the contents of a file within the archive. The data stays valid for as long as owner is held.
+            bool read(const std::string& name, const uint8_t*& data, size_t& size, std::shared_ptr<void>& owner) const;
+
+            // Mounted archives get searched, most recently mounted first, whenever a file is opened for reading.
+            static bool mount(const std::string& filename);
+            static void unmountAll();
+            static bool find(const std::string& name, const uint8_t*& data, size_t& size, std::shared_ptr<void>& owner);
+
+            // Packs loose files into a new archive. Files only get compressed when it actually saves space.
+            static bool write(const std::string& filename, const std::vector<std::string>& files, bool compress);
+
+            // Lowercase, forward slashes, and no leading "./".
+            static std::string normalize(const std::string& name);
+
+            class Impl;
+            std::shared_ptr<Impl> impl;
+
+        private:
+            Archive(const Archive&);
+            void operator =(const Archive&);
+    };
+}
+
+#endif
@@ -11,6 +11,53 @@ namespace plum
     class Sound;
     class Audio;
 
+    // Which voice gives way when more sounds want to play than the voice limit allows.
+    enum VoiceSteal
+    {
+        StealLowestPriority,    // Lowest sound priority, oldest first among equals
+        StealQuietest,          // Lowest channel volume, oldest first among equals
+        StealOldest             // Whatever started playing first
+    };
+
+    // A snapshot of how well the audio engine is keeping up. Counts are totals since startup.
+    struct AudioStats
+    {
+        enum { HistogramSize = 16 };
+
+        // Audio callbacks, and how long they took, in seconds.
+        // Bucket i of the histogram counts callbacks under 2^i microseconds, and the last also takes anything slower.
+        unsigned int callbacks;
+        unsigned int callbackHistogram[HistogramSize];
+        double callbackAverage;
+        double callbackLongest;
+        // Fraction of the audio thread's time budget in use, right now.
+        double load;
+
+        // Callbacks that ran out of queued frames, or had to trim some to catch up.
+        unsigned int underflows;
+        unsigned int overflows;
+        // Reports from the audio thread that were dropped before they could be counted.
+        unsigned int lostReports;
+
+        // Voices the mixer heard in its last callback, and the most it's ever heard at once.
+        int mixedVoices;
+        int peakVoices;
+        // Channels playing, and channels stolen but keeping time.
+        int activeVoices;
+        int virtualVoices;
+        // Time to pull one voice's stream, in seconds.
+        double pullAverage;
+        double pullLongest;
+
+        // Scratch arena size and high-water mark in samples, and requests it had to turn down.
+        unsigned int scratchSize;
+        unsigned int scratchPeak;
+        unsigned int scratchDenied;
+
+        // Times a prefetched stream ran dry.
+        unsigned int streamUnderruns;
+    };
+
     class Channel
     {
         public:
@@ -40,6 +87,13 @@ namespace plum
             Sound();
             ~Sound();
 
+            // Higher priority voices win out when voices are being stolen.
+            int getPriority() const;
+            void setPriority(int value);
+            // How many channels may play this sound at once, with the oldest stopped to make room. Zero means no limit.
+            int getMaxInstances() const;
+            void setMaxInstances(int value);
+
             class Impl;
             std::shared_ptr<Impl> impl;
     };
@@ -60,6 +114,38 @@ namespace plum
             void setPitch(double value);
             void setVolume(double value);
 
+            // Sounds up to the threshold size (in bytes of decoded audio) are decoded once and kept in memory.
+            // When the total passes the budget, the least recently played sounds are dropped first.
+            // Anything bigger than the threshold is streamed from disk on every play.
+            size_t getCacheBudget() const;
+            size_t getCacheThreshold() const;
+            size_t getCacheUsage() const;
+            void setCacheBudget(size_t bytes);
+            void setCacheThreshold(size_t bytes);
+
+            // Streamed sounds are decoded on this many background threads, kept roughly the given time ahead of playback.
+            // With no threads, they decode inside the audio callback instead.
+            int getDecoderThreads() const;
+            int getPrefetchMilliseconds() const;
+            void setDecoderThreads(int threadCount, int milliseconds);
+            // Caps how many channels get mixed at once. Zero means no limit.
+            // Past the limit, a voice is stolen, though streamed voices only go when nothing else is playing. Stolen voices playing cached clips go virtual: they keep time without
+            // being mixed, and pick up where they'd have been once there's room. Streamed voices are just stopped.
+            int getVoiceLimit() const;
+            VoiceSteal getVoiceSteal() const;
+            void setVoiceLimit(int count);
+            void setVoiceSteal(VoiceSteal policy);
+            int getActiveVoices() const;
+            int getVirtualVoices() const;
+
+            // How often a streamed sound has run dry and played silence since the decoder threads were set.
+            unsigned int getUnderruns() const;
+
+            AudioStats getStats() const;
+            // Writes a stats summary to the log every so many seconds. Zero turns it off.
+            double getStatsLogInterval() const;
+            void setStatsLogInterval(double seconds);
+
             class Impl;
             std::shared_ptr<Impl> impl;
     };
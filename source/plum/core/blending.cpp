@@ -1,10 +1,197 @@
 #include "blending.h"
 
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PLUM_BLEND_SSE2
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
 namespace plum
 {
     namespace
     {
         int globalAlpha = 255;
+
+        typedef void (*SpanFunc)(const Color* source, Color* dest, int count, int opacity);
+
+        template<BlendMode Blend> void scalarSpan(const Color* source, Color* dest, int count, int opacity)
+        {
+            for(int i = 0; i < count; ++i)
+            {
+                blend<Blend>(source[i], dest[i], opacity);
+            }
+        }
+
+#ifdef PLUM_BLEND_SSE2
+        bool hasSSE2()
+        {
+#if defined(_M_X64) || defined(__x86_64__)
+            return true;
+#elif defined(_MSC_VER)
+            int info[4];
+            __cpuid(info, 1);
+            return (info[3] & (1 << 26)) != 0;
+#else
+            unsigned int a, b, c, d;
+            return __get_cpuid(1, &a, &b, &c, &d) && (d & (1 << 26)) != 0;
+#endif
+        }
+
+        // The SSE2 kernels work on four pixels at a time, widened to 16 bits per channel.
+        // Everything is integer math that matches the scalar blend functions exactly:
+        // x / 255 is computed as (x + 1 + (x >> 8)) >> 8, which is exact for every x <= 255 * 255.
+        inline __m128i divide255(__m128i x)
+        {
+            return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(x, _mm_set1_epi16(1)), _mm_srli_epi16(x, 8)), 8);
+        }
+
+        // Copies each pixel's alpha channel to all four of its 16-bit lanes.
+        inline __m128i broadcastAlpha(__m128i x)
+        {
+            return _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        }
+
+        // Source alpha scaled by the opacity, for the two pixels in x.
+        inline __m128i sourceAlpha(__m128i x, __m128i opacity)
+        {
+            return divide255(_mm_mullo_epi16(broadcastAlpha(x), opacity));
+        }
+
+        const uint32_t AlphaMask = 0xFF000000;
+
+        template<BlendMode Blend> struct Kernel;
+
+        template<> struct Kernel<BlendPreserve>
+        {
+            static __m128i half(__m128i s, __m128i d, __m128i opacity)
+            {
+                // Computed as d + a * (s - d) / 255, with the division truncating towards zero like the scalar code.
+                __m128i a = sourceAlpha(s, opacity);
+                __m128i up = divide255(_mm_mullo_epi16(a, _mm_subs_epu16(s, d)));
+                __m128i down = divide255(_mm_mullo_epi16(a, _mm_subs_epu16(d, s)));
+                return _mm_sub_epi16(_mm_add_epi16(d, up), down);
+            }
+        };
+
+        template<> struct Kernel<BlendAdd>
+        {
+            static __m128i half(__m128i s, __m128i d, __m128i opacity)
+            {
+                // Clamping to 255 happens when packing back down to bytes.
+                return _mm_add_epi16(d, divide255(_mm_mullo_epi16(sourceAlpha(s, opacity), s)));
+            }
+        };
+
+        template<> struct Kernel<BlendSubtract>
+        {
+            static __m128i half(__m128i s, __m128i d, __m128i opacity)
+            {
+                return _mm_subs_epu16(d, divide255(_mm_mullo_epi16(sourceAlpha(s, opacity), s)));
+            }
+        };
+
+        // Preserve, add and subtract all keep the destination alpha.
+        template<BlendMode Blend> void sse2Span(const Color* source, Color* dest, int count, int opacity)
+        {
+            // Out of range opacities can overflow the 16-bit lanes, so leave those to the scalar version.
+            if(opacity < 0 || opacity > 255)
+            {
+                scalarSpan<Blend>(source, dest, count, opacity);
+                return;
+            }
+
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i alpha = _mm_set1_epi32(AlphaMask);
+            const __m128i op = _mm_set1_epi16(short(opacity));
+
+            int i = 0;
+            for(; i + 4 <= count; i += 4)
+            {
+                __m128i s = _mm_loadu_si128((const __m128i*) (source + i));
+                __m128i d = _mm_loadu_si128((const __m128i*) (dest + i));
+                __m128i lo = Kernel<Blend>::half(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero), op);
+                __m128i hi = Kernel<Blend>::half(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero), op);
+                __m128i result = _mm_packus_epi16(lo, hi);
+                result = _mm_or_si128(_mm_andnot_si128(alpha, result), _mm_and_si128(alpha, d));
+                _mm_storeu_si128((__m128i*) (dest + i), result);
+            }
+            scalarSpan<Blend>(source + i, dest + i, count - i, opacity);
+        }
+
+        template<> void sse2Span<BlendMerge>(const Color* source, Color* dest, int count, int opacity)
+        {
+            if(opacity < 0 || opacity > 255)
+            {
+                scalarSpan<BlendMerge>(source, dest, count, opacity);
+                return;
+            }
+
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i full = _mm_set1_epi16(255);
+            const __m128i alpha = _mm_set1_epi32(AlphaMask);
+            const __m128i op = _mm_set1_epi32(opacity);
+
+            int i = 0;
+            for(; i + 4 <= count; i += 4)
+            {
+                __m128i s = _mm_loadu_si128((const __m128i*) (source + i));
+                __m128i d = _mm_loadu_si128((const __m128i*) (dest + i));
+
+                // The alpha math is done once per pixel, in 32-bit lanes.
+                __m128i sourceAlpha = divide255(_mm_mullo_epi16(_mm_srli_epi32(s, 24), op));
+                __m128i destAlpha = _mm_srli_epi32(d, 24);
+                __m128i finalAlpha = _mm_add_epi32(sourceAlpha,
+                    divide255(_mm_mullo_epi16(_mm_sub_epi32(_mm_set1_epi32(255), sourceAlpha), destAlpha)));
+
+                // The quotient is at least 1/255 away from the next integer whenever it isn't one,
+                // so single precision division truncates to the same value as integer division.
+                __m128i weight = _mm_cvttps_epi32(_mm_div_ps(
+                    _mm_cvtepi32_ps(_mm_mullo_epi16(sourceAlpha, _mm_set1_epi32(255))),
+                    _mm_cvtepi32_ps(finalAlpha)));
+                weight = _mm_andnot_si128(_mm_cmpeq_epi32(finalAlpha, _mm_setzero_si128()), weight);
+
+                // Spread each pixel's weight across its four 16-bit channel lanes.
+                weight = _mm_or_si128(weight, _mm_slli_epi32(weight, 16));
+                __m128i weightLo = _mm_unpacklo_epi32(weight, weight);
+                __m128i weightHi = _mm_unpackhi_epi32(weight, weight);
+
+                __m128i sLo = _mm_unpacklo_epi8(s, zero);
+                __m128i sHi = _mm_unpackhi_epi8(s, zero);
+                __m128i dLo = _mm_unpacklo_epi8(d, zero);
+                __m128i dHi = _mm_unpackhi_epi8(d, zero);
+                __m128i lo = divide255(_mm_add_epi16(_mm_mullo_epi16(weightLo, sLo), _mm_mullo_epi16(_mm_sub_epi16(full, weightLo), dLo)));
+                __m128i hi = divide255(_mm_add_epi16(_mm_mullo_epi16(weightHi, sHi), _mm_mullo_epi16(_mm_sub_epi16(full, weightHi), dHi)));
+
+                __m128i result = _mm_packus_epi16(lo, hi);
+                result = _mm_or_si128(_mm_andnot_si128(alpha, result), _mm_slli_epi32(finalAlpha, 24));
+                _mm_storeu_si128((__m128i*) (dest + i), result);
+            }
+            scalarSpan<BlendMerge>(source + i, dest + i, count - i, opacity);
+        }
+
+        const bool useSSE2 = hasSSE2();
+
+        template<BlendMode Blend> SpanFunc pickSpan()
+        {
+            return useSSE2 ? sse2Span<Blend> : scalarSpan<Blend>;
+        }
+#else
+        template<BlendMode Blend> SpanFunc pickSpan()
+        {
+            return scalarSpan<Blend>;
+        }
+#endif
+
+        const SpanFunc mergeSpan = pickSpan<BlendMerge>();
+        const SpanFunc preserveSpan = pickSpan<BlendPreserve>();
+        const SpanFunc addSpan = pickSpan<BlendAdd>();
+        const SpanFunc subtractSpan = pickSpan<BlendSubtract>();
     }
 
     int getOpacity()
@@ -16,4 +203,32 @@ namespace plum
     {
         globalAlpha = alpha;
     }
+
+    template<> void blendSpan<BlendOpaque>(const Color* source, Color* dest, int count, int opacity)
+    {
+        if(count > 0)
+        {
+            std::memmove(dest, source, count * sizeof(Color));
+        }
+    }
+
+    template<> void blendSpan<BlendMerge>(const Color* source, Color* dest, int count, int opacity)
+    {
+        mergeSpan(source, dest, count, opacity);
+    }
+
+    template<> void blendSpan<BlendPreserve>(const Color* source, Color* dest, int count, int opacity)
+    {
+        preserveSpan(source, dest, count, opacity);
+    }
+
+    template<> void blendSpan<BlendAdd>(const Color* source, Color* dest, int count, int opacity)
+    {
+        addSpan(source, dest, count, opacity);
+    }
+
+    template<> void blendSpan<BlendSubtract>(const Color* source, Color* dest, int count, int opacity)
+    {
+        subtractSpan(source, dest, count, opacity);
+    }
 }
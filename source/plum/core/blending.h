@@ -19,16 +19,21 @@ namespace plum
     int getOpacity();
     void setOpacity(int alpha);
 
-    template<BlendMode Blend> void blend(const Color& source, Color& dest);
+    template<BlendMode Blend> void blend(const Color& source, Color& dest, int opacity);
 
-    template<> inline void blend<BlendOpaque>(const Color& source, Color& dest)
+    template<BlendMode Blend> inline void blend(const Color& source, Color& dest)
+    {
+        blend<Blend>(source, dest, getOpacity());
+    }
+
+    template<> inline void blend<BlendOpaque>(const Color& source, Color& dest, int opacity)
     {
         dest = source;
     }
 
-    template<> inline void blend<BlendMerge>(const Color& source, Color& dest)
+    template<> inline void blend<BlendMerge>(const Color& source, Color& dest, int opacity)
     {
-        int sourceAlpha = source[AlphaChannel] * getOpacity() / 255;
+        int sourceAlpha = source[AlphaChannel] * opacity / 255;
         int finalAlpha = sourceAlpha + ((255 - sourceAlpha) * dest[AlphaChannel]) / 255;
         sourceAlpha = (finalAlpha == 0) ? 0 : sourceAlpha * 255 / finalAlpha;
 
@@ -39,9 +44,9 @@ namespace plum
             finalAlpha);
     }
 
-    template<> inline void blend<BlendPreserve>(const Color& source, Color& dest)
+    template<> inline void blend<BlendPreserve>(const Color& source, Color& dest, int opacity)
     {
-        int sourceAlpha = source[AlphaChannel] * getOpacity() / 255;
+        int sourceAlpha = source[AlphaChannel] * opacity / 255;
         dest = Color(
             uint8_t((sourceAlpha * (int(source[RedChannel]) - int(dest[RedChannel]))) / 255 + int(dest[RedChannel])),
             uint8_t((sourceAlpha * (int(source[GreenChannel]) - int(dest[GreenChannel]))) / 255 + int(dest[GreenChannel])),
@@ -49,9 +54,9 @@ namespace plum
             dest[AlphaChannel]);
     }
 
-    template<> inline void blend<BlendAdd>(const Color& source, Color& dest)
+    template<> inline void blend<BlendAdd>(const Color& source, Color& dest, int opacity)
     {
-        int sourceAlpha = source[AlphaChannel] * getOpacity() / 255;
+        int sourceAlpha = source[AlphaChannel] * opacity / 255;
         dest = Color(
             uint8_t(std::min((sourceAlpha * int(source[RedChannel])) / 255 + int(dest[RedChannel]), 255)),
             uint8_t(std::min((sourceAlpha * int(source[GreenChannel])) / 255 + int(dest[GreenChannel]), 255)),
@@ -59,15 +64,46 @@ namespace plum
             dest[AlphaChannel]);
     }
 
-    template<> inline void blend<BlendSubtract>(const Color& source, Color& dest)
+    template<> inline void blend<BlendSubtract>(const Color& source, Color& dest, int opacity)
     {
-        int sourceAlpha = source[AlphaChannel] * getOpacity() / 255;
+        int sourceAlpha = source[AlphaChannel] * opacity / 255;
         dest = Color(
             uint8_t(std::max((sourceAlpha * -int(source[RedChannel])) / 255 + int(dest[RedChannel]), 0)),
             uint8_t(std::max((sourceAlpha * -int(source[GreenChannel])) / 255 + int(dest[GreenChannel]), 0)),
             uint8_t(std::max((sourceAlpha * -int(source[BlueChannel])) / 255 + int(dest[BlueChannel]), 0)),
             dest[AlphaChannel]);
     }
+
+    // Blends a run of count pixels from source onto dest, with the same results as calling blend on each one.
+    // An SSE2 version is picked at runtime when the processor supports it.
+    template<BlendMode Blend> void blendSpan(const Color* source, Color* dest, int count, int opacity);
+
+    template<> void blendSpan<BlendOpaque>(const Color* source, Color* dest, int count, int opacity);
+    template<> void blendSpan<BlendMerge>(const Color* source, Color* dest, int count, int opacity);
+    template<> void blendSpan<BlendPreserve>(const Color* source, Color* dest, int count, int opacity);
+    template<> void blendSpan<BlendAdd>(const Color* source, Color* dest, int count, int opacity);
+    template<> void blendSpan<BlendSubtract>(const Color* source, Color* dest, int count, int opacity);
+
+    // Blends a single color onto a run of count pixels.
+    template<BlendMode Blend> inline void blendFill(Color color, Color* dest, int count, int opacity)
+    {
+        if(count <= 0) return;
+        const int RunSize = 64;
+        Color run[RunSize];
+        std::fill(run, run + std::min(count, RunSize), color);
+        while(count > 0)
+        {
+            int n = std::min(count, RunSize);
+            blendSpan<Blend>(run, dest, n, opacity);
+            dest += n;
+            count -= n;
+        }
+    }
+
+    template<> inline void blendFill<BlendOpaque>(Color color, Color* dest, int count, int opacity)
+    {
+        std::fill(dest, dest + std::max(count, 0), color);
+    }
 }
 
 #endif
\ No newline at end of file
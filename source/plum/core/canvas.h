@@ -8,13 +8,92 @@
 
 #include "color.h"
 #include "blending.h"
+#include "workers.h"
+#include "profile.h"
 
 namespace plum
 {
+    // Keeps track of which parts of a canvas have been drawn on, as a short list of rectangles.
+    // Rectangles that overlap or sit close together are merged, and if there end up being too many,
+    // they all collapse into one bounding box.
+    class DirtyRegion
+    {
+        public:
+            struct Area
+            {
+                int x, y, x2, y2;
+
+                int getSize() const
+                {
+                    return (x2 - x + 1) * (y2 - y + 1);
+                }
+            };
+
+            static const int MaxAreas = 16;
+
+            bool empty() const
+            {
+                return areas.empty();
+            }
+
+            const std::vector<Area>& getAreas() const
+            {
+                return areas;
+            }
+
+            void clear()
+            {
+                areas.clear();
+            }
+
+            void add(int x, int y, int x2, int y2)
+            {
+                Area area = { x, y, x2, y2 };
+                for(size_t i = 0; i < areas.size();)
+                {
+                    const Area& other(areas[i]);
+                    Area merged = {
+                        std::min(area.x, other.x), std::min(area.y, other.y),
+                        std::max(area.x2, other.x2), std::max(area.y2, other.y2)
+                    };
+                    // Worth merging if the combined box doesn't waste much more than the two pieces cover.
+                    if(merged.getSize() <= (area.getSize() + other.getSize()) * 2)
+                    {
+                        area = merged;
+                        areas.erase(areas.begin() + i);
+                        i = 0;
+                    }
+                    else
+                    {
+                        ++i;
+                    }
+                }
+                areas.push_back(area);
+
+                if(areas.size() > MaxAreas)
+                {
+                    Area bounds = areas[0];
+                    for(auto it = areas.begin(), end = areas.end(); it != end; ++it)
+                    {
+                        bounds.x = std::min(bounds.x, it->x);
+                        bounds.y = std::min(bounds.y, it->y);
+                        bounds.x2 = std::max(bounds.x2, it->x2);
+                        bounds.y2 = std::max(bounds.y2, it->y2);
+                    }
+                    areas.assign(1, bounds);
+                }
+            }
+
+        private:
+            std::vector<Area> areas;
+    };
+
     class Canvas
     {
         public:
             static Canvas load(const std::string& filename);
+            // Writes the visible part of the canvas out as a PNG. Returns false if that didn't work.
+            bool save(const std::string& filename) const;
 
             Canvas()
                 : width(0),
@@ -25,7 +104,8 @@ namespace plum
                 clipY(0),
                 clipX2(0),
                 clipY2(0),
-                data(nullptr)
+                data(nullptr),
+                dirty(nullptr)
             {
             }
 
@@ -38,7 +118,8 @@ namespace plum
                 clipY(0),
                 clipX2(width - 1),
                 clipY2(height - 1),
-                data(new Color[width * height])
+                data(new Color[width * height]),
+                dirty(nullptr)
             {
                 clear(Color::Black);
             }
@@ -52,7 +133,8 @@ namespace plum
                 clipY(0),
                 clipX2(width - 1),
                 clipY2(height - 1),
-                data(new Color[trueWidth * trueHeight])
+                data(new Color[trueWidth * trueHeight]),
+                dirty(nullptr)
             {
                 clear(Color::Black);
             }
@@ -66,7 +148,8 @@ namespace plum
                 clipY(other.clipY),
                 clipX2(other.clipX2),
                 clipY2(other.clipY2),
-                data(new Color[other.trueWidth * other.trueHeight])
+                data(new Color[other.trueWidth * other.trueHeight]),
+                dirty(nullptr)
             {
                 std::copy(other.data, other.data + other.trueWidth * other.trueHeight, data);
             }
@@ -80,7 +163,8 @@ namespace plum
                 clipY(other.clipY),
                 clipX2(other.clipX2),
                 clipY2(other.clipY2),
-                data(other.data)
+                data(other.data),
+                dirty(nullptr)
             {
                 other.data = nullptr;
             }
@@ -94,15 +178,43 @@ namespace plum
             {
                 Canvas temp(other);
                 swap(temp);
+                touch(0, 0, trueWidth - 1, trueHeight - 1);
                 return *this;
             }
 
             Canvas& operator =(Canvas&& other)
             {
                 swap(other);
+                touch(0, 0, trueWidth - 1, trueHeight - 1);
                 return *this;
             }
 
+            // Every change to the canvas gets recorded in the region, if there is one.
+            // The region isn't owned by the canvas, and isn't carried over by copies or swaps.
+            void setDirtyRegion(DirtyRegion* region)
+            {
+                dirty = region;
+            }
+
+            DirtyRegion* getDirtyRegion() const
+            {
+                return dirty;
+            }
+
+            // Marks an area as changed. Only needed after writing through getData() directly.
+            void touch(int x, int y, int x2, int y2)
+            {
+                if(!dirty) return;
+                x = std::max(x, 0);
+                y = std::max(y, 0);
+                x2 = std::min(x2, trueWidth - 1);
+                y2 = std::min(y2, trueHeight - 1);
+                if(x <= x2 && y <= y2)
+                {
+                    dirty->add(x, y, x2, y2);
+                }
+            }
+
             void swap(Canvas& other) throw()
             {
                 std::swap(width, other.width);
@@ -185,18 +297,28 @@ namespace plum
             void clear(Color color)
             {
                 if(!data) return;
-                std::fill(data, data + trueWidth * trueHeight, color);
+                profile::Zone zone("Canvas::clear");
+                touch(0, 0, trueWidth - 1, trueHeight - 1);
+                forRows(0, trueHeight - 1, trueWidth, [=](int top, int bottom)
+                {
+                    std::fill(data + top * trueWidth, data + (bottom + 1) * trueWidth, color);
+                });
             }
 
             void replaceColor(Color find, Color replacement)
             {
                 if(!data) return;
-                std::replace(data, data + trueWidth * trueHeight, find, replacement);
+                touch(0, 0, trueWidth - 1, trueHeight - 1);
+                forRows(0, trueHeight - 1, trueWidth, [=](int top, int bottom)
+                {
+                    std::replace(data + top * trueWidth, data + (bottom + 1) * trueWidth, find, replacement);
+                });
             }
 
             void flip(bool horizontal, bool vertical)
             {
                 if(!data) return;
+                touch(0, 0, width - 1, height - 1);
                 if(horizontal)
                 {
                     for(int x = 0; x < width / 2; ++x)
@@ -219,10 +341,46 @@ namespace plum
                 }
             }
 
+            // Copies a w x h block starting at (x, y) into dest, one row after another.
+            // Anything outside of the canvas comes out as 0.
+            void getPixels(int x, int y, int w, int h, Color* dest) const
+            {
+                if(w <= 0 || h <= 0) return;
+                std::fill(dest, dest + w * h, Color(0));
+                if(!data) return;
+
+                int left = std::max(x, 0);
+                int right = std::min(x + w, width);
+                if(left >= right) return;
+                for(int i = std::max(y, 0), end = std::min(y + h, height); i < end; ++i)
+                {
+                    std::copy(&data[i * trueWidth + left], &data[i * trueWidth + right], &dest[(i - y) * w + (left - x)]);
+                }
+            }
+
+            // Blends a w x h block of packed pixels onto the canvas at (x, y), inside the clipping region.
+            template<BlendMode Blend> void setPixels(int x, int y, int w, int h, const Color* source)
+            {
+                if(!data || w <= 0 || h <= 0) return;
+
+                int left = std::max(x, clipX);
+                int right = std::min(x + w - 1, clipX2);
+                int top = std::max(y, clipY);
+                int bottom = std::min(y + h - 1, clipY2);
+                if(left > right) return;
+                touch(left, top, right, bottom);
+                int opacity = getOpacity();
+                for(int i = top; i <= bottom; ++i)
+                {
+                    blendSpan<Blend>(&source[(i - y) * w + (left - x)], &data[i * trueWidth + left], right - left + 1, opacity);
+                }
+            }
+
             template<BlendMode Blend> void dot(int x, int y, Color color)
             {
                 if(data && x >= clipX && x < clipX2 && y >= clipY && y < clipY2)
                 {
+                    touch(x, y, x, y);
                     blend<Blend>(color, data[y * trueWidth + x]);
                 }                
             }
@@ -321,6 +479,7 @@ namespace plum
                 {
                     return;
                 }
+                touch(std::min(x, x2), std::min(y, y2), std::max(x, x2), std::max(y, y2));
                 // A single pixel
                 if(x == x2 && y == y2)
                 {
@@ -336,10 +495,7 @@ namespace plum
                         std::swap(x, x2);
                     }
                     // Draw it.
-                    for(int i = x; i <= x2; ++i)
-                    {
-                        blend<Blend>(color, data[y * trueWidth + i]);
-                    }
+                    blendFill<Blend>(color, &data[y * trueWidth + x], x2 - x + 1, getOpacity());
                     return;
                 }
                 // Vertical line
@@ -455,6 +611,7 @@ namespace plum
                 {
                     y2 = clipY2;
                 }
+                touch(x, y, x2, y2);
                 // Draw the horizontal lines of the rectangle.
                 for(i = x; i <= x2; ++i)
                 {
@@ -472,7 +629,7 @@ namespace plum
             template<BlendMode Blend> void fillRect(int x, int y, int x2, int y2, Color color)
             {
                 if(!data) return;
-                int i, j;
+                profile::Zone zone("Canvas::fillRect");
 
                 if(x > x2)
                 {
@@ -504,14 +661,16 @@ namespace plum
                 {
                     y2 = clipY2;
                 }
+                touch(x, y, x2, y2);
                 // Draw the solid rectangle
-                for(i = y; i <= y2; ++i)
+                int opacity = getOpacity();
+                forRows(y, y2, x2 - x + 1, [=](int top, int bottom)
                 {
-                    for(j = x; j <= x2; ++j)
+                    for(int i = top; i <= bottom; ++i)
                     {
-                        blend<Blend>(color, data[i * trueWidth + j]);
+                        blendFill<Blend>(color, &data[i * trueWidth + x], x2 - x + 1, opacity);
                     }
-                }
+                });
             }
 
             template<BlendMode Blend> void horizontalGradientRect(int x, int y, int x2, int y2, Color color, Color color2);
@@ -524,6 +683,8 @@ namespace plum
             template<BlendMode Blend> void ellipse(int cx, int cy, int xRadius, int yRadius, Color color)
             {
                 if(!data) return;
+                touch(std::max(cx - abs(xRadius), clipX), std::max(cy - abs(yRadius), clipY),
+                    std::min(cx + abs(xRadius), clipX2), std::min(cy + abs(yRadius), clipY2));
                 int x, y, plotX, plotY;
                 int xChange, yChange;
                 int ellipseError;
@@ -668,7 +829,10 @@ namespace plum
             template<BlendMode Blend> void fillEllipse(int cx, int cy, int xRadius, int yRadius, Color color)
             {
                 if(!data) return;
-                int i, plotX, plotX2, plotY;
+                touch(std::max(cx - abs(xRadius), clipX), std::max(cy - abs(yRadius), clipY),
+                    std::min(cx + abs(xRadius), clipX2), std::min(cy + abs(yRadius), clipY2));
+                int plotX, plotX2, plotY;
+                int opacity = getOpacity();
                 int x, y;
                 int xChange, yChange;
                 int ellipseError;
@@ -695,20 +859,14 @@ namespace plum
                         plotY = cy - y;
                         if(plotY >= clipY && plotY <= clipY2)
                         {
-                            for(i = plotX; i <= plotX2; ++i)
-                            {
-                                blend<Blend>(color, data[plotY * trueWidth + i]);
-                            }
+                            blendFill<Blend>(color, &data[plotY * trueWidth + plotX], plotX2 - plotX + 1, opacity);
                         }
                         if(y)
                         {
                             plotY = cy + y;
                             if(plotY >= clipY && plotY <= clipY2)
                             {
-                                for(i = plotX; i <= plotX2; ++i)
-                                {
-                                    blend<Blend>(color, data[plotY * trueWidth + i]);
-                                }
+                                blendFill<Blend>(color, &data[plotY * trueWidth + plotX], plotX2 - plotX + 1, opacity);
                             }
                             lastY = y;
                         }
@@ -744,18 +902,12 @@ namespace plum
                         plotY = cy - y;
                         if(plotY >= clipY && plotY <= clipY2)
                         {
-                            for(i = plotX; i <= plotX2; ++i)
-                            {
-                                blend<Blend>(color, data[plotY * trueWidth + i]);
-                            }
+                            blendFill<Blend>(color, &data[plotY * trueWidth + plotX], plotX2 - plotX + 1, opacity);
                         }
                         plotY = cy + y;
                         if(plotY >= clipY && plotY <= clipY2)
                         {
-                            for(i = plotX; i <= plotX2; ++i)
-                            {
-                                blend<Blend>(color, data[plotY * trueWidth + i]);
-                            }
+                            blendFill<Blend>(color, &data[plotY * trueWidth + plotX], plotX2 - plotX + 1, opacity);
                         }
                         lastY = y;
                     }
@@ -777,7 +929,8 @@ namespace plum
             template<BlendMode Blend> void blit(int x, int y, Canvas& dest) const
             {
                 if(!data) return;
-                int i, j;
+                profile::Zone zone("Canvas::blit");
+                int i;
                 int x2 = x + trueWidth - 1;
                 int y2 = y + trueHeight -1;
                 int sourceX = 0;
@@ -807,13 +960,12 @@ namespace plum
                 {
                     sourceY2 -= y2 - dest.clipY2;
                 }
-                // Draw the image, pixel for pixel
+                dest.touch(sourceX + x, sourceY + y, sourceX2 + x, sourceY2 + y);
+                // Draw the image, a row at a time
+                int opacity = getOpacity();
                 for(i = sourceY; i <= sourceY2; ++i)
                 {
-                    for(j = sourceX; j <= sourceX2; ++j)
-                    {
-                        blend<Blend>(data[i * trueWidth + j], dest.data[(i + y) * dest.trueWidth + (j + x)]);
-                    }
+                    blendSpan<Blend>(&data[i * trueWidth + sourceX], &dest.data[(i + y) * dest.trueWidth + (sourceX + x)], sourceX2 - sourceX + 1, opacity);
                 }
             }
 
@@ -862,6 +1014,7 @@ namespace plum
                     int dx, int dy, int scw, int sch, Canvas& dest) const
             {
                 if(!data) return;
+                profile::Zone zone("Canvas::scaleBlitRegion");
                 if(sx > sx2)
                 {
                     std::swap(sx, sx2);
@@ -875,7 +1028,8 @@ namespace plum
                 sx2 = std::min(std::max(0, sx2), width - 1);
                 sy2 = std::min(std::max(0, sy2), height - 1);
 
-                int i, j;
+                if(scw <= 0 || sch <= 0) return;
+
                 int dx2 = dx + scw - 1;
                 int dy2 = dy + sch - 1;
                 int sourceX = 0;
@@ -907,14 +1061,24 @@ namespace plum
                 {
                     sourceY2 -= dy2 - dest.clipY2;
                 }
-                // Draw the scaled image, pixel for pixel
-                for(i = sourceY; i <= sourceY2; ++i)
+                dest.touch(sourceX + dx, sourceY + dy, sourceX2 + dx, sourceY2 + dy);
+                // Gather each scaled row, then blend it all at once
+                int opacity = getOpacity();
+                Color* destData = dest.data;
+                int destWidth = dest.trueWidth;
+                forRows(sourceY, sourceY2, sourceX2 - sourceX + 1, [=](int top, int bottom)
                 {
-                    for(j = sourceX; j <= sourceX2; ++j)
+                    std::vector<Color> row(sourceX2 - sourceX + 1);
+                    for(int i = top; i <= bottom; ++i)
                     {
-                        blend<Blend>(data[(((i * yRatio + sy) >> 16) + sy) * trueWidth + ((j * xRatio + sx) >> 16) + sx], dest.data[(i + dy) * dest.trueWidth + (j + dx)]);
+                        const Color* source = &data[(((i * yRatio + sy) >> 16) + sy) * trueWidth];
+                        for(int j = sourceX; j <= sourceX2; ++j)
+                        {
+                            row[j - sourceX] = source[((j * xRatio + sx) >> 16) + sx];
+                        }
+                        blendSpan<Blend>(row.data(), &destData[(i + dy) * destWidth + (sourceX + dx)], int(row.size()), opacity);
                     }
-                }        
+                });
             }
 
             template<BlendMode Blend> void rotateBlitRegion(int sx, int sy, int sx2, int sy2,
@@ -928,12 +1092,10 @@ namespace plum
                     int dx, int dy, double angle, double scale, Canvas& dest) const
             {
                 if(!data) return;
+                profile::Zone zone("Canvas::rotateScaleBlitRegion");
                 int minX, minY;
                 int maxX, maxY;
-                int destX, destY;
                 int centerX, centerY;
-                int plotX, plotY;
-                int sourceX, sourceY;
                 int cosine, sine;
                 int cosCenterX, sinCenterX;
                 int cosCenterY, sinCenterY;
@@ -1012,25 +1174,53 @@ namespace plum
                 sine = int(sine / scale);
                 cosine = int(cosine / scale);
 
-                for(destY = minY; destY < maxY; ++destY)
+                dest.touch(minX, minY, maxX - 1, maxY - 1);
+                int opacity = getOpacity();
+                Color* destData = dest.data;
+                int destWidth = dest.trueWidth;
+                forRows(minY, maxY - 1, maxX - minX, [=](int top, int bottom)
                 {
-                    plotX = (minX - dx) * cosine + (destY - dy) * sine + centerX;
-                    plotY = (destY - dy) * cosine - (minX - dx) * sine + centerY;
-                    for(destX = minX; destX < maxX; ++destX)
+                    for(int destY = top; destY <= bottom; ++destY)
                     {
-                        sourceX = plotX >> 16;
-                        sourceY = plotY >> 16;
-                        if(sourceX >= sx && sourceX <= sx2 && sourceY >= sy && sourceY <= sy2)
+                        int plotX = (minX - dx) * cosine + (destY - dy) * sine + centerX;
+                        int plotY = (destY - dy) * cosine - (minX - dx) * sine + centerY;
+                        for(int destX = minX; destX < maxX; ++destX)
                         {
-                            blend<Blend>(data[sourceY * trueWidth + sourceX], dest.data[destY * dest.trueWidth + destX]);
+                            int sourceX = plotX >> 16;
+                            int sourceY = plotY >> 16;
+                            if(sourceX >= sx && sourceX <= sx2 && sourceY >= sy && sourceY <= sy2)
+                            {
+                                blend<Blend>(data[sourceY * trueWidth + sourceX], destData[destY * destWidth + destX], opacity);
+                            }
+                            plotX += cosine;
+                            plotY -= sine;
                         }
-                        plotX += cosine;
-                        plotY -= sine;
                     }
-                }
+                });
             }
 
         private:
+            // Runs f(y, y2) over the rows from y to y2. Large enough jobs are split into bands
+            // that run on the engine's worker pool, if it has one.
+            template<typename F> static void forRows(int y, int y2, int rowWidth, F f)
+            {
+                if(y > y2 || rowWidth <= 0) return;
+
+                auto workers = WorkerPool::current();
+                int rows = y2 - y + 1;
+                if(!workers || !workers->getThreadCount() || rows < 2 || rows * rowWidth < workers->getThreshold())
+                {
+                    f(y, y2);
+                    return;
+                }
+
+                int bands = std::min(rows, (workers->getThreadCount() + 1) * 2);
+                workers->run(bands, [=](int band)
+                {
+                    f(y + rows * band / bands, y + rows * (band + 1) / bands - 1);
+                });
+            }
+
             int width, height;
             int trueWidth, trueHeight;
 
@@ -1038,6 +1228,7 @@ namespace plum
             int clipX2, clipY2;
 
             Color* data;
+            DirtyRegion* dirty;
     };
 }
 
@@ -47,6 +47,13 @@ namespace plum
             std::shared_ptr<EventHook> addEventHook(const EventHook& hook);
             std::shared_ptr<UpdateHook> addUpdateHook(const UpdateHook& hook);
 
+            // Starts a pool of worker threads that large canvas operations get split across.
+            // Zero threads (the default) keeps everything on the calling thread.
+            void setWorkerThreads(int count, int threshold);
+            // Sets how many threads load assets in the background.
+            // With zero, loading happens on the calling thread, and only the finishing step is deferred.
+            void setLoaderThreads(int count);
+
             class Impl;
             std::shared_ptr<Impl> impl;
     };
@@ -1,4 +1,17 @@
+#include <cstring>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 #include "file.h"
+#include "archive.h"
 
 namespace plum
 {
@@ -27,10 +40,160 @@ namespace plum
         }
     }
 
+    class FileMapping::Impl
+    {
+        public:
+            Impl(const std::string& filename)
+                : data(nullptr), size(0), active(false)
+            {
+#ifdef _WIN32
+                mapping = nullptr;
+                file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+                if(file == INVALID_HANDLE_VALUE)
+                {
+                    return;
+                }
+                LARGE_INTEGER length;
+                if(!GetFileSizeEx(file, &length) || length.HighPart)
+                {
+                    return;
+                }
+                if(length.QuadPart == 0)
+                {
+                    // Zero-length files can't be mapped, but there's nothing in them to read anyway.
+                    active = true;
+                    return;
+                }
+                mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                if(mapping)
+                {
+                    data = (const uint8_t*) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                }
+                if(data)
+                {
+                    size = size_t(length.QuadPart);
+                    active = true;
+                }
+#else
+                int fd = open(filename.c_str(), O_RDONLY);
+                if(fd < 0)
+                {
+                    return;
+                }
+                struct stat info;
+                if(fstat(fd, &info) == 0)
+                {
+                    if(info.st_size == 0)
+                    {
+                        // Zero-length files can't be mapped, but there's nothing in them to read anyway.
+                        active = true;
+                    }
+                    else
+                    {
+                        void* view = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+                        if(view != MAP_FAILED)
+                        {
+                            data = (const uint8_t*) view;
+                            size = size_t(info.st_size);
+                            active = true;
+                        }
+                    }
+                }
+                close(fd);
+#endif
+            }
+
+            ~Impl()
+            {
+#ifdef _WIN32
+                if(data)
+                {
+                    UnmapViewOfFile(data);
+                }
+                if(mapping)
+                {
+                    CloseHandle(mapping);
+                }
+                if(file != INVALID_HANDLE_VALUE)
+                {
+                    CloseHandle(file);
+                }
+#else
+                if(data)
+                {
+                    munmap((void*) data, size);
+                }
+#endif
+            }
+
+            const uint8_t* data;
+            size_t size;
+            bool active;
+#ifdef _WIN32
+            HANDLE file;
+            HANDLE mapping;
+#endif
+    };
+
+    FileMapping::FileMapping(const std::string& filename)
+        : impl(new Impl(filename))
+    {
+    }
+
+    FileMapping::~FileMapping()
+    {
+    }
+
+    bool FileMapping::isActive() const
+    {
+        return impl->active;
+    }
+
+    const uint8_t* FileMapping::getData() const
+    {
+        return impl->data;
+    }
+
+    size_t FileMapping::getSize() const
+    {
+        return impl->size;
+    }
+
     File::File(const std::string& filename, FileOpenMode mode)
-        : file(std::fopen(filename.c_str(), getModeFlags(mode))),
-        writing(isWriteMode(mode))
+        : file(nullptr),
+        writing(isWriteMode(mode)),
+        bufferStart(0),
+        bufferEnd(0),
+        inMemory(false),
+        data(nullptr),
+        size(0),
+        position(0)
     {
+        if(!writing && Archive::find(filename, data, size, owner))
+        {
+            inMemory = true;
+        }
+        else if(mode == FileMap)
+        {
+            auto mapping = std::make_shared<FileMapping>(filename);
+            if(mapping->isActive())
+            {
+                inMemory = true;
+                data = mapping->getData();
+                size = mapping->getSize();
+                owner = mapping;
+            }
+        }
+        else
+        {
+            file = std::fopen(filename.c_str(), getModeFlags(mode));
+            if(file)
+            {
+                // The C library's own buffer would only be an extra copy on top of this one.
+                std::setvbuf(file, nullptr, _IONBF, 0);
+                buffer.resize(BufferSize);
+            }
+        }
     }
 
     File::~File()
@@ -40,92 +203,93 @@ namespace plum
 
     bool File::isActive() const
     {
-        return file != nullptr;
+        return file != nullptr || inMemory;
     }
 
     bool File::close()
     {
+        if(inMemory)
+        {
+            inMemory = false;
+            data = nullptr;
+            size = position = 0;
+            owner.reset();
+            return true;
+        }
         if(isActive())
         {
-            std::fclose(file);
+            bool success = !writing || flush();
+            success = std::fclose(file) == 0 && success;
             file = nullptr;
-            return true;
+            buffer.clear();
+            bufferStart = bufferEnd = 0;
+            return success;
         }
         return false;
     }
 
-    bool File::readU8(uint8_t& value)
+    bool File::flush()
     {
-        if(writing || !isActive())
+        if(!writing || !isActive())
         {
             return false;
         }
-        return std::fread(&value, sizeof(uint8_t), 1, file) == 1;
+
+        bool success = true;
+        if(bufferEnd)
+        {
+            success = std::fwrite(buffer.data(), 1, bufferEnd, file) == bufferEnd;
+            bufferEnd = 0;
+        }
+        return std::fflush(file) == 0 && success;
+    }
+
+    // Refills the read buffer, and returns false at the end of the file.
+    bool File::fill()
+    {
+        bufferStart = 0;
+        bufferEnd = std::fread(buffer.data(), 1, buffer.size(), file);
+        return bufferEnd > 0;
+    }
+
+    bool File::readU8(uint8_t& value)
+    {
+        return readRaw(&value, sizeof(uint8_t)) == sizeof(uint8_t);
     }
 
     bool File::readU16(uint16_t& value)
     {
-        if(writing || !isActive())
-        {
-            return false;
-        }
-        return std::fread(&value, sizeof(uint16_t), 1, file) == 1;
+        return readRaw(&value, sizeof(uint16_t)) == sizeof(uint16_t);
     }
 
     bool File::readU32(uint32_t& value)
     {
-        if(writing || !isActive())
-        {
-            return false;
-        }
-        return std::fread(&value, sizeof(uint32_t), 1, file) == 1;
+        return readRaw(&value, sizeof(uint32_t)) == sizeof(uint32_t);
     }
 
     bool File::readInt8(int8_t& value)
     {
-        if(writing || !isActive())
-        {
-            return false;
-        }
-        return std::fread(&value, sizeof(int8_t), 1, file) == 1;
+        return readRaw(&value, sizeof(int8_t)) == sizeof(int8_t);
     }
 
     bool File::readInt16(int16_t& value)
     {
-        if(writing || !isActive())
-        {
-            return false;
-        }
-        return std::fread(&value, sizeof(int16_t), 1, file) == 1;
+        return readRaw(&value, sizeof(int16_t)) == sizeof(int16_t);
     }
 
     bool File::readInt32(int32_t& value)
     {
-        if(writing || !isActive())
-        {
-            return false;
-        }
-        return std::fread(&value, sizeof(int32_t), 1, file) == 1;
+        return readRaw(&value, sizeof(int32_t)) == sizeof(int32_t);
     }
 
     bool File::readFloat(float& value)
     {
-        if(writing || !isActive())
-        {
-            return false;
-        }
-
-        return std::fread(&value, sizeof(float), 1, file) == 1;
+        return readRaw(&value, sizeof(float)) == sizeof(float);
     }
-    
+
     bool File::readDouble(double& value)
     {
-        if(writing || !isActive())
-        {
-            return false;
-        }
-
-        return std::fread(&value, sizeof(double), 1, file) == 1;
+        return readRaw(&value, sizeof(double)) == sizeof(double);
     }
 
     bool File::readString(std::string& value)
@@ -134,7 +298,7 @@ namespace plum
         {
             return false;
         }
-        return std::fread(&value[0], 1, value.size(), file) > 0;
+        return readRaw(&value[0], value.size()) > 0;
     }
 
     size_t File::readRaw(void* raw, size_t length)
@@ -143,7 +307,44 @@ namespace plum
         {
             return false;
         }
-        return std::fread(raw, 1, length, file);
+        if(inMemory)
+        {
+            length = position < size ? std::min(length, size - position) : 0;
+            if(length)
+            {
+                std::memcpy(raw, data + position, length);
+            }
+            position += length;
+            return length;
+        }
+
+        auto out = (uint8_t*) raw;
+        size_t total = 0;
+        while(total < length)
+        {
+            if(bufferStart == bufferEnd)
+            {
+                // Reads bigger than the buffer skip it entirely.
+                if(length - total >= buffer.size())
+                {
+                    return total + std::fread(out + total, 1, length - total, file);
+                }
+                if(!fill())
+                {
+                    break;
+                }
+            }
+            size_t count = std::min(length - total, bufferEnd - bufferStart);
+            std::memcpy(out + total, &buffer[bufferStart], count);
+            bufferStart += count;
+            total += count;
+        }
+        return total;
+    }
+
+    size_t File::readArray(void* values, size_t elementSize, size_t count)
+    {
+        return elementSize ? readRaw(values, elementSize * count) / elementSize : 0;
     }
 
     /*
@@ -190,113 +391,81 @@ namespace plum
         }
 
         value.clear();
-        bool eol = false;
-        bool eof = false;
-        do
+        if(inMemory)
         {
-            char buffer[256];
-            if(!std::fgets(buffer, sizeof(buffer), file))
+            if(position >= size)
             {
-                eof = true;
+                return false;
             }
-            else
+            auto start = data + position;
+            auto end = data + size;
+            auto stop = std::find(start, end, '\n');
+            position = stop - data + (stop != end ? 1 : 0);
+            value.assign(start, stop);
+        }
+        else
+        {
+            bool eol = false;
+            while(!eol && (bufferStart < bufferEnd || fill()))
             {
-                size_t len = std::strlen(buffer);
-                if(buffer[len - 2] == '\r' && buffer[len - 1] == '\n')
-                {
-                    buffer[len - 2] = 0;
-                    eol = true;
-                }
-                else if(buffer[len - 1] == '\r' || buffer[len - 1] == '\n')
-                {
-                    buffer[len - 1] = 0;
-                    eol = true;
-                }
-                value.append(buffer);
-            }            
-        } while(!eol && !eof);
+                auto start = buffer.data() + bufferStart;
+                auto end = buffer.data() + bufferEnd;
+                auto stop = std::find(start, end, '\n');
+                value.append(start, stop);
+                eol = stop != end;
+                bufferStart = stop - buffer.data() + (eol ? 1 : 0);
+            }
+            if(!eol && value.empty())
+            {
+                return false;
+            }
+        }
 
-        return !eof || value.length() > 0;
+        if(!value.empty() && value[value.size() - 1] == '\r')
+        {
+            value.erase(value.size() - 1);
+        }
+        return true;
     }
 
     bool File::writeU8(uint8_t value)
     {
-        if(!writing || !isActive())
-        {
-            return false;
-        }
-
-        return std::fwrite(&value, sizeof(uint8_t), 1, file) == 1;
+        return writeRaw(&value, sizeof(uint8_t)) == sizeof(uint8_t);
     }
 
     bool File::writeU16(uint16_t value)
     {
-        if(!writing || !isActive())
-        {
-            return false;
-        }
-
-        return std::fwrite(&value, sizeof(uint16_t), 1, file) == 1;
+        return writeRaw(&value, sizeof(uint16_t)) == sizeof(uint16_t);
     }
 
     bool File::writeU32(uint32_t value)
     {
-        if(!writing || !isActive())
-        {
-            return false;
-        }
-
-        return std::fwrite(&value, sizeof(uint32_t), 1, file) == 1;
+        return writeRaw(&value, sizeof(uint32_t)) == sizeof(uint32_t);
     }
 
     bool File::writeInt8(int8_t value)
     {
-        if(!writing || !isActive())
-        {
-            return false;
-        }
-
-        return std::fwrite(&value, sizeof(int8_t), 1, file) == 1;
+        return writeRaw(&value, sizeof(int8_t)) == sizeof(int8_t);
     }
 
     bool File::writeInt16(int16_t value)
     {
-        if(!writing || !isActive())
-        {
-            return false;
-        }
-
-        return std::fwrite(&value, sizeof(int16_t), 1, file) == 1;
+        return writeRaw(&value, sizeof(int16_t)) == sizeof(int16_t);
     }
 
     bool File::writeInt32(int32_t value)
     {
-        if(!writing || !isActive())
-        {
-            return false;
-        }
-
-        return std::fwrite(&value, sizeof(int32_t), 1, file) == 1;
+        return writeRaw(&value, sizeof(int32_t)) == sizeof(int32_t);
     }
 
     bool File::writeFloat(float value)
     {
-        if(!writing || !isActive())
-        {
-            return false;
-        }
-
-        return std::fwrite(&value, sizeof(float), 1, file) == 1;
+        return writeRaw(&value, sizeof(float)) == sizeof(float);
     }
-    
+
     bool File::writeDouble(double value)
     {
-        if(!writing || !isActive())
-        {
-            return false;
-        }
-
-        return std::fwrite(&value, sizeof(double), 1, file) == 1;
+        return writeRaw(&value, sizeof(double)) == sizeof(double);
     }
 
     bool File::writeString(const std::string& value)
@@ -305,8 +474,7 @@ namespace plum
         {
             return false;
         }
-        std::fwrite(value.data(), value.size(), 1, file);
-        return true;
+        return writeRaw(value.data(), value.size()) == value.size();
     }
 
     bool File::writeLine(const std::string& value)
@@ -315,9 +483,7 @@ namespace plum
         {
             return false;
         }
-        std::fwrite(value.data(), value.size(), 1, file);
-        std::fwrite("\r\n", 1, 2, file);
-        return true;
+        return writeRaw(value.data(), value.size()) == value.size() && writeRaw("\r\n", 2) == 2;
     }
 
     size_t File::writeRaw(const void* raw, size_t length)
@@ -326,16 +492,55 @@ namespace plum
         {
             return false;
         }
-        return std::fwrite(raw, 1, length, file);
+
+        if(bufferEnd + length > buffer.size() && !flush())
+        {
+            return 0;
+        }
+        // Writes bigger than the buffer go straight out.
+        if(length >= buffer.size())
+        {
+            return std::fwrite(raw, 1, length, file);
+        }
+        if(length)
+        {
+            std::memcpy(&buffer[bufferEnd], raw, length);
+            bufferEnd += length;
+        }
+        return length;
+    }
+
+    size_t File::writeArray(const void* values, size_t elementSize, size_t count)
+    {
+        return elementSize ? writeRaw(values, elementSize * count) / elementSize : 0;
     }
 
-    bool File::seek(int position, FileSeekMode mode)
+    bool File::seek(int offset, FileSeekMode mode)
     {
         if(!isActive())
         {
             return 0;
         }
         
+        if(inMemory)
+        {
+            long base = 0;
+            switch(mode)
+            {
+                case SeekStart:   base = 0; break;
+                case SeekCurrent: base = long(position); break;
+                case SeekEnd:     base = long(size); break;
+                default: return false;
+            }
+            // Like fseek, going past the end is allowed, and reads from there just come up empty.
+            if(base + offset < 0)
+            {
+                return false;
+            }
+            position = size_t(base + offset);
+            return true;
+        }
+
         int m;
         switch(mode)
         {
@@ -344,11 +549,70 @@ namespace plum
             case SeekEnd:     m = SEEK_END; break;
             default: return false;
         }
-        return std::fseek(file, position, m) != -1;
+
+        // The disk is ahead of a read buffer, and behind a write buffer.
+        if(writing)
+        {
+            flush();
+        }
+        else if(mode == SeekCurrent)
+        {
+            offset -= int(bufferEnd - bufferStart);
+        }
+        bufferStart = bufferEnd = 0;
+        return std::fseek(file, offset, m) != -1;
     }
 
     int File::tell()
     {
-        return isActive() ? std::ftell(file) : -1;
+        if(inMemory)
+        {
+            return int(position);
+        }
+        if(!isActive())
+        {
+            return -1;
+        }
+        long result = std::ftell(file);
+        if(result < 0)
+        {
+            return -1;
+        }
+        return writing ? int(result + bufferEnd) : int(result - (bufferEnd - bufferStart));
+    }
+
+    size_t File::getSize()
+    {
+        if(inMemory)
+        {
+            return size;
+        }
+        if(!isActive())
+        {
+            return 0;
+        }
+        if(writing)
+        {
+            flush();
+        }
+        long current = std::ftell(file);
+        std::fseek(file, 0, SEEK_END);
+        long length = std::ftell(file);
+        std::fseek(file, current, SEEK_SET);
+        return length > 0 ? size_t(length) : 0;
+    }
+
+    const uint8_t* File::getData() const
+    {
+        return inMemory ? data : nullptr;
+    }
+
+    const uint8_t* File::view(size_t offset, size_t length) const
+    {
+        if(!inMemory || !data || offset > size || length > size - offset)
+        {
+            return nullptr;
+        }
+        return data + offset;
     }
 }
@@ -2,6 +2,8 @@
 #define PLUM_FILE_H
 
 #include <string>
+#include <vector>
+#include <memory>
 #include <cstdio>
 #include <cstdint>
 
@@ -12,6 +14,7 @@ namespace plum
         FileRead, // Load from a file. File must exist.
         FileWrite, // Save to a file. Overwrite existing file, if any.
         FileAppend, // Add to end of existing file, or create new.
+        FileMap, // Map a file into memory, read-only. File must exist.
     };
 
     enum FileSeekMode
@@ -21,14 +24,41 @@ namespace plum
         SeekEnd, // Relative to the end of the file.
     };
 
+    // A whole file on disk, mapped read-only into memory.
+    class FileMapping
+    {
+        public:
+            FileMapping(const std::string& filename);
+            ~FileMapping();
+
+            // Empty files count as active, even though there's no data to point at.
+            bool isActive() const;
+            const uint8_t* getData() const;
+            size_t getSize() const;
+
+            class Impl;
+            std::shared_ptr<Impl> impl;
+
+        private:
+            FileMapping(const FileMapping&);
+            void operator =(const FileMapping&);
+    };
+
+    // Files opened for reading are looked for in the mounted archives first (see Archive),
+    // and only then on disk. Files on disk go through a large buffer of their own,
+    // so lots of small reads or writes don't each turn into a call to the C library.
     class File
     {
         public:
+            static const size_t BufferSize = 64 * 1024;
+
             File(const std::string& filename, FileOpenMode mode);
             ~File();
 
             bool isActive() const;
             bool close();
+            // Pushes any buffered writes out to the disk.
+            bool flush();
 
             bool readU8(uint8_t& value);
             bool readU16(uint16_t& value);
@@ -41,6 +71,8 @@ namespace plum
             bool readString(std::string& value);
             bool readLine(std::string& value);
             size_t readRaw(void* raw, size_t length);
+            // Reads up to count packed values of elementSize bytes each, and returns how many were read.
+            size_t readArray(void* values, size_t elementSize, size_t count);
             
             bool writeU8(uint8_t value);
             bool writeU16(uint16_t value);
@@ -53,14 +85,40 @@ namespace plum
             bool writeString(const std::string& value);
             bool writeLine(const std::string& value);
             size_t writeRaw(const void* raw, size_t length);
+            size_t writeArray(const void* values, size_t elementSize, size_t count);
 
             bool seek(int position, FileSeekMode mode);
             int tell();
+            size_t getSize();
+
+            // The whole contents, if they're already in memory (a mapped file, or a file inside an archive), or nullptr otherwise.
+            const uint8_t* getData() const;
+            // Points at part of the contents without copying or moving the read position.
+            // Only works for files in memory, and returns nullptr if the range doesn't fit.
+            const uint8_t* view(size_t offset, size_t length) const;
 
         private:
             std::FILE* file;
             bool writing;
+
+            // Reads are served from [bufferStart, bufferEnd), and writes collect in [0, bufferEnd).
+            std::vector<uint8_t> buffer;
+            size_t bufferStart;
+            size_t bufferEnd;
+
+            // Used in place of the file handle when reading something that's already in memory.
+            bool inMemory;
+            const uint8_t* data;
+            size_t size;
+            size_t position;
+            // Keeps the memory alive.
+            std::shared_ptr<void> owner;
+
+            bool fill();
+
+            File(const File&);
+            void operator =(const File&);
     };
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -5,6 +5,17 @@ namespace plum
 {
     Font::Font(const std::string& filename)
         : image(Image(Canvas::load(filename))), letterSpacing(1)
+    {
+        init();
+    }
+
+    Font::Font(const Canvas& source)
+        : image(source), letterSpacing(1)
+    {
+        init();
+    }
+
+    void Font::init()
     {
         Canvas& canvas(image.canvas());
 
@@ -15,6 +15,7 @@ namespace plum
             static const int FontRows = 5;
 
             Font(const std::string& filename);
+            Font(const Canvas& source);
             ~Font();
 
             int getWidth() const;
@@ -34,6 +35,7 @@ namespace plum
             std::string wrapText(const std::string& input, int lineLength);
 
         private:
+            void init();
             bool isColumnEmpty(int cell, int column);
 
             Image image;
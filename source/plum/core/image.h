@@ -23,6 +23,9 @@ namespace plum
             void refresh();
 
             void bind();
+            // Converts a position on the canvas into texture coordinates for the bound texture.
+            // Small images share their texture with others, so this isn't simply divided by the size.
+            void mapTexture(double x, double y, double& s, double& t) const;
 
             void blit(int x, int y, BlendMode mode);
             void scaleBlit(int x, int y, int width, int height, BlendMode mode);
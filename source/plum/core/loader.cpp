@@ -0,0 +1,248 @@
+#include <deque>
+#include <vector>
+#include <algorithm>
+
+#include "thread.h"
+#include "loader.h"
+#include "profile.h"
+
+namespace plum
+{
+    namespace
+    {
+        Loader* activeLoader = nullptr;
+
+        enum RequestState
+        {
+            RequestQueued,
+            RequestLoading,
+            RequestLoaded,
+            RequestFinished,
+        };
+    }
+
+    class Loader::Request
+    {
+        public:
+            Task load;
+            Task finish;
+            RequestState state;
+    };
+
+    class Loader::Impl
+    {
+        public:
+            Impl()
+                : quitting(false)
+            {
+            }
+
+            // Expects the mutex to be held, and releases it while the job runs.
+            void load(const std::shared_ptr<Request>& request)
+            {
+                request->state = RequestLoading;
+                mutex.unlock();
+                try
+                {
+                    profile::Zone zone("Loader::load");
+                    request->load();
+                }
+                catch(...)
+                {
+                }
+                mutex.lock();
+                request->state = RequestLoaded;
+                request->load = nullptr;
+                done.push_back(request);
+                loaded.broadcast();
+            }
+
+            // Expects the mutex to be held, and the request to have been taken out of the done list.
+            void finish(const std::shared_ptr<Request>& request)
+            {
+                request->state = RequestFinished;
+                Task task;
+                task.swap(request->finish);
+                mutex.unlock();
+                try
+                {
+                    task();
+                }
+                catch(...)
+                {
+                    // The caller's lock still expects to own the mutex on the way out.
+                    mutex.lock();
+                    throw;
+                }
+                mutex.lock();
+            }
+
+            // Lets the threads finish the job they're on, and joins them.
+            void stop()
+            {
+                {
+                    Lock lock(mutex);
+                    quitting = true;
+                    wake.broadcast();
+                }
+                threads.clear();
+            }
+
+            void loop()
+            {
+                profile::setThreadName("Loader");
+                Lock lock(mutex);
+                while(!quitting)
+                {
+                    if(queued.empty())
+                    {
+                        wake.wait(mutex);
+                    }
+                    else
+                    {
+                        auto request = queued.front();
+                        queued.pop_front();
+                        load(request);
+                    }
+                }
+            }
+
+            std::vector<std::shared_ptr<Thread>> threads;
+
+            Mutex mutex;
+            Condition wake;
+            Condition loaded;
+
+            std::deque<std::shared_ptr<Request>> queued;
+            std::deque<std::shared_ptr<Request>> done;
+            bool quitting;
+    };
+
+    Loader::Loader(int threadCount)
+        : impl(new Impl())
+    {
+        auto loader = impl.get();
+        for(int i = 0; i < threadCount; ++i)
+        {
+            impl->threads.push_back(std::make_shared<Thread>([loader](){ loader->loop(); }));
+        }
+        activeLoader = this;
+    }
+
+    Loader::~Loader()
+    {
+        impl->stop();
+
+        if(activeLoader == this)
+        {
+            activeLoader = nullptr;
+        }
+    }
+
+    Loader* Loader::current()
+    {
+        return activeLoader;
+    }
+
+    int Loader::getThreadCount() const
+    {
+        return int(impl->threads.size());
+    }
+
+    std::shared_ptr<Loader::Request> Loader::queue(const Task& load, const Task& finish)
+    {
+        auto request = std::make_shared<Request>();
+        request->load = load;
+        request->finish = finish;
+        request->state = RequestQueued;
+
+        Lock lock(impl->mutex);
+        if(impl->threads.empty())
+        {
+            impl->load(request);
+        }
+        else
+        {
+            impl->queued.push_back(request);
+            impl->wake.signal();
+        }
+        return request;
+    }
+
+    void Loader::update()
+    {
+        Lock lock(impl->mutex);
+        // One at a time, since finishing a job can queue or wait on others.
+        while(!impl->done.empty())
+        {
+            auto request = impl->done.front();
+            impl->done.pop_front();
+            impl->finish(request);
+        }
+    }
+
+    void Loader::wait(const std::shared_ptr<Request>& request)
+    {
+        Lock lock(impl->mutex);
+        if(request->state == RequestQueued)
+        {
+            // Nobody has picked it up yet, so skip the line and load it here.
+            auto& queued(impl->queued);
+            auto it = std::find(queued.begin(), queued.end(), request);
+            if(it == queued.end())
+            {
+                // Belongs to another loader.
+                return;
+            }
+            queued.erase(it);
+            impl->load(request);
+        }
+        while(request->state == RequestLoading)
+        {
+            impl->loaded.wait(impl->mutex);
+        }
+        if(request->state == RequestLoaded)
+        {
+            auto& done(impl->done);
+            auto it = std::find(done.begin(), done.end(), request);
+            if(it == done.end())
+            {
+                return;
+            }
+            done.erase(it);
+            impl->finish(request);
+        }
+    }
+
+    void Loader::adopt(Loader& other)
+    {
+        if(&other == this)
+        {
+            return;
+        }
+
+        // Once its threads are gone, nothing else touches the other loader's lists.
+        other.impl->stop();
+        std::deque<std::shared_ptr<Request>> queued, done;
+        queued.swap(other.impl->queued);
+        done.swap(other.impl->done);
+
+        Lock lock(impl->mutex);
+        for(auto it = done.begin(), end = done.end(); it != end; ++it)
+        {
+            impl->done.push_back(*it);
+        }
+        for(auto it = queued.begin(), end = queued.end(); it != end; ++it)
+        {
+            if(impl->threads.empty())
+            {
+                impl->load(*it);
+            }
+            else
+            {
+                impl->queued.push_back(*it);
+            }
+        }
+        impl->wake.broadcast();
+    }
+}
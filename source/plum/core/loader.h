@@ -0,0 +1,47 @@
+#ifndef PLUM_LOADER_H
+#define PLUM_LOADER_H
+
+#include <memory>
+#include <functional>
+
+namespace plum
+{
+    // Runs slow loading work (reading and decoding files) on background threads.
+    // Each job has a second half that runs on the main thread once the first is done,
+    // for anything that isn't safe to do elsewhere, like creating textures or touching Lua.
+    class Loader
+    {
+        public:
+            typedef std::function<void()> Task;
+
+            class Request;
+
+            // With no threads, jobs are loaded as soon as they're queued, but still finished later.
+            Loader(int threadCount);
+            ~Loader();
+
+            // The loader belonging to the engine, or nullptr if there is none.
+            static Loader* current();
+
+            int getThreadCount() const;
+
+            // Queues a job. load runs on a loader thread, and shouldn't throw.
+            // finish runs afterwards, on the thread that calls update() or wait().
+            std::shared_ptr<Request> queue(const Task& load, const Task& finish);
+            // Finishes every job that's done loading. Called by the engine on every refresh.
+            void update();
+            // Blocks until the job is loaded, and finishes it right away, if it wasn't already.
+            void wait(const std::shared_ptr<Request>& request);
+            // Takes over the other loader's unfinished jobs, after letting its threads finish what they're on.
+            void adopt(Loader& other);
+
+            class Impl;
+            std::shared_ptr<Impl> impl;
+
+        private:
+            Loader(const Loader&);
+            void operator =(const Loader&);
+    };
+}
+
+#endif
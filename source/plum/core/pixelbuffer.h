@@ -0,0 +1,84 @@
+#ifndef PLUM_PIXELBUFFER_H
+#define PLUM_PIXELBUFFER_H
+
+#include <vector>
+#include <climits>
+#include <algorithm>
+
+#include "color.h"
+
+namespace plum
+{
+    // A block of packed pixels, for moving large regions in and out of canvases in one go.
+    class PixelBuffer
+    {
+        public:
+            PixelBuffer(int width, int height)
+                : width(std::max(width, 0)),
+                height(std::max(height, 0)),
+                pixels(size_t(this->width) * size_t(this->height))
+            {
+            }
+
+            // Whether a buffer this size can exist. Sizes and byte counts are ints throughout,
+            // so anything whose bytes wouldn't fit in one is refused before any math is done on it.
+            static bool fits(int width, int height)
+            {
+                return width <= 0 || height <= 0 || size_t(width) * size_t(height) <= size_t(INT_MAX) / sizeof(Color);
+            }
+
+            int getWidth() const
+            {
+                return width;
+            }
+
+            int getHeight() const
+            {
+                return height;
+            }
+
+            int getSize() const
+            {
+                return width * height;
+            }
+
+            Color* getData()
+            {
+                return pixels.empty() ? nullptr : &pixels[0];
+            }
+
+            const Color* getData() const
+            {
+                return pixels.empty() ? nullptr : &pixels[0];
+            }
+
+            bool contains(int x, int y) const
+            {
+                return x >= 0 && x < width && y >= 0 && y < height;
+            }
+
+            Color get(int x, int y) const
+            {
+                return contains(x, y) ? pixels[y * width + x] : Color(0);
+            }
+
+            void set(int x, int y, Color color)
+            {
+                if(contains(x, y))
+                {
+                    pixels[y * width + x] = color;
+                }
+            }
+
+            void fill(Color color)
+            {
+                std::fill(pixels.begin(), pixels.end(), color);
+            }
+
+        private:
+            int width, height;
+            std::vector<Color> pixels;
+    };
+}
+
+#endif
@@ -0,0 +1,278 @@
+#include <vector>
+#include <memory>
+#include <sstream>
+#include <algorithm>
+
+#include "log.h"
+#include "file.h"
+#include "thread.h"
+#include "profile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#define PLUM_THREAD_LOCAL __declspec(thread)
+#else
+#include <time.h>
+#define PLUM_THREAD_LOCAL __thread
+#endif
+
+namespace plum
+{
+    namespace profile
+    {
+        volatile bool active = false;
+        uint64_t counters[CounterCount];
+
+        namespace
+        {
+            struct Event
+            {
+                const char* name;
+                uint64_t start;
+                uint64_t end;
+            };
+
+            // Per-frame counter totals, kept for the trace.
+            struct Sample
+            {
+                uint64_t time;
+                uint64_t values[CounterCount];
+            };
+
+            // One thread's zones. Only that thread writes to it, so the lock is
+            // uncontended except while a capture is being started or written out.
+            struct Buffer
+            {
+                Buffer(int id)
+                    : id(id), name(nullptr), written(0)
+                {
+                }
+
+                Mutex mutex;
+                int id;
+                const char* name;
+                std::vector<Event> events;
+                // Counts every zone, so the ring position is written modulo the size.
+                uint64_t written;
+            };
+
+            Mutex registryMutex;
+            std::vector<std::shared_ptr<Buffer>> buffers;
+            int capacity = DefaultCapacity;
+            uint64_t captureStart = 0;
+
+            // The rest belongs to the thread calling frame().
+            uint64_t lastCounters[CounterCount];
+            uint64_t lastFrame = 0;
+            std::vector<Sample> samples;
+
+            PLUM_THREAD_LOCAL Buffer* localBuffer = nullptr;
+
+            Buffer* buffer()
+            {
+                if(!localBuffer)
+                {
+                    Lock lock(registryMutex);
+                    auto b = std::make_shared<Buffer>(int(buffers.size()) + 1);
+                    buffers.push_back(b);
+                    localBuffer = b.get();
+                }
+                return localBuffer;
+            }
+
+            void add(Buffer* b, const char* name, uint64_t start, uint64_t end)
+            {
+                Lock lock(b->mutex);
+                if(b->events.empty())
+                {
+                    b->events.resize(capacity);
+                }
+                Event& e(b->events[size_t(b->written % b->events.size())]);
+                e.name = name;
+                e.start = start;
+                e.end = end;
+                ++b->written;
+            }
+
+            const char* const CounterNames[CounterCount] = {
+                "drawCalls",
+                "textureBinds",
+                "uploadBytes",
+            };
+        }
+
+        uint64_t now()
+        {
+#ifdef _WIN32
+            static LARGE_INTEGER frequency;
+            if(!frequency.QuadPart)
+            {
+                QueryPerformanceFrequency(&frequency);
+            }
+            LARGE_INTEGER counter;
+            QueryPerformanceCounter(&counter);
+            // Split up, so the multiply can't overflow on machines that have been up a while.
+            uint64_t c = counter.QuadPart;
+            uint64_t f = frequency.QuadPart;
+            return c / f * 1000000 + c % f * 1000000 / f;
+#else
+            timespec t;
+            clock_gettime(CLOCK_MONOTONIC, &t);
+            return uint64_t(t.tv_sec) * 1000000 + t.tv_nsec / 1000;
+#endif
+        }
+
+        void begin(int eventCapacity)
+        {
+            active = false;
+            {
+                Lock lock(registryMutex);
+                capacity = std::max(eventCapacity, 1);
+                for(auto it = buffers.begin(), end = buffers.end(); it != end; ++it)
+                {
+                    Lock bufferLock((*it)->mutex);
+                    (*it)->events.clear();
+                    (*it)->written = 0;
+                }
+            }
+            samples.clear();
+            captureStart = now();
+            lastFrame = captureStart;
+            active = true;
+        }
+
+        int finish(const std::string& filename)
+        {
+            active = false;
+
+            std::ostringstream out;
+            out << "{\"traceEvents\":[\n";
+            out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"plum\"}}";
+
+            // Take each ring out from under its lock first, so no thread waits while the trace is formatted.
+            std::vector<std::shared_ptr<Buffer>> taken;
+            {
+                Lock lock(registryMutex);
+                for(auto it = buffers.begin(), end = buffers.end(); it != end; ++it)
+                {
+                    Buffer& b(**it);
+                    auto copy = std::make_shared<Buffer>(b.id);
+                    Lock bufferLock(b.mutex);
+                    copy->name = b.name;
+                    copy->events.swap(b.events);
+                    copy->written = b.written;
+                    b.written = 0;
+                    taken.push_back(copy);
+                }
+            }
+
+            int zones = 0;
+            uint64_t dropped = 0;
+            for(auto it = taken.begin(), end = taken.end(); it != end; ++it)
+            {
+                const Buffer& b(**it);
+                if(b.name)
+                {
+                    out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << b.id
+                        << ",\"args\":{\"name\":\"" << b.name << "\"}}";
+                }
+
+                uint64_t size = b.events.size();
+                uint64_t first = b.written > size ? b.written - size : 0;
+                dropped += first;
+                for(uint64_t i = first; i < b.written; ++i)
+                {
+                    const Event& e(b.events[size_t(i % size)]);
+                    // Zones that were already open when the capture started.
+                    if(e.start < captureStart)
+                    {
+                        continue;
+                    }
+                    out << ",\n{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << b.id
+                        << ",\"ts\":" << e.start - captureStart << ",\"dur\":" << e.end - e.start << "}";
+                    ++zones;
+                }
+            }
+
+            for(auto it = samples.begin(), end = samples.end(); it != end; ++it)
+            {
+                out << ",\n{\"name\":\"counters\",\"ph\":\"C\",\"pid\":1,\"ts\":" << it->time - captureStart << ",\"args\":{";
+                for(int i = 0; i < CounterCount; ++i)
+                {
+                    out << (i ? "," : "") << "\"" << CounterNames[i] << "\":" << it->values[i];
+                }
+                out << "}}";
+            }
+            out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+            if(dropped)
+            {
+                logFormat("Profile capture overflowed its rings and dropped the oldest %u zones.\n", unsigned(dropped));
+            }
+
+            File f(filename, FileWrite);
+            if(!f.isActive())
+            {
+                return -1;
+            }
+            std::string text(out.str());
+            f.writeRaw(text.data(), text.size());
+            return zones;
+        }
+
+        void setThreadName(const char* name)
+        {
+            buffer()->name = name;
+        }
+
+        void record(const char* name, uint64_t start, uint64_t end)
+        {
+            if(!active) return;
+
+            add(buffer(), name, start, end);
+        }
+
+        int addTrack(const char* name)
+        {
+            Lock lock(registryMutex);
+            auto b = std::make_shared<Buffer>(int(buffers.size()) + 1);
+            b->name = name;
+            buffers.push_back(b);
+            return b->id;
+        }
+
+        void record(int track, const char* name, uint64_t start, uint64_t end)
+        {
+            if(!active) return;
+
+            Buffer* b;
+            {
+                Lock lock(registryMutex);
+                b = buffers[track - 1].get();
+            }
+            add(b, name, start, end);
+        }
+
+        uint64_t getCounter(Counter counter)
+        {
+            return lastCounters[counter];
+        }
+
+        void frame()
+        {
+            if(active)
+            {
+                uint64_t time = now();
+                record("Frame", lastFrame, time);
+                lastFrame = time;
+
+                Sample sample;
+                sample.time = time;
+                std::copy(counters, counters + CounterCount, sample.values);
+                samples.push_back(sample);
+            }
+            std::copy(counters, counters + CounterCount, lastCounters);
+            std::fill(counters, counters + CounterCount, 0);
+        }
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef PLUM_PROFILE_H
+#define PLUM_PROFILE_H
+
+#include <string>
+#include <cstdint>
+
+namespace plum
+{
+    namespace profile
+    {
+        enum Counter
+        {
+            CounterDrawCalls,
+            CounterTextureBinds,
+            CounterUploadBytes,
+            CounterCount
+        };
+
+        // Zones recorded per thread while a capture runs. Each thread's ring holds this many before it starts overwriting the oldest.
+        static const int DefaultCapacity = 64 * 1024;
+
+        // Set between begin() and finish(). Zones check this and do nothing else when it's clear.
+        extern volatile bool active;
+
+        // Microseconds on a monotonic clock, comparable across threads.
+        uint64_t now();
+
+        // Starts a capture, dropping anything left from the last one.
+        void begin(int capacity = DefaultCapacity);
+        // Ends the capture and writes it out as Chrome trace JSON, for chrome://tracing or Perfetto.
+        // Returns the number of zones written, or -1 if the file couldn't be opened.
+        int finish(const std::string& filename);
+
+        // Names the calling thread in captures. The name must outlive the capture, so string literals are best.
+        void setThreadName(const char* name);
+
+        // Adds a finished zone to the calling thread's ring. The name is kept by pointer, like the thread name.
+        void record(const char* name, uint64_t start, uint64_t end);
+
+        // A thread that must never lock or allocate, like the audio callback, can't record its own zones.
+        // It times them with now() and hands them over, and another thread records them on a track,
+        // which shows up in captures as a thread of its own. Returns the track to pass to record().
+        int addTrack(const char* name);
+        void record(int track, const char* name, uint64_t start, uint64_t end);
+
+        // Running totals for the frame in progress. Only touched from the thread that owns the GL context,
+        // and kept whether or not a capture is running.
+        extern uint64_t counters[CounterCount];
+
+        inline void count(Counter counter, uint64_t amount = 1)
+        {
+            counters[counter] += amount;
+        }
+        // Totals for the last complete frame.
+        uint64_t getCounter(Counter counter);
+
+        // Marks the end of a frame: records it as a zone, and moves the counters over to the last frame's totals.
+        void frame();
+
+        // Times the scope it lives in.
+        class Zone
+        {
+            public:
+                Zone(const char* name)
+                    : name(active ? name : nullptr), start(active ? now() : 0)
+                {
+                }
+
+                ~Zone()
+                {
+                    if(name)
+                    {
+                        record(name, start, now());
+                    }
+                }
+
+            private:
+                const char* name;
+                uint64_t start;
+
+                Zone(const Zone&);
+                void operator =(const Zone&);
+        };
+    }
+}
+
+#endif
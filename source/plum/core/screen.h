@@ -2,6 +2,7 @@
 #define PLUM_VIDEO_H
 
 #include <string>
+#include <memory>
 #include "color.h"
 #include "blending.h"
 
@@ -23,6 +24,8 @@ namespace plum
             int getTrueHeight() const;
             void setTitle(const std::string& title);
             void setResolution(int width, int height, int scale, bool win);
+            // Saves every nth frame as prefix + frame number + ".png". An empty prefix turns it off.
+            void setFrameDump(const std::string& prefix, int interval);
 
             void startBatch();
             void endBatch();
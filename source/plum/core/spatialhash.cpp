@@ -0,0 +1,382 @@
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include "spatialhash.h"
+
+namespace plum
+{
+    namespace
+    {
+        // The most cells one entry is filed under. Anything bigger goes in the oversized list.
+        const int64_t MaxEntryCells = 1024;
+    }
+
+    SpatialHash::SpatialHash(double cellSize)
+        : cellSize(cellSize > 0 ? cellSize : DefaultCellSize), count(0), mark(0)
+    {
+    }
+
+    SpatialHash::~SpatialHash()
+    {
+    }
+
+    double SpatialHash::getCellSize() const
+    {
+        return cellSize;
+    }
+
+    int SpatialHash::getCount() const
+    {
+        return count;
+    }
+
+    int SpatialHash::toCell(double value) const
+    {
+        double cell = std::floor(value / cellSize);
+        // Kept one short of the top, so a loop stepping up to the last cell can't overflow. NaN fails the first test.
+        if(!(cell > double(std::numeric_limits<int>::min())))
+        {
+            return std::numeric_limits<int>::min();
+        }
+        return int(std::min(cell, double(std::numeric_limits<int>::max() - 1)));
+    }
+
+    uint64_t SpatialHash::key(int cx, int cy)
+    {
+        return (uint64_t(uint32_t(cx)) << 32) | uint32_t(cy);
+    }
+
+    bool SpatialHash::touches(const Rect& a, const Rect& b)
+    {
+        return a.x + a.width >= b.x
+            && a.x <= b.x + b.width
+            && a.y + a.height >= b.y
+            && a.y <= b.y + b.height;
+    }
+
+    Rect SpatialHash::normalize(const Rect& rect)
+    {
+        return Rect(std::min(rect.x, rect.x + rect.width), std::min(rect.y, rect.y + rect.height), std::abs(rect.width), std::abs(rect.height));
+    }
+
+    bool SpatialHash::isOversized(int cellX, int cellY, int cellX2, int cellY2)
+    {
+        int64_t width = int64_t(cellX2) - cellX + 1;
+        int64_t height = int64_t(cellY2) - cellY + 1;
+        return width > MaxEntryCells || height > MaxEntryCells || width * height > MaxEntryCells;
+    }
+
+    void SpatialHash::place(int handle, int cellX, int cellY, int cellX2, int cellY2)
+    {
+        for(int cy = cellY; cy <= cellY2; ++cy)
+        {
+            for(int cx = cellX; cx <= cellX2; ++cx)
+            {
+                Cell& cell(cells[key(cx, cy)]);
+                cell.x = cx;
+                cell.y = cy;
+                cell.handles.push_back(handle);
+            }
+        }
+    }
+
+    void SpatialHash::unplace(int handle, int cellX, int cellY, int cellX2, int cellY2)
+    {
+        for(int cy = cellY; cy <= cellY2; ++cy)
+        {
+            for(int cx = cellX; cx <= cellX2; ++cx)
+            {
+                auto it = cells.find(key(cx, cy));
+                if(it == cells.end())
+                {
+                    continue;
+                }
+                auto& handles(it->second.handles);
+                auto h = std::find(handles.begin(), handles.end(), handle);
+                if(h != handles.end())
+                {
+                    *h = handles.back();
+                    handles.pop_back();
+                }
+                // Dropped once empty, so a scene that wanders over a big world doesn't leave a trail of cells to step over.
+                if(handles.empty())
+                {
+                    cells.erase(it);
+                }
+            }
+        }
+    }
+
+    void SpatialHash::attach(int handle)
+    {
+        Entry& e(entries[handle]);
+        e.oversized = isOversized(e.cellX, e.cellY, e.cellX2, e.cellY2);
+        if(e.oversized)
+        {
+            oversized.push_back(handle);
+        }
+        else
+        {
+            place(handle, e.cellX, e.cellY, e.cellX2, e.cellY2);
+        }
+    }
+
+    void SpatialHash::detach(int handle)
+    {
+        Entry& e(entries[handle]);
+        if(e.oversized)
+        {
+            auto h = std::find(oversized.begin(), oversized.end(), handle);
+            if(h != oversized.end())
+            {
+                *h = oversized.back();
+                oversized.pop_back();
+            }
+        }
+        else
+        {
+            unplace(handle, e.cellX, e.cellY, e.cellX2, e.cellY2);
+        }
+    }
+
+    void SpatialHash::check(int handle, const Rect& area, unsigned int m, std::vector<int>& results)
+    {
+        Entry& e(entries[handle]);
+        if(e.mark != m)
+        {
+            e.mark = m;
+            if(touches(e.rect, area))
+            {
+                results.push_back(handle);
+            }
+        }
+    }
+
+    unsigned int SpatialHash::nextMark()
+    {
+        if(++mark == 0)
+        {
+            for(auto it = entries.begin(), end = entries.end(); it != end; ++it)
+            {
+                it->mark = 0;
+            }
+            mark = 1;
+        }
+        return mark;
+    }
+
+    int SpatialHash::insert(const Rect& rect)
+    {
+        int handle;
+        if(freeHandles.empty())
+        {
+            handle = int(entries.size());
+            entries.push_back(Entry());
+        }
+        else
+        {
+            handle = freeHandles.back();
+            freeHandles.pop_back();
+        }
+
+        Entry& e(entries[handle]);
+        e.rect = normalize(rect);
+        e.cellX = toCell(e.rect.x);
+        e.cellY = toCell(e.rect.y);
+        e.cellX2 = toCell(e.rect.x + e.rect.width);
+        e.cellY2 = toCell(e.rect.y + e.rect.height);
+        e.mark = 0;
+        e.active = true;
+        attach(handle);
+        ++count;
+        return handle;
+    }
+
+    void SpatialHash::update(int handle, const Rect& rect)
+    {
+        if(!contains(handle)) return;
+
+        Entry& e(entries[handle]);
+        e.rect = normalize(rect);
+        int cellX = toCell(e.rect.x);
+        int cellY = toCell(e.rect.y);
+        int cellX2 = toCell(e.rect.x + e.rect.width);
+        int cellY2 = toCell(e.rect.y + e.rect.height);
+        if(cellX == e.cellX && cellY == e.cellY && cellX2 == e.cellX2 && cellY2 == e.cellY2)
+        {
+            return;
+        }
+
+        // Oversized on either side, there's no small difference worth working out.
+        if(e.oversized || isOversized(cellX, cellY, cellX2, cellY2))
+        {
+            detach(handle);
+            e.cellX = cellX;
+            e.cellY = cellY;
+            e.cellX2 = cellX2;
+            e.cellY2 = cellY2;
+            attach(handle);
+            return;
+        }
+
+        // Leave the cells outside the new range, and join the ones outside the old range.
+        for(int cy = e.cellY; cy <= e.cellY2; ++cy)
+        {
+            for(int cx = e.cellX; cx <= e.cellX2; ++cx)
+            {
+                if(cx < cellX || cx > cellX2 || cy < cellY || cy > cellY2)
+                {
+                    unplace(handle, cx, cy, cx, cy);
+                }
+            }
+        }
+        for(int cy = cellY; cy <= cellY2; ++cy)
+        {
+            for(int cx = cellX; cx <= cellX2; ++cx)
+            {
+                if(cx < e.cellX || cx > e.cellX2 || cy < e.cellY || cy > e.cellY2)
+                {
+                    place(handle, cx, cy, cx, cy);
+                }
+            }
+        }
+        e.cellX = cellX;
+        e.cellY = cellY;
+        e.cellX2 = cellX2;
+        e.cellY2 = cellY2;
+    }
+
+    void SpatialHash::remove(int handle)
+    {
+        if(!contains(handle)) return;
+
+        Entry& e(entries[handle]);
+        detach(handle);
+        e.active = false;
+        freeHandles.push_back(handle);
+        --count;
+    }
+
+    void SpatialHash::clear()
+    {
+        entries.clear();
+        freeHandles.clear();
+        cells.clear();
+        oversized.clear();
+        count = 0;
+        mark = 0;
+    }
+
+    bool SpatialHash::contains(int handle) const
+    {
+        return handle >= 0 && handle < int(entries.size()) && entries[handle].active;
+    }
+
+    const Rect& SpatialHash::getRect(int handle) const
+    {
+        return entries[handle].rect;
+    }
+
+    void SpatialHash::queryRect(const Rect& rect, std::vector<int>& results)
+    {
+        Rect area(normalize(rect));
+        int cellX = toCell(area.x);
+        int cellY = toCell(area.y);
+        int cellX2 = toCell(area.x + area.width);
+        int cellY2 = toCell(area.y + area.height);
+
+        unsigned int m = nextMark();
+        for(auto it = oversized.begin(), end = oversized.end(); it != end; ++it)
+        {
+            check(*it, area, m, results);
+        }
+
+        // A query covering more cells than there are only looks at the ones that exist.
+        int64_t width = int64_t(cellX2) - cellX + 1;
+        int64_t height = int64_t(cellY2) - cellY + 1;
+        int64_t existing = int64_t(cells.size());
+        if(width > existing || width * height > existing)
+        {
+            for(auto it = cells.begin(), end = cells.end(); it != end; ++it)
+            {
+                const Cell& cell(it->second);
+                if(cell.x >= cellX && cell.x <= cellX2 && cell.y >= cellY && cell.y <= cellY2)
+                {
+                    for(auto h = cell.handles.begin(), hend = cell.handles.end(); h != hend; ++h)
+                    {
+                        check(*h, area, m, results);
+                    }
+                }
+            }
+            return;
+        }
+
+        for(int cy = cellY; cy <= cellY2; ++cy)
+        {
+            for(int cx = cellX; cx <= cellX2; ++cx)
+            {
+                auto it = cells.find(key(cx, cy));
+                if(it == cells.end())
+                {
+                    continue;
+                }
+                const auto& handles(it->second.handles);
+                for(auto h = handles.begin(), end = handles.end(); h != end; ++h)
+                {
+                    check(*h, area, m, results);
+                }
+            }
+        }
+    }
+
+    void SpatialHash::queryPoint(double x, double y, std::vector<int>& results)
+    {
+        queryRect(Rect(x, y, 0, 0), results);
+    }
+
+    void SpatialHash::queryPairs(std::vector<std::pair<int, int>>& results) const
+    {
+        for(auto it = cells.begin(), end = cells.end(); it != end; ++it)
+        {
+            const Cell& cell(it->second);
+            const auto& handles(cell.handles);
+            for(size_t i = 0; i < handles.size(); ++i)
+            {
+                const Entry& a(entries[handles[i]]);
+                for(size_t j = i + 1; j < handles.size(); ++j)
+                {
+                    const Entry& b(entries[handles[j]]);
+                    // Pairs sharing several cells are only reported from the first one they share.
+                    if(cell.x != std::max(a.cellX, b.cellX) || cell.y != std::max(a.cellY, b.cellY))
+                    {
+                        continue;
+                    }
+                    if(touches(a.rect, b.rect))
+                    {
+                        results.push_back(std::make_pair(std::min(handles[i], handles[j]), std::max(handles[i], handles[j])));
+                    }
+                }
+            }
+        }
+
+        // Oversized entries aren't in any cell, so they're checked against everything else.
+        // Two oversized entries are paired from the lower handle.
+        for(auto it = oversized.begin(), end = oversized.end(); it != end; ++it)
+        {
+            const Entry& a(entries[*it]);
+            for(int j = 0; j < int(entries.size()); ++j)
+            {
+                const Entry& b(entries[j]);
+                if(!b.active || j == *it || (b.oversized && j < *it))
+                {
+                    continue;
+                }
+                if(touches(a.rect, b.rect))
+                {
+                    results.push_back(std::make_pair(std::min(*it, j), std::max(*it, j)));
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,93 @@
+#ifndef PLUM_SPATIALHASH_H
+#define PLUM_SPATIALHASH_H
+
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <unordered_map>
+
+#include "transform.h"
+
+namespace plum
+{
+    // A uniform grid of buckets, for finding which rectangles are near each other without testing every pair.
+    // Each entry is filed under every cell its rectangle covers, and is found again by the handle it was given.
+    // Entries too big for that are kept aside in a list of their own, which every query checks.
+    // Overlaps count touching edges, the same as Rect's touchesSelf.
+    class SpatialHash
+    {
+        public:
+            static const int DefaultCellSize = 64;
+            static const int InvalidHandle = -1;
+
+            SpatialHash(double cellSize = DefaultCellSize);
+            ~SpatialHash();
+
+            double getCellSize() const;
+            int getCount() const;
+
+            // Returns the handle for the new entry. Handles of removed entries get reused.
+            // Rectangles with a negative width or height are flipped around, and stored that way.
+            int insert(const Rect& rect);
+            // Only the cells the rectangle left or entered are touched, so small moves are cheap.
+            void update(int handle, const Rect& rect);
+            void remove(int handle);
+            void clear();
+
+            bool contains(int handle) const;
+            const Rect& getRect(int handle) const;
+
+            // These append to results, rather than replacing what's there.
+            void queryRect(const Rect& rect, std::vector<int>& results);
+            void queryPoint(double x, double y, std::vector<int>& results);
+            // Every overlapping pair, each reported once.
+            void queryPairs(std::vector<std::pair<int, int>>& results) const;
+
+        private:
+            struct Entry
+            {
+                Rect rect;
+                // Range of cells covered, inclusive.
+                int cellX, cellY, cellX2, cellY2;
+                // Covers too many cells to be filed under each, so it's in the oversized list instead.
+                bool oversized;
+                // The last query that saw this entry, so one covering several cells is only reported once.
+                unsigned int mark;
+                bool active;
+            };
+
+            struct Cell
+            {
+                int x, y;
+                std::vector<int> handles;
+            };
+
+            double cellSize;
+            int count;
+            unsigned int mark;
+            std::vector<Entry> entries;
+            std::vector<int> freeHandles;
+            std::unordered_map<uint64_t, Cell> cells;
+            std::vector<int> oversized;
+
+            int toCell(double value) const;
+            static uint64_t key(int cx, int cy);
+            static bool touches(const Rect& a, const Rect& b);
+            static Rect normalize(const Rect& rect);
+            static bool isOversized(int cellX, int cellY, int cellX2, int cellY2);
+
+            void place(int handle, int cellX, int cellY, int cellX2, int cellY2);
+            void unplace(int handle, int cellX, int cellY, int cellX2, int cellY2);
+            // Files an entry under its cells, or in the oversized list, and takes it back out again.
+            void attach(int handle);
+            void detach(int handle);
+            void check(int handle, const Rect& area, unsigned int m, std::vector<int>& results);
+            // Starts a new query mark, clearing the old ones on the rare occasion it wraps around.
+            unsigned int nextMark();
+
+            SpatialHash(const SpatialHash&);
+            void operator =(const SpatialHash&);
+    };
+}
+
+#endif
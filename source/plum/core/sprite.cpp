@@ -66,6 +66,14 @@ namespace plum
         image_.bind();
     }
 
+    void Sprite::getFrameRegion(int f, int& x, int& y, int& x2, int& y2) const
+    {
+        x = (f % columns) * (frameWidth + padding) + padding;
+        y = (f / columns) * (frameHeight + padding) + padding;
+        x2 = x + frameWidth - 1;
+        y2 = y + frameHeight - 1;
+    }
+
     Color Sprite::getFramePixel(int f, int x, int y)
     {
         if(!columns || x < 0 || x >= frameWidth || y < 0 || y >= frameHeight) return 0;
@@ -79,17 +87,17 @@ namespace plum
     {
         if(!columns) return;
 
-        int fx = (f % columns) * (frameWidth + padding) + padding;
-        int fy = (f / columns) * (frameHeight + padding) + padding;
-        image_.blitRegion(fx, fy, fx + frameWidth - 1, fy + frameHeight - 1, x, y, mode);
+        int fx, fy, fx2, fy2;
+        getFrameRegion(f, fx, fy, fx2, fy2);
+        image_.blitRegion(fx, fy, fx2, fy2, x, y, mode);
     }
 
     void Sprite::rawBlitFrame(int x, int y, int f, double angle, double scale)
     {
         if(!columns) return;
 
-        int fx = (f % columns) * (frameWidth + padding) + padding;
-        int fy = (f / columns) * (frameHeight + padding) + padding;
-        image_.rawBlitRegion(fx, fy, fx + frameWidth - 1, fy + frameHeight - 1, x, y, 0, 1);
+        int fx, fy, fx2, fy2;
+        getFrameRegion(f, fx, fy, fx2, fy2);
+        image_.rawBlitRegion(fx, fy, fx2, fy2, x, y, 0, 1);
     }
 }
\ No newline at end of file
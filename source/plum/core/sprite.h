@@ -27,6 +27,7 @@ namespace plum
             Image& image();
 
             void bind();
+            void getFrameRegion(int f, int& x, int& y, int& x2, int& y2) const;
             Color getFramePixel(int f, int x, int y);
             void blitFrame(int x, int y, int f, BlendMode mode);
             void rawBlitFrame(int x, int y, int f, double angle, double scale);
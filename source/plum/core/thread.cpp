@@ -0,0 +1,262 @@
+#include "thread.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <errno.h>
+#include <sys/time.h>
+#endif
+
+namespace plum
+{
+#ifdef _WIN32
+    class Mutex::Impl
+    {
+        public:
+            Impl()
+            {
+                InitializeCriticalSection(&section);
+            }
+
+            ~Impl()
+            {
+                DeleteCriticalSection(&section);
+            }
+
+            CRITICAL_SECTION section;
+    };
+
+    class Condition::Impl
+    {
+        public:
+            Impl()
+            {
+                InitializeConditionVariable(&condition);
+            }
+
+            CONDITION_VARIABLE condition;
+    };
+
+    class Thread::Impl
+    {
+        public:
+            Impl(const Function& function)
+                : function(function), handle(nullptr)
+            {
+            }
+
+            ~Impl()
+            {
+                if(handle)
+                {
+                    CloseHandle(handle);
+                }
+            }
+
+            static DWORD WINAPI run(LPVOID data)
+            {
+                ((Impl*) data)->function();
+                return 0;
+            }
+
+            Function function;
+            HANDLE handle;
+    };
+
+    Mutex::Mutex()
+        : impl(new Impl())
+    {
+    }
+
+    Mutex::~Mutex()
+    {
+    }
+
+    void Mutex::lock()
+    {
+        EnterCriticalSection(&impl->section);
+    }
+
+    void Mutex::unlock()
+    {
+        LeaveCriticalSection(&impl->section);
+    }
+
+    Condition::Condition()
+        : impl(new Impl())
+    {
+    }
+
+    Condition::~Condition()
+    {
+    }
+
+    void Condition::wait(Mutex& mutex)
+    {
+        SleepConditionVariableCS(&impl->condition, &mutex.impl->section, INFINITE);
+    }
+
+    bool Condition::wait(Mutex& mutex, int milliseconds)
+    {
+        return SleepConditionVariableCS(&impl->condition, &mutex.impl->section, DWORD(milliseconds)) != FALSE;
+    }
+
+    void Condition::signal()
+    {
+        WakeConditionVariable(&impl->condition);
+    }
+
+    void Condition::broadcast()
+    {
+        WakeAllConditionVariable(&impl->condition);
+    }
+
+    Thread::Thread(const Function& function)
+        : impl(new Impl(function))
+    {
+        impl->handle = CreateThread(nullptr, 0, Impl::run, impl.get(), 0, nullptr);
+    }
+
+    Thread::~Thread()
+    {
+        join();
+    }
+
+    void Thread::join()
+    {
+        if(impl->handle)
+        {
+            WaitForSingleObject(impl->handle, INFINITE);
+            CloseHandle(impl->handle);
+            impl->handle = nullptr;
+        }
+    }
+#else
+    class Mutex::Impl
+    {
+        public:
+            Impl()
+            {
+                pthread_mutex_init(&mutex, nullptr);
+            }
+
+            ~Impl()
+            {
+                pthread_mutex_destroy(&mutex);
+            }
+
+            pthread_mutex_t mutex;
+    };
+
+    class Condition::Impl
+    {
+        public:
+            Impl()
+            {
+                pthread_cond_init(&condition, nullptr);
+            }
+
+            ~Impl()
+            {
+                pthread_cond_destroy(&condition);
+            }
+
+            pthread_cond_t condition;
+    };
+
+    class Thread::Impl
+    {
+        public:
+            Impl(const Function& function)
+                : function(function), started(false)
+            {
+            }
+
+            static void* run(void* data)
+            {
+                ((Impl*) data)->function();
+                return nullptr;
+            }
+
+            Function function;
+            pthread_t thread;
+            bool started;
+    };
+
+    Mutex::Mutex()
+        : impl(new Impl())
+    {
+    }
+
+    Mutex::~Mutex()
+    {
+    }
+
+    void Mutex::lock()
+    {
+        pthread_mutex_lock(&impl->mutex);
+    }
+
+    void Mutex::unlock()
+    {
+        pthread_mutex_unlock(&impl->mutex);
+    }
+
+    Condition::Condition()
+        : impl(new Impl())
+    {
+    }
+
+    Condition::~Condition()
+    {
+    }
+
+    void Condition::wait(Mutex& mutex)
+    {
+        pthread_cond_wait(&impl->condition, &mutex.impl->mutex);
+    }
+
+    bool Condition::wait(Mutex& mutex, int milliseconds)
+    {
+        // The deadline is absolute, and measured against the realtime clock.
+        timeval now;
+        gettimeofday(&now, nullptr);
+        long long nanoseconds = (long long) now.tv_usec * 1000 + (long long) milliseconds * 1000000;
+        timespec deadline;
+        deadline.tv_sec = now.tv_sec + time_t(nanoseconds / 1000000000);
+        deadline.tv_nsec = long(nanoseconds % 1000000000);
+        return pthread_cond_timedwait(&impl->condition, &mutex.impl->mutex, &deadline) != ETIMEDOUT;
+    }
+
+    void Condition::signal()
+    {
+        pthread_cond_signal(&impl->condition);
+    }
+
+    void Condition::broadcast()
+    {
+        pthread_cond_broadcast(&impl->condition);
+    }
+
+    Thread::Thread(const Function& function)
+        : impl(new Impl(function))
+    {
+        impl->started = pthread_create(&impl->thread, nullptr, Impl::run, impl.get()) == 0;
+    }
+
+    Thread::~Thread()
+    {
+        join();
+    }
+
+    void Thread::join()
+    {
+        if(impl->started)
+        {
+            pthread_join(impl->thread, nullptr);
+            impl->started = false;
+        }
+    }
+#endif
+}
@@ -0,0 +1,89 @@
+#ifndef PLUM_THREAD_H
+#define PLUM_THREAD_H
+
+#include <memory>
+#include <functional>
+
+namespace plum
+{
+    class Mutex
+    {
+        public:
+            Mutex();
+            ~Mutex();
+
+            void lock();
+            void unlock();
+
+            class Impl;
+            std::shared_ptr<Impl> impl;
+
+        private:
+            Mutex(const Mutex&);
+            void operator =(const Mutex&);
+    };
+
+    // Holds a mutex for as long as it's in scope.
+    class Lock
+    {
+        public:
+            Lock(Mutex& mutex)
+                : mutex(mutex)
+            {
+                mutex.lock();
+            }
+
+            ~Lock()
+            {
+                mutex.unlock();
+            }
+
+        private:
+            Mutex& mutex;
+
+            Lock(const Lock&);
+            void operator =(const Lock&);
+    };
+
+    class Condition
+    {
+        public:
+            Condition();
+            ~Condition();
+
+            // The mutex must be locked by the caller. It's released while waiting, and locked again before returning.
+            void wait(Mutex& mutex);
+            // Same, but gives up after the timeout. Returns false if it timed out.
+            bool wait(Mutex& mutex, int milliseconds);
+            void signal();
+            void broadcast();
+
+            class Impl;
+            std::shared_ptr<Impl> impl;
+
+        private:
+            Condition(const Condition&);
+            void operator =(const Condition&);
+    };
+
+    class Thread
+    {
+        public:
+            typedef std::function<void()> Function;
+
+            // Starts running the function right away. The thread is joined on destruction.
+            Thread(const Function& function);
+            ~Thread();
+
+            void join();
+
+            class Impl;
+            std::shared_ptr<Impl> impl;
+
+        private:
+            Thread(const Thread&);
+            void operator =(const Thread&);
+    };
+}
+
+#endif
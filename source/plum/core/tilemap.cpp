@@ -1,6 +1,5 @@
-#include "screen.h"
+#include <algorithm>
 #include "tilemap.h"
-#include "sprite.h"
 
 namespace plum
 {
@@ -9,6 +8,9 @@ namespace plum
         this->width = width;
         this->height = height;
         data = new unsigned int[width * height];
+        chunksWide = (width + ChunkSize - 1) / ChunkSize;
+        chunksHigh = (height + ChunkSize - 1) / ChunkSize;
+        dirty.resize(chunksWide * chunksHigh, true);
         clear(0);
     }
 
@@ -27,12 +29,36 @@ namespace plum
         return height;
     }
 
+    void Tilemap::invalidate(int tx, int ty, int tx2, int ty2)
+    {
+        if(tx > tx2)
+        {
+            std::swap(tx, tx2);
+        }
+        if(ty > ty2)
+        {
+            std::swap(ty, ty2);
+        }
+        int cx = std::max(tx, 0) / ChunkSize;
+        int cy = std::max(ty, 0) / ChunkSize;
+        int cx2 = std::min(tx2 / ChunkSize, chunksWide - 1);
+        int cy2 = std::min(ty2 / ChunkSize, chunksHigh - 1);
+        for(int i = cy; i <= cy2; ++i)
+        {
+            for(int j = cx; j <= cx2; ++j)
+            {
+                dirty[i * chunksWide + j] = true;
+            }
+        }
+    }
+
     void Tilemap::clear(unsigned int tileIndex)
     {
         for(int i = 0; i < width * height; ++i)
         {
             data[i] = tileIndex;
         }
+        invalidate(0, 0, width - 1, height - 1);
     }
 
     unsigned int Tilemap::getTile(int tx, int ty) const
@@ -45,6 +71,7 @@ namespace plum
     {
         if(tx < 0 || tx >= width || ty < 0 || ty >= height) return;
         data[ty * width + tx] = tileIndex;
+        invalidate(tx, ty, tx, ty);
     }
 
     void Tilemap::rect(int tx, int ty, int tx2, int ty2, unsigned int tileIndex)
@@ -80,6 +107,7 @@ namespace plum
         {
             ty2 = width - 1;
         }
+        invalidate(tx, ty, tx2, ty2);
         // Draw the horizontal lines of the rectangle.
         for(i = tx; i <= tx2; ++i)
         {
@@ -127,6 +155,7 @@ namespace plum
         {
             ty2 = width - 1;
         }
+        invalidate(tx, ty, tx2, ty2);
         // Plot the solid rectangle
         for(i = ty; i <= ty2; ++i)
         {
@@ -229,6 +258,7 @@ namespace plum
         {
             return;
         }
+        invalidate(tx, ty, tx2, ty2);
         // A single pixel
         if(tx == tx2 && ty == ty2)
         {
@@ -359,6 +389,7 @@ namespace plum
         {
             sourceY2 -= ty2 - dest->height - 1;
         }
+        dest->invalidate(sourceX + tx, sourceY + ty, sourceX2 + tx, sourceY2 + ty);
         // Plot the tilemap, tile for tile
         for(i = sourceY; i <= sourceY2; ++i)
         {
@@ -368,48 +399,4 @@ namespace plum
             }
         }
     }
-
-    void Tilemap::blit(Screen& screen, Sprite& spr, int worldX, int worldY, int destX, int destY, int tilesWide, int tilesHigh, BlendMode mode)
-    {
-        if(tilesWide < 0 || tilesHigh < 0) return;
-
-        int xofs = -(worldX % spr.getFrameWidth());
-        int yofs = -(worldY % spr.getFrameHeight());
-        int tileX = worldX / spr.getFrameWidth();
-        int tileY = worldY / spr.getFrameHeight();
-
-        // Clip the tile region to make sure things don't crash.
-        if(tileX < 0)
-        {
-            tileX = 0;
-        }
-        if(tileY < 0)
-        {
-            tileY = 0;
-        }
-        if(tileX + tilesWide > width)
-        {
-            tilesWide = width - tileX;
-        }
-        if(tileY + tilesHigh > height)
-        {
-            tilesHigh = height - tileY;
-        }
-
-        int i, j;
-
-        screen.startBatch();
-        spr.bind();
-
-        useHardwareBlender(mode);
-        for(i = 0; i < tilesHigh; ++i)
-        {
-            for(j = 0; j < tilesWide; ++j)
-            {
-                spr.rawBlitFrame(j * spr.getFrameWidth() + xofs + destX, i * spr.getFrameHeight() + yofs + destY,
-                    data[(tileY + i) * width + (tileX + j)], 0, 1);
-            }
-        }
-        screen.endBatch();
-    }
 }
\ No newline at end of file
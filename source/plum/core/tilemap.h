@@ -1,5 +1,7 @@
 #ifndef PLUM_TILEMAP_H
 #define PLUM_TILEMAP_H
+#include <memory>
+#include <vector>
 #include "color.h"
 #include "blending.h"
 
@@ -11,6 +13,8 @@ namespace plum
     {
         public:
             static const unsigned int InvalidTile = (unsigned int)(-1);
+            // Tiles per side of the blocks that get cached together for rendering.
+            static const int ChunkSize = 16;
 
             Tilemap(int width, int height);
             ~Tilemap();
@@ -31,6 +35,19 @@ namespace plum
         private:
             int width, height;
             unsigned int* data;
+
+            // Marks every chunk touching the tile rectangle as needing a rebuild.
+            void invalidate(int tx, int ty, int tx2, int ty2);
+
+            int chunksWide, chunksHigh;
+            std::vector<bool> dirty;
+
+            // Platform-specific render data built from the chunks.
+            class Cache;
+            std::shared_ptr<Cache> cache;
+
+            Tilemap(const Tilemap&);
+            void operator =(const Tilemap&);
     };
 }
 
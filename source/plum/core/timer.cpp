@@ -0,0 +1,195 @@
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "timer.h"
+#include "engine.h"
+
+namespace plum
+{
+    // Out-of-line definitions, for anything that binds these to a reference, like std::min.
+    const int Timer::FastForwardMultiplier;
+    const int Timer::SlowMotionDivisor;
+    const int Timer::DefaultMaxDelta;
+    const int Timer::DefaultRate;
+    const int Timer::FrameWindow;
+
+    // Frame times, the FPS and the step accumulator are the same everywhere.
+    // Platforms only supply the clock, and how far each frame moves the game along.
+    class Timer::Impl
+    {
+        public:
+            Impl(Engine& engine)
+                : engine(engine)
+            {
+                speed = TimerSpeedNormal;
+                maxDelta = DefaultMaxDelta;
+                rate = DefaultRate;
+
+                frameTimes.assign(FrameWindow, 0);
+                frameCount = 0;
+                frameIndex = 0;
+                frameSum = 0;
+                fps = 0;
+
+                reset();
+
+                hook = engine.addUpdateHook([this](){ update(); });
+            }
+
+            ~Impl()
+            {
+            }
+
+            // The accumulator counts microseconds scaled by both the slow motion divisor and the rate,
+            // so that every speed and rate divides into whole steps without drifting.
+            uint64_t stepSize() const
+            {
+                return uint64_t(1000000) * SlowMotionDivisor;
+            }
+
+            void reset()
+            {
+                previousTime = now();
+                accumulator = 0;
+                delta = 0;
+                elapsed = 0;
+            }
+
+            void update()
+            {
+                uint64_t time = now();
+                uint64_t frameTime = time - previousTime;
+                previousTime = time;
+
+                frameSum += frameTime - frameTimes[frameIndex];
+                frameTimes[frameIndex] = frameTime;
+                frameIndex = (frameIndex + 1) % FrameWindow;
+                frameCount = std::min(frameCount + 1, FrameWindow);
+                fps = frameSum ? (unsigned int) ((uint64_t(frameCount) * 1000000 + frameSum / 2) / frameSum) : 0;
+
+                uint64_t advanced = advance(frameTime, rate);
+                switch(speed)
+                {
+                    case TimerSpeedFastForward: accumulator += advanced * SlowMotionDivisor * FastForwardMultiplier; break;
+                    case TimerSpeedNormal: accumulator += advanced * SlowMotionDivisor; break;
+                    case TimerSpeedSlowMotion: accumulator += advanced; break;
+                }
+
+                uint64_t steps = accumulator / stepSize();
+                accumulator -= steps * stepSize();
+                // Anything past the cap is dropped, rather than making every following frame catch up on it.
+                if(speed != TimerSpeedFastForward)
+                {
+                    steps = std::min(uint64_t(maxDelta), steps);
+                }
+                delta = (unsigned int) steps;
+                elapsed += delta;
+            }
+
+            uint64_t percentile(double p) const
+            {
+                if(!frameCount) return 0;
+
+                std::vector<uint64_t> times(frameTimes.begin(), frameTimes.begin() + frameCount);
+                int rank = int(std::ceil(std::min(std::max(p, 0.0), 100.0) / 100.0 * frameCount));
+                auto it = times.begin() + std::max(rank - 1, 0);
+                std::nth_element(times.begin(), it, times.end());
+                return *it;
+            }
+
+            Engine& engine;
+            std::shared_ptr<Engine::UpdateHook> hook;
+
+            TimerSpeed speed;
+            unsigned int maxDelta;
+            unsigned int rate;
+
+            uint64_t previousTime;
+            uint64_t accumulator;
+            unsigned int delta;
+            unsigned int elapsed;
+            unsigned int fps;
+
+            // Ring of the most recent frame times, in microseconds.
+            std::vector<uint64_t> frameTimes;
+            int frameCount;
+            int frameIndex;
+            uint64_t frameSum;
+    };
+
+    Timer::Timer(Engine& engine)
+        : impl(new Impl(engine))
+    {
+    }
+
+    Timer::~Timer()
+    {
+    }
+
+    void Timer::reset()
+    {
+        impl->reset();
+    }
+
+    TimerSpeed Timer::getSpeed() const
+    {
+        return impl->speed;
+    }
+
+    unsigned int Timer::getMaxDelta() const
+    {
+        return impl->maxDelta;
+    }
+
+    unsigned int Timer::getRate() const
+    {
+        return impl->rate;
+    }
+
+    unsigned int Timer::getTime() const
+    {
+        return impl->elapsed;
+    }
+
+    unsigned int Timer::getDelta() const
+    {
+        return impl->delta;
+    }
+
+    unsigned int Timer::getFPS() const
+    {
+        return impl->fps;
+    }
+
+    double Timer::getAlpha() const
+    {
+        return double(impl->accumulator) / impl->stepSize();
+    }
+
+    uint64_t Timer::getFrameTime() const
+    {
+        return impl->frameCount ? impl->frameTimes[(impl->frameIndex + FrameWindow - 1) % FrameWindow] : 0;
+    }
+
+    uint64_t Timer::getFrameTimePercentile(double percentile) const
+    {
+        return impl->percentile(percentile);
+    }
+
+    void Timer::setSpeed(TimerSpeed speed)
+    {
+        impl->speed = speed;
+    }
+
+    void Timer::setMaxDelta(unsigned int value)
+    {
+        impl->maxDelta = value;
+    }
+
+    void Timer::setRate(unsigned int value)
+    {
+        // The accumulator holds a fraction of a step whatever the rate, so it carries over as is.
+        impl->rate = std::max(value, 1u);
+    }
+}
@@ -2,6 +2,7 @@
 #define PLUM_TIMER_H
 
 #include <memory>
+#include <cstdint>
 
 namespace plum
 {
@@ -20,23 +21,44 @@ namespace plum
             static const int SlowMotionDivisor = 4;
 
             static const int DefaultMaxDelta = 5;
+            // Fixed update steps per second. Time and delta are counted in these.
+            static const int DefaultRate = 100;
+            // Number of recent frames kept for the FPS and frame time percentiles.
+            static const int FrameWindow = 256;
 
             Timer(Engine& engine);
             ~Timer();
 
+            // Drops any accumulated time, and restarts the count from now.
             void reset();
 
             TimerSpeed getSpeed() const;
             unsigned int getMaxDelta() const;
+            unsigned int getRate() const;
             unsigned int getTime() const;
+            // Whole fixed steps that came due this frame, capped at the max delta.
             unsigned int getDelta() const;
             unsigned int getFPS() const;
+            // How far the clock is into the next fixed step, from 0 up to 1, for interpolating between updates when rendering.
+            double getAlpha() const;
+
+            // Real time taken by the last frame, and percentiles (0 to 100) over the recent window, in microseconds.
+            uint64_t getFrameTime() const;
+            uint64_t getFrameTimePercentile(double percentile) const;
 
             void setSpeed(TimerSpeed speed);
             void setMaxDelta(unsigned int value);
+            void setRate(unsigned int value);
 
             class Impl;
             std::shared_ptr<Impl> impl;
+
+        private:
+            // Provided by the platform. Its clock, in microseconds.
+            static uint64_t now();
+            // Also provided by the platform. How much game time a frame that really took the given
+            // number of microseconds counts for, in microseconds times the rate, before the speed applies.
+            static uint64_t advance(uint64_t frameTime, unsigned int rate);
     };
 }
 
@@ -0,0 +1,147 @@
+#include <vector>
+
+#include "thread.h"
+#include "workers.h"
+#include "profile.h"
+
+namespace plum
+{
+    namespace
+    {
+        WorkerPool* activePool = nullptr;
+    }
+
+    class WorkerPool::Impl
+    {
+        public:
+            Impl(int threshold)
+                : threshold(threshold), task(nullptr), count(0), next(0), pending(0), quitting(false)
+            {
+            }
+
+            // Runs parts of the current job until there are none left to hand out.
+            // Expects the mutex to be held.
+            void work()
+            {
+                while(task && next < count)
+                {
+                    int index = next++;
+                    const Task& current(*task);
+                    mutex.unlock();
+                    current(index);
+                    mutex.lock();
+                    if(--pending == 0)
+                    {
+                        finished.broadcast();
+                    }
+                }
+            }
+
+            void loop()
+            {
+                profile::setThreadName("Worker");
+                Lock lock(mutex);
+                while(!quitting)
+                {
+                    work();
+                    if(!quitting)
+                    {
+                        wake.wait(mutex);
+                    }
+                }
+            }
+
+            int threshold;
+            std::vector<std::shared_ptr<Thread>> threads;
+
+            Mutex mutex;
+            Condition wake;
+            Condition finished;
+
+            const Task* task;
+            int count;
+            int next;
+            int pending;
+            bool quitting;
+    };
+
+    WorkerPool::WorkerPool(int threadCount, int threshold)
+        : impl(new Impl(threshold))
+    {
+        auto worker = impl.get();
+        for(int i = 0; i < threadCount; ++i)
+        {
+            impl->threads.push_back(std::make_shared<Thread>([worker](){ worker->loop(); }));
+        }
+        activePool = this;
+    }
+
+    WorkerPool::~WorkerPool()
+    {
+        {
+            Lock lock(impl->mutex);
+            impl->quitting = true;
+            impl->wake.broadcast();
+        }
+        impl->threads.clear();
+
+        if(activePool == this)
+        {
+            activePool = nullptr;
+        }
+    }
+
+    WorkerPool* WorkerPool::current()
+    {
+        return activePool;
+    }
+
+    int WorkerPool::getThreadCount() const
+    {
+        return int(impl->threads.size());
+    }
+
+    int WorkerPool::getThreshold() const
+    {
+        return impl->threshold;
+    }
+
+    void WorkerPool::setThreshold(int value)
+    {
+        impl->threshold = value;
+    }
+
+    void WorkerPool::run(int count, const Task& task)
+    {
+        if(count <= 0)
+        {
+            return;
+        }
+
+        impl->mutex.lock();
+        // Jobs started from inside another job just run in place.
+        if(impl->task || count == 1 || impl->threads.empty())
+        {
+            impl->mutex.unlock();
+            for(int i = 0; i < count; ++i)
+            {
+                task(i);
+            }
+            return;
+        }
+
+        impl->task = &task;
+        impl->count = count;
+        impl->next = 0;
+        impl->pending = count;
+        impl->wake.broadcast();
+
+        impl->work();
+        while(impl->pending)
+        {
+            impl->finished.wait(impl->mutex);
+        }
+        impl->task = nullptr;
+        impl->mutex.unlock();
+    }
+}
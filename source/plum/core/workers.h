@@ -0,0 +1,41 @@
+#ifndef PLUM_WORKERS_H
+#define PLUM_WORKERS_H
+
+#include <memory>
+#include <functional>
+
+namespace plum
+{
+    // A small pool of threads for splitting up big jobs, like drawing onto a large canvas.
+    // The thread that hands out a job works on it too, and waits until every part is finished.
+    class WorkerPool
+    {
+        public:
+            typedef std::function<void(int)> Task;
+
+            // Jobs covering fewer pixels than this aren't worth waking the workers for.
+            static const int DefaultThreshold = 256 * 256;
+
+            WorkerPool(int threadCount, int threshold = DefaultThreshold);
+            ~WorkerPool();
+
+            // The pool belonging to the engine, or nullptr if there is none.
+            static WorkerPool* current();
+
+            int getThreadCount() const;
+            int getThreshold() const;
+            void setThreshold(int value);
+
+            // Calls task(i) for every i in [0, count), spread across the workers.
+            void run(int count, const Task& task);
+
+            class Impl;
+            std::shared_ptr<Impl> impl;
+
+        private:
+            WorkerPool(const WorkerPool&);
+            void operator =(const WorkerPool&);
+    };
+}
+
+#endif
@@ -1,5 +1,7 @@
 #include <cstdlib>
+#include <cstring>
 #include <memory>
+#include <stdexcept>
 #include <corona.h>
 #include "../../core/file.h"
 #include "../../core/canvas.h"
@@ -67,4 +69,20 @@ namespace plum
         canvas.replaceColor(Color::Magenta, 0);
         return canvas;
     }
+
+    bool Canvas::save(const std::string& filename) const
+    {
+        std::unique_ptr<corona::Image> image(corona::CreateImage(width, height, corona::PF_R8G8B8A8));
+        if(!image.get())
+        {
+            return false;
+        }
+        for(int y = 0; y < height; ++y)
+        {
+            std::memcpy((Color*) image->getPixels() + y * width, data + y * trueWidth, sizeof(Color) * width);
+        }
+
+        std::unique_ptr<corona::File> file(new FileWrapper(new File(filename, FileWrite)));
+        return corona::SaveImage(file.get(), corona::FF_PNG, image.get());
+    }
 }
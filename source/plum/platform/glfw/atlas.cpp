@@ -0,0 +1,171 @@
+#include <climits>
+#include <algorithm>
+
+#include "atlas.h"
+#include "batch.h"
+#include "../../core/color.h"
+#include "../../core/profile.h"
+
+namespace plum
+{
+    namespace
+    {
+        std::vector<std::weak_ptr<AtlasPage>> pages;
+    }
+
+    std::shared_ptr<AtlasPage> AtlasPage::allocate(int width, int height, int& x, int& y)
+    {
+        if(width <= 0 || height <= 0 || width > MaxImageSize || height > MaxImageSize)
+        {
+            return nullptr;
+        }
+
+        for(auto it = pages.begin(); it != pages.end();)
+        {
+            if(auto page = it->lock())
+            {
+                if(page->insert(width + Gutter, height + Gutter, x, y))
+                {
+                    return page;
+                }
+                ++it;
+            }
+            else
+            {
+                it = pages.erase(it);
+            }
+        }
+
+        auto page = std::make_shared<AtlasPage>();
+        pages.push_back(page);
+        page->insert(width + Gutter, height + Gutter, x, y);
+        return page;
+    }
+
+    AtlasPage::AtlasPage()
+    {
+        Node node = { 0, 0, Size };
+        skyline.push_back(node);
+
+        // Start out fully transparent, so the gutters stay clear.
+        std::vector<Color> blank(Size * Size, Color(0));
+        glGenTextures(1, &textureID);
+        if(auto batch = SpriteBatch::current())
+        {
+            batch->setTexture(textureID);
+        }
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        profile::count(profile::CounterTextureBinds);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, Size, Size, 0, GL_RGBA, GL_UNSIGNED_BYTE, &blank[0]);
+        profile::count(profile::CounterUploadBytes, Size * Size * sizeof(Color));
+    }
+
+    AtlasPage::~AtlasPage()
+    {
+        if(auto batch = SpriteBatch::current())
+        {
+            batch->release(textureID);
+        }
+        glDeleteTextures(1, &textureID);
+    }
+
+    // Checks whether a rectangle can sit on the skyline starting at the given node,
+    // and if so, how high up it would have to go.
+    bool AtlasPage::fit(size_t index, int width, int height, int& y) const
+    {
+        int x = skyline[index].x;
+        if(x + width > Size)
+        {
+            return false;
+        }
+
+        int remaining = width;
+        y = skyline[index].y;
+        while(remaining > 0)
+        {
+            if(index >= skyline.size())
+            {
+                return false;
+            }
+            y = std::max(y, skyline[index].y);
+            if(y + height > Size)
+            {
+                return false;
+            }
+            remaining -= skyline[index].width;
+            ++index;
+        }
+        return true;
+    }
+
+    bool AtlasPage::insert(int width, int height, int& x, int& y)
+    {
+        // Pick the spot where the rectangle's bottom edge ends up lowest, breaking ties on the narrowest node.
+        int bestBottom = INT_MAX;
+        int bestWidth = INT_MAX;
+        size_t bestIndex = skyline.size();
+        for(size_t i = 0; i < skyline.size(); ++i)
+        {
+            int top;
+            if(fit(i, width, height, top))
+            {
+                if(top + height < bestBottom || (top + height == bestBottom && skyline[i].width < bestWidth))
+                {
+                    bestBottom = top + height;
+                    bestWidth = skyline[i].width;
+                    bestIndex = i;
+                    x = skyline[i].x;
+                    y = top;
+                }
+            }
+        }
+        if(bestIndex == skyline.size())
+        {
+            return false;
+        }
+
+        Node node = { x, y + height, width };
+        skyline.insert(skyline.begin() + bestIndex, node);
+
+        // Cut back whatever the new node now covers.
+        for(size_t i = bestIndex + 1; i < skyline.size();)
+        {
+            const Node& previous(skyline[i - 1]);
+            Node& current(skyline[i]);
+            int overlap = previous.x + previous.width - current.x;
+            if(overlap <= 0)
+            {
+                break;
+            }
+            current.x += overlap;
+            current.width -= overlap;
+            if(current.width <= 0)
+            {
+                skyline.erase(skyline.begin() + i);
+            }
+            else
+            {
+                break;
+            }
+        }
+
+        // Join neighbours that ended up at the same height.
+        for(size_t i = 0; i + 1 < skyline.size();)
+        {
+            if(skyline[i].y == skyline[i + 1].y)
+            {
+                skyline[i].width += skyline[i + 1].width;
+                skyline.erase(skyline.begin() + i + 1);
+            }
+            else
+            {
+                ++i;
+            }
+        }
+        return true;
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef PLUM_GLFW_ATLAS_H
+#define PLUM_GLFW_ATLAS_H
+
+#include <memory>
+#include <vector>
+#include <GL/glfw3.h>
+
+namespace plum
+{
+    // One shared texture that many small images get packed into, so they can all be drawn
+    // without switching textures. Space is handed out with a skyline bottom-left packer.
+    // Images hold onto the page they live in, and the page goes away with the last of them.
+    class AtlasPage
+    {
+        public:
+            static const int Size = 1024;
+            // Images bigger than this in either direction get a texture of their own.
+            static const int MaxImageSize = 256;
+            // Empty border left to the right of and below each image, so neighbours never bleed into each other.
+            static const int Gutter = 1;
+
+            // Finds room for a width x height image, on an existing page or a new one.
+            // Returns nullptr if the image is too big to share a page.
+            static std::shared_ptr<AtlasPage> allocate(int width, int height, int& x, int& y);
+
+            AtlasPage();
+            ~AtlasPage();
+
+            GLuint getTextureID() const
+            {
+                return textureID;
+            }
+
+        private:
+            struct Node
+            {
+                int x, y, width;
+            };
+
+            GLuint textureID;
+            std::vector<Node> skyline;
+
+            bool insert(int width, int height, int& x, int& y);
+            bool fit(size_t index, int width, int height, int& y) const;
+
+            AtlasPage(const AtlasPage&);
+            void operator =(const AtlasPage&);
+    };
+}
+
+#endif
@@ -0,0 +1,184 @@
+#include <cmath>
+#include <cstddef>
+
+#include "batch.h"
+#include "extensions.h"
+#include "../../core/profile.h"
+
+namespace plum
+{
+    namespace
+    {
+        SpriteBatch* activeBatch = nullptr;
+        const size_t BufferCapacity = SpriteBatch::MaxQuads * 4;
+    }
+
+    SpriteBatch::SpriteBatch()
+        : depth(0), textureID(0), mode(BlendPreserve), bufferID(0), bufferOffset(0)
+    {
+        vertices.reserve(BufferCapacity);
+
+        if(gl::hasBufferObjects())
+        {
+            gl::genBuffers(1, &bufferID);
+            gl::bindBuffer(GL_ARRAY_BUFFER, bufferID);
+            gl::bufferData(GL_ARRAY_BUFFER, BufferCapacity * sizeof(Vertex), nullptr, GL_STREAM_DRAW);
+            gl::bindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+        activeBatch = this;
+    }
+
+    SpriteBatch::~SpriteBatch()
+    {
+        flush();
+        if(bufferID)
+        {
+            gl::deleteBuffers(1, &bufferID);
+        }
+        if(activeBatch == this)
+        {
+            activeBatch = nullptr;
+        }
+    }
+
+    SpriteBatch* SpriteBatch::current()
+    {
+        return activeBatch;
+    }
+
+    void SpriteBatch::begin()
+    {
+        ++depth;
+    }
+
+    void SpriteBatch::end()
+    {
+        if(depth > 0 && --depth == 0)
+        {
+            flush();
+        }
+    }
+
+    void SpriteBatch::setTexture(GLuint id)
+    {
+        if(id != textureID)
+        {
+            flush();
+            textureID = id;
+        }
+    }
+
+    void SpriteBatch::setBlendMode(BlendMode m)
+    {
+        if(m != mode)
+        {
+            flush();
+            mode = m;
+        }
+    }
+
+    void SpriteBatch::release(GLuint id)
+    {
+        if(id == textureID)
+        {
+            flush();
+            textureID = 0;
+        }
+    }
+
+    void SpriteBatch::add(double x, double y, double width, double height,
+        double pivotX, double pivotY, double scaleX, double scaleY, double angle,
+        double s, double t, double s2, double t2, Color tint)
+    {
+        if(vertices.size() + 4 > BufferCapacity)
+        {
+            flush();
+        }
+
+        const double corners[4][4] = {
+            { 0.0, 0.0, s, t },
+            { 0.0, height, s, t2 },
+            { width, height, s2, t2 },
+            { width, 0.0, s2, t },
+        };
+
+        // Same order as the old glTranslated/glScaled/glRotated/glTranslated stack,
+        // just done on the CPU so that every quad can share one draw call.
+        double radians = angle * M_PI / 180.0;
+        double cosine = cos(radians);
+        double sine = sin(radians);
+
+        uint8_t r, g, b, a;
+        tint.channels(r, g, b, a);
+
+        for(int i = 0; i < 4; ++i)
+        {
+            double px = corners[i][0] - pivotX;
+            double py = corners[i][1] - pivotY;
+            double rx = px * cosine - py * sine;
+            double ry = px * sine + py * cosine;
+
+            Vertex v;
+            v.x = GLfloat(x + rx * scaleX);
+            v.y = GLfloat(y + ry * scaleY);
+            v.s = GLfloat(corners[i][2]);
+            v.t = GLfloat(corners[i][3]);
+            v.r = r;
+            v.g = g;
+            v.b = b;
+            v.a = a;
+            vertices.push_back(v);
+        }
+    }
+
+    void SpriteBatch::flush()
+    {
+        if(vertices.empty())
+        {
+            return;
+        }
+        profile::Zone zone("SpriteBatch::flush");
+
+        const char* base = (const char*) vertices.data();
+        if(bufferID)
+        {
+            // Append to the streaming buffer. When it fills up, orphan the storage
+            // so the driver can hand back fresh memory instead of stalling on the last draw.
+            gl::bindBuffer(GL_ARRAY_BUFFER, bufferID);
+            if(bufferOffset + vertices.size() > BufferCapacity)
+            {
+                gl::bufferData(GL_ARRAY_BUFFER, BufferCapacity * sizeof(Vertex), nullptr, GL_STREAM_DRAW);
+                bufferOffset = 0;
+            }
+            gl::bufferSubData(GL_ARRAY_BUFFER, bufferOffset * sizeof(Vertex), vertices.size() * sizeof(Vertex), base);
+            profile::count(profile::CounterUploadBytes, vertices.size() * sizeof(Vertex));
+            base = (const char*) (bufferOffset * sizeof(Vertex));
+            bufferOffset += vertices.size();
+        }
+
+        glEnable(GL_TEXTURE_2D);
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        profile::count(profile::CounterTextureBinds);
+
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+        glEnableClientState(GL_COLOR_ARRAY);
+
+        glVertexPointer(2, GL_FLOAT, sizeof(Vertex), base + offsetof(Vertex, x));
+        glTexCoordPointer(2, GL_FLOAT, sizeof(Vertex), base + offsetof(Vertex, s));
+        glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Vertex), base + offsetof(Vertex, r));
+        glDrawArrays(GL_QUADS, 0, GLsizei(vertices.size()));
+        profile::count(profile::CounterDrawCalls);
+
+        glDisableClientState(GL_COLOR_ARRAY);
+        glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+        glDisableClientState(GL_VERTEX_ARRAY);
+
+        if(bufferID)
+        {
+            gl::bindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+
+        vertices.clear();
+    }
+}
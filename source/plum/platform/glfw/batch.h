@@ -0,0 +1,65 @@
+#ifndef PLUM_GLFW_BATCH_H
+#define PLUM_GLFW_BATCH_H
+
+#include <vector>
+#include <GL/glfw3.h>
+
+#include "../../core/color.h"
+#include "../../core/blending.h"
+
+namespace plum
+{
+    // Collects textured quads with pre-transformed vertices, and submits them
+    // in as few draw calls as possible. A flush happens when the texture or blend mode
+    // changes, when the outermost endBatch is reached, or when the screen is swapped.
+    class SpriteBatch
+    {
+        public:
+            struct Vertex
+            {
+                GLfloat x, y;
+                GLfloat s, t;
+                GLubyte r, g, b, a;
+            };
+
+            // Number of quads that can be queued before a flush is forced.
+            static const int MaxQuads = 2048;
+
+            SpriteBatch();
+            ~SpriteBatch();
+
+            // The batch belonging to the active screen, or nullptr if there is none.
+            static SpriteBatch* current();
+
+            void begin();
+            void end();
+            void flush();
+
+            void setTexture(GLuint textureID);
+            void setBlendMode(BlendMode mode);
+            // Flushes anything still waiting on this texture, before it gets modified or deleted.
+            void release(GLuint textureID);
+
+            // Queues a quad whose corners are (0, 0) - (width, height), rotated by angle degrees
+            // and scaled around the pivot, which is then placed at (x, y).
+            void add(double x, double y, double width, double height,
+                double pivotX, double pivotY, double scaleX, double scaleY, double angle,
+                double s, double t, double s2, double t2, Color tint);
+
+        private:
+            int depth;
+            GLuint textureID;
+            BlendMode mode;
+            std::vector<Vertex> vertices;
+
+            // Streaming vertex buffer. Zero if buffer objects aren't supported,
+            // in which case the vertices are sent as plain client-side arrays.
+            GLuint bufferID;
+            size_t bufferOffset;
+
+            SpriteBatch(const SpriteBatch&);
+            void operator =(const SpriteBatch&);
+    };
+}
+
+#endif
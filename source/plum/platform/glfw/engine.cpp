@@ -1,4 +1,5 @@
 #include <iostream>
+#include <algorithm>
 
 #include "engine.h"
 #include "../../core/log.h"
@@ -99,8 +100,15 @@ namespace plum
 
     void Engine::Impl::refresh()
     {
+        if(profile::active)
+        {
+            profile::record("Script", lastRefresh, profile::now());
+        }
+        profile::Zone zone("Engine::refresh");
+
         while(true)
         {
+            profile::Zone eventZone("Events");
             glfwPollEvents();
             if(events.size() == 0)
             {
@@ -127,15 +135,27 @@ namespace plum
             events.clear();
         }
 
-        auto& updateHooks(updateHooks);
-        for(auto it = updateHooks.begin(), end = updateHooks.end(); it != end; ++it)
+        // Hand over anything the loader threads have finished with.
         {
-            if(auto f = it->lock())
+            profile::Zone loaderZone("Loader::update");
+            loader->update();
+        }
+
+        {
+            profile::Zone hookZone("Update hooks");
+            auto& updateHooks(updateHooks);
+            for(auto it = updateHooks.begin(), end = updateHooks.end(); it != end; ++it)
             {
-                (*f)();
+                if(auto f = it->lock())
+                {
+                    (*f)();
+                }
             }
+            updateHooks.cleanup();
         }
-        updateHooks.cleanup();
+
+        profile::frame();
+        lastRefresh = profile::now();
     }
 
     Engine::Engine()
@@ -170,4 +190,21 @@ namespace plum
         impl->updateHooks.append(ptr);
         return ptr;
     }
+
+    void Engine::setWorkerThreads(int count, int threshold)
+    {
+        impl->workers.reset();
+        if(count > 0)
+        {
+            impl->workers = std::make_shared<WorkerPool>(count, threshold);
+        }
+    }
+
+    void Engine::setLoaderThreads(int count)
+    {
+        auto loader = std::make_shared<Loader>(std::max(count, 0));
+        // Jobs still waiting on the old loader carry over, rather than being dropped.
+        loader->adopt(*impl->loader);
+        impl->loader = loader;
+    }
 }
@@ -5,6 +5,9 @@
 #include <vector>
 
 #include "../../core/engine.h"
+#include "../../core/workers.h"
+#include "../../core/loader.h"
+#include "../../core/profile.h"
 
 namespace plum
 {
@@ -124,9 +127,15 @@ namespace plum
             WeakList<std::function<void()>> updateHooks;
             WeakList<WindowContext> windows;
             std::vector<Event> events;
+            std::shared_ptr<WorkerPool> workers;
+            std::shared_ptr<Loader> loader;
+            // When the last refresh returned to the script, so the time in between can be profiled as script time.
+            uint64_t lastRefresh;
 
             Impl()
+                : loader(new Loader(0)), lastRefresh(0)
             {
+                profile::setThreadName("Main");
                 if(!glfwInit())
                 {
                     quit("Couldn't initialize glfw.\n");
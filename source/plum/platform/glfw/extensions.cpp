@@ -0,0 +1,54 @@
+#include "extensions.h"
+
+namespace plum
+{
+    namespace gl
+    {
+        GenBuffersFunc genBuffers = nullptr;
+        DeleteBuffersFunc deleteBuffers = nullptr;
+        BindBufferFunc bindBuffer = nullptr;
+        BufferDataFunc bufferData = nullptr;
+        BufferSubDataFunc bufferSubData = nullptr;
+        MapBufferFunc mapBuffer = nullptr;
+        UnmapBufferFunc unmapBuffer = nullptr;
+
+        namespace
+        {
+            bool pixelBufferSupported = false;
+
+            // Try the core name first, then fall back on the ARB version of the same entry point.
+            template<typename T> T lookup(const char* name, const char* arbName)
+            {
+                auto f = glfwGetProcAddress(name);
+                if(!f)
+                {
+                    f = glfwGetProcAddress(arbName);
+                }
+                return (T) f;
+            }
+        }
+
+        void loadExtensions()
+        {
+            genBuffers = lookup<GenBuffersFunc>("glGenBuffers", "glGenBuffersARB");
+            deleteBuffers = lookup<DeleteBuffersFunc>("glDeleteBuffers", "glDeleteBuffersARB");
+            bindBuffer = lookup<BindBufferFunc>("glBindBuffer", "glBindBufferARB");
+            bufferData = lookup<BufferDataFunc>("glBufferData", "glBufferDataARB");
+            bufferSubData = lookup<BufferSubDataFunc>("glBufferSubData", "glBufferSubDataARB");
+            mapBuffer = lookup<MapBufferFunc>("glMapBuffer", "glMapBufferARB");
+            unmapBuffer = lookup<UnmapBufferFunc>("glUnmapBuffer", "glUnmapBufferARB");
+            pixelBufferSupported = glfwExtensionSupported("GL_ARB_pixel_buffer_object")
+                || glfwExtensionSupported("GL_EXT_pixel_buffer_object");
+        }
+
+        bool hasBufferObjects()
+        {
+            return genBuffers && deleteBuffers && bindBuffer && bufferData && bufferSubData;
+        }
+
+        bool hasPixelBuffers()
+        {
+            return hasBufferObjects() && mapBuffer && unmapBuffer && pixelBufferSupported;
+        }
+    }
+}
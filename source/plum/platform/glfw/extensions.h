@@ -0,0 +1,52 @@
+#ifndef PLUM_GLFW_EXTENSIONS_H
+#define PLUM_GLFW_EXTENSIONS_H
+
+#include <cstddef>
+#include <GL/glfw3.h>
+
+// opengl32.lib only exports OpenGL 1.1, so anything newer has to be fetched at runtime.
+#ifndef GL_ARRAY_BUFFER
+#define GL_ARRAY_BUFFER 0x8892
+#endif
+#ifndef GL_STREAM_DRAW
+#define GL_STREAM_DRAW 0x88E0
+#endif
+#ifndef GL_STATIC_DRAW
+#define GL_STATIC_DRAW 0x88E4
+#endif
+#ifndef GL_PIXEL_UNPACK_BUFFER
+#define GL_PIXEL_UNPACK_BUFFER 0x88EC
+#endif
+#ifndef GL_WRITE_ONLY
+#define GL_WRITE_ONLY 0x88B9
+#endif
+
+namespace plum
+{
+    namespace gl
+    {
+        typedef void (APIENTRY* GenBuffersFunc)(GLsizei n, GLuint* buffers);
+        typedef void (APIENTRY* DeleteBuffersFunc)(GLsizei n, const GLuint* buffers);
+        typedef void (APIENTRY* BindBufferFunc)(GLenum target, GLuint buffer);
+        typedef void (APIENTRY* BufferDataFunc)(GLenum target, ptrdiff_t size, const GLvoid* data, GLenum usage);
+        typedef void (APIENTRY* BufferSubDataFunc)(GLenum target, ptrdiff_t offset, ptrdiff_t size, const GLvoid* data);
+        typedef GLvoid* (APIENTRY* MapBufferFunc)(GLenum target, GLenum access);
+        typedef GLboolean (APIENTRY* UnmapBufferFunc)(GLenum target);
+
+        extern GenBuffersFunc genBuffers;
+        extern DeleteBuffersFunc deleteBuffers;
+        extern BindBufferFunc bindBuffer;
+        extern BufferDataFunc bufferData;
+        extern BufferSubDataFunc bufferSubData;
+        extern MapBufferFunc mapBuffer;
+        extern UnmapBufferFunc unmapBuffer;
+
+        // Needs a current context. Safe to call again after a context is recreated.
+        void loadExtensions();
+        bool hasBufferObjects();
+        // Whether buffers can be used as a source for texture uploads.
+        bool hasPixelBuffers();
+    }
+}
+
+#endif
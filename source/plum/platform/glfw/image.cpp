@@ -1,8 +1,13 @@
 #include <memory>
+#include <cstring>
 
 #include <GL/glfw3.h>
 
+#include "atlas.h"
+#include "batch.h"
+#include "extensions.h"
 #include "../../core/image.h"
+#include "../../core/profile.h"
 #include "../../core/transform.h"
 
 namespace plum
@@ -35,41 +40,173 @@ namespace plum
     {
         public:
             Impl(const Canvas& source)
-                : canvas(source.getWidth(), source.getHeight(), align(source.getWidth()), align(source.getHeight()))
+                : pixelBufferID(0), originX(0), originY(0)
             {
+                // Small images share a page with others, so that drawing them doesn't need a texture switch.
+                page = AtlasPage::allocate(source.getWidth(), source.getHeight(), originX, originY);
+                if(page)
+                {
+                    canvas = Canvas(source.getWidth(), source.getHeight());
+                    textureID = page->getTextureID();
+                    textureWidth = AtlasPage::Size;
+                    textureHeight = AtlasPage::Size;
+                }
+                else
+                {
+                    canvas = Canvas(source.getWidth(), source.getHeight(), align(source.getWidth()), align(source.getHeight()));
+                    glGenTextures(1, &textureID);
+                    textureWidth = canvas.getTrueWidth();
+                    textureHeight = canvas.getTrueHeight();
+                }
+
                 canvas.clear(0);
                 source.blit<BlendOpaque>(0, 0, canvas);
                 canvas.setClipRegion(0, 0, source.getWidth() - 1, source.getHeight() - 1);
 
-                glGenTextures(1, &textureID);
                 bind();
+                if(page)
+                {
+                    upload(0, 0, canvas.getWidth() - 1, canvas.getHeight() - 1);
+                }
+                else
+                {
+                    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+                    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+                    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+                    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+                    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8,
+                        canvas.getTrueWidth(), canvas.getTrueHeight(),
+                        0, GL_RGBA, GL_UNSIGNED_BYTE, canvas.getData());
+                    profile::count(profile::CounterUploadBytes, canvas.getTrueWidth() * canvas.getTrueHeight() * sizeof(Color));
+                }
+                canvas.setDirtyRegion(&dirty);
+            }
 
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8,
+            ~Impl()
+            {
+                // Shared pages clean up after themselves once the last image on them is gone.
+                if(!page)
+                {
+                    if(auto batch = SpriteBatch::current())
+                    {
+                        batch->release(textureID);
+                    }
+                    glDeleteTextures(1, &textureID);
+                }
+                if(pixelBufferID)
+                {
+                    gl::deleteBuffers(1, &pixelBufferID);
+                }
+            }
+
+            // Sends the whole canvas. When pixel buffers are available, the copy goes into driver memory
+            // and the texture upload happens from there, without the call having to wait on it.
+            void uploadAll()
+            {
+                if(page)
+                {
+                    upload(0, 0, canvas.getWidth() - 1, canvas.getHeight() - 1);
+                    return;
+                }
+
+                size_t size = canvas.getTrueWidth() * canvas.getTrueHeight() * sizeof(Color);
+                profile::count(profile::CounterUploadBytes, size);
+                if(gl::hasPixelBuffers())
+                {
+                    if(!pixelBufferID)
+                    {
+                        gl::genBuffers(1, &pixelBufferID);
+                    }
+                    gl::bindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBufferID);
+                    // Orphan the old storage, in case the last upload from it is still in flight.
+                    gl::bufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+                    if(auto pixels = gl::mapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY))
+                    {
+                        std::memcpy(pixels, canvas.getData(), size);
+                        if(gl::unmapBuffer(GL_PIXEL_UNPACK_BUFFER))
+                        {
+                            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0,
+                                canvas.getTrueWidth(), canvas.getTrueHeight(),
+                                GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+                            gl::bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+                            return;
+                        }
+                    }
+                    gl::bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+                }
+
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0,
                     canvas.getTrueWidth(), canvas.getTrueHeight(),
-                    0, GL_RGBA, GL_UNSIGNED_BYTE, canvas.getData());
+                    GL_RGBA, GL_UNSIGNED_BYTE, canvas.getData());
             }
 
-            ~Impl()
+            // Sends only the changed rectangles, straight out of the canvas memory.
+            void uploadAreas()
             {
-                glDeleteTextures(1, &textureID);
+                auto& areas(dirty.getAreas());
+                for(auto it = areas.begin(), end = areas.end(); it != end; ++it)
+                {
+                    upload(it->x, it->y, it->x2, it->y2);
+                }
             }
 
+            // Copies one rectangle of the canvas to where it lives in the texture.
+            void upload(int x, int y, int x2, int y2)
+            {
+                profile::count(profile::CounterUploadBytes, (x2 - x + 1) * (y2 - y + 1) * sizeof(Color));
+                glPixelStorei(GL_UNPACK_ROW_LENGTH, canvas.getTrueWidth());
+                glTexSubImage2D(GL_TEXTURE_2D, 0, originX + x, originY + y,
+                    x2 - x + 1, y2 - y + 1,
+                    GL_RGBA, GL_UNSIGNED_BYTE, canvas.getData() + y * canvas.getTrueWidth() + x);
+                glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+            }
 
             void bind()
             {
+                if(auto batch = SpriteBatch::current())
+                {
+                    batch->setTexture(textureID);
+                }
                 glEnable(GL_TEXTURE_2D);
                 glBindTexture(GL_TEXTURE_2D, textureID); 
+                profile::count(profile::CounterTextureBinds);
+            }
+
+            void mapTexture(double x, double y, double& s, double& t) const
+            {
+                s = (originX + x) / textureWidth;
+                t = (originY + y) / textureHeight;
+            }
+
+            void draw(double x, double y, double width, double height,
+                double pivotX, double pivotY, double scaleX, double scaleY, double angle,
+                double sourceX, double sourceY, double sourceX2, double sourceY2, Color tint)
+            {
+                if(auto batch = SpriteBatch::current())
+                {
+                    double s, t, s2, t2;
+                    mapTexture(sourceX, sourceY, s, t);
+                    mapTexture(sourceX2 + 1, sourceY2 + 1, s2, t2);
+                    batch->add(x, y, width, height, pivotX, pivotY, scaleX, scaleY, angle,
+                        s, t, s2, t2, tint);
+                }
             }
 
             // A backend software canvas that this image's raw texture copies.
             // Useful if the textures need to be refreshed later.
             Canvas canvas;
-            // The GL texture ID
+            // The GL texture ID. Belongs to the page if the image lives on one.
             unsigned int textureID;
+            // The parts of the canvas changed since the texture was last updated.
+            DirtyRegion dirty;
+            // Staging buffer for full uploads, created on first use.
+            GLuint pixelBufferID;
+
+            // The shared page holding this image, or nullptr if it has a texture to itself.
+            std::shared_ptr<AtlasPage> page;
+            // Where the canvas starts within the texture, and how big the texture is.
+            int originX, originY;
+            int textureWidth, textureHeight;
     };
 
     Image::Image(const Canvas& source)
@@ -93,10 +230,36 @@ namespace plum
 
     void Image::refresh()
     {
+        auto& dirty(impl->dirty);
+        if(dirty.empty())
+        {
+            return;
+        }
+        profile::Zone zone("Image::refresh");
+
+        // Anything already queued with this texture was drawn before the change.
+        if(auto batch = SpriteBatch::current())
+        {
+            batch->release(impl->textureID);
+        }
         bind();
-        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0,
-            impl->canvas.getTrueWidth(), impl->canvas.getTrueHeight(),
-            GL_RGBA, GL_UNSIGNED_BYTE, impl->canvas.getData());
+
+        // Once most of the texture has changed, one big upload beats several small ones.
+        int changed = 0;
+        auto& areas(dirty.getAreas());
+        for(auto it = areas.begin(), end = areas.end(); it != end; ++it)
+        {
+            changed += it->getSize();
+        }
+        if(changed * 2 >= impl->canvas.getTrueWidth() * impl->canvas.getTrueHeight())
+        {
+            impl->uploadAll();
+        }
+        else
+        {
+            impl->uploadAreas();
+        }
+        dirty.clear();
     }
 
     void Image::bind()
@@ -104,6 +267,11 @@ namespace plum
         impl->bind();
     }
 
+    void Image::mapTexture(double x, double y, double& s, double& t) const
+    {
+        impl->mapTexture(x, y, s, t);
+    }
+
     void Image::blit(int x, int y, BlendMode mode)
     {
         scaleBlitRegion(0, 0, impl->canvas.getWidth(), impl->canvas.getHeight(), x, y, impl->canvas.getWidth(), impl->canvas.getHeight(), mode);
@@ -124,6 +292,7 @@ namespace plum
     void Image::scaleBlitRegion(int sourceX, int sourceY, int sourceX2, int sourceY2,
                     int destX, int destY, int scaledWidth, int scaledHeight, BlendMode mode)
     {
+        profile::Zone zone("Image::scaleBlitRegion");
         if(sourceX > sourceX2)
         {
             std::swap(sourceX, sourceX2);
@@ -137,46 +306,10 @@ namespace plum
         sourceX2 = std::min(std::max(0, sourceX2), impl->canvas.getWidth() - 1);
         sourceY2 = std::min(std::max(0, sourceY2), impl->canvas.getHeight() - 1);
 
-        double regionS = (double(sourceX)) / impl->canvas.getTrueWidth();
-        double regionT = (double(sourceY)) / impl->canvas.getTrueHeight();
-        double regionS2 = (double(sourceX2) + 1) / impl->canvas.getTrueWidth();
-        double regionT2 = (double(sourceY2) + 1) / impl->canvas.getTrueHeight();
-
         useHardwareBlender(mode);
-        glColor4ub(255, 255, 255, getOpacity());
-
-        glPushMatrix();
         bind();
-
-        glTranslated(destX, destY, 0);
-
-
-        const GLdouble vertexArray[] = {
-            0.0, 0.0,
-            0.0, scaledHeight,
-            scaledWidth, scaledHeight,
-            scaledWidth, 0.0,
-        };
-
-        const GLdouble textureArray[] = {
-            regionS, regionT,
-            regionS, regionT2,
-            regionS2, regionT2,
-            regionS2, regionT,
-        };
-
-
-        glEnableClientState(GL_VERTEX_ARRAY);
-        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-
-        glVertexPointer(2, GL_DOUBLE, 0, vertexArray);
-        glTexCoordPointer(2, GL_DOUBLE, 0, textureArray);
-        glDrawArrays(GL_QUADS, 0, 4);
-        
-        glDisableClientState(GL_VERTEX_ARRAY);
-        glDisableClientState(GL_TEXTURE_COORD_ARRAY);
-
-        glPopMatrix();
+        impl->draw(destX, destY, scaledWidth, scaledHeight, 0.0, 0.0, 1.0, 1.0, 0.0,
+            sourceX, sourceY, sourceX2, sourceY2, Color(255, 255, 255, getOpacity()));
     }
 
     void Image::rotateBlit(int x, int y, double angle, BlendMode mode)
@@ -198,6 +331,7 @@ namespace plum
     void Image::rotateScaleBlitRegion(int sourceX, int sourceY, int sourceX2, int sourceY2,
                     int destX, int destY, double angle, double scale, BlendMode mode)
     {
+        profile::Zone zone("Image::rotateScaleBlitRegion");
         if(sourceX > sourceX2)
         {
             std::swap(sourceX, sourceX2);
@@ -211,49 +345,14 @@ namespace plum
         sourceX2 = std::min(std::max(0, sourceX2), impl->canvas.getWidth() - 1);
         sourceY2 = std::min(std::max(0, sourceY2), impl->canvas.getHeight() - 1);
 
-        double regionS = (double(sourceX)) / impl->canvas.getTrueWidth();
-        double regionT = (double(sourceY)) / impl->canvas.getTrueHeight();
-        double regionS2 = (double(sourceX2) + 1) / impl->canvas.getTrueWidth();
-        double regionT2 = (double(sourceY2) + 1) / impl->canvas.getTrueHeight();
-
         double width = double(sourceX2 - sourceX) * scale;
         double height = double(sourceY2 - sourceY) * scale;
 
         useHardwareBlender(mode);
-        glColor4ub(255, 255, 255, getOpacity());
-
-        glPushMatrix();
         bind();
-
-        glTranslated(destX + width / 2.0, destY + height / 2.0, 0.0);
-        glRotated(angle, 0.0, 0.0, 1.0);
-        glTranslated(-width / 2.0, -height / 2.0, 0.0);
-
-        const GLdouble vertexArray[] = {
-            0.0, 0.0,
-            0.0, height + 1.0,
-            width + 1.0, height + 1.0,
-            width + 1.0, 0.0,
-        };
-
-        const GLdouble textureArray[] = {
-            regionS, regionT,
-            regionS, regionT2,
-            regionS2, regionT2,
-            regionS2, regionT,
-        };
-
-        glEnableClientState(GL_VERTEX_ARRAY);
-        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-
-        glVertexPointer(2, GL_DOUBLE, 0, vertexArray);
-        glTexCoordPointer(2, GL_DOUBLE, 0, textureArray);
-        glDrawArrays(GL_QUADS, 0, 4);
-        
-        glDisableClientState(GL_VERTEX_ARRAY);
-        glDisableClientState(GL_TEXTURE_COORD_ARRAY);
-
-        glPopMatrix();
+        impl->draw(destX + width / 2.0, destY + height / 2.0, width + 1.0, height + 1.0,
+            width / 2.0, height / 2.0, 1.0, 1.0, angle,
+            sourceX, sourceY, sourceX2, sourceY2, Color(255, 255, 255, getOpacity()));
     }
 
     // For when performance really matters, bind the texture and figure out blend modes ahead of time,
@@ -267,44 +366,18 @@ namespace plum
         sourceX2 = std::min(std::max(0, sourceX2), impl->canvas.getWidth() - 1);
         sourceY2 = std::min(std::max(0, sourceY2), impl->canvas.getHeight() - 1);
 
-        double regionS = (double(sourceX)) / impl->canvas.getTrueWidth();
-        double regionT = (double(sourceY)) / impl->canvas.getTrueHeight();
-        double regionS2 = (double(sourceX2) + 1) / impl->canvas.getTrueWidth();
-        double regionT2 = (double(sourceY2) + 1) / impl->canvas.getTrueHeight();
-
         double width = double(sourceX2 - sourceX) * scale;
         double height = double(sourceY2 - sourceY) * scale;
 
-        glPushMatrix();
-
-        glTranslated(destX + width / 2.0, destY + height / 2.0, 0.0);
-        glRotated(angle, 0.0, 0.0, 1.0);
-        glTranslated(-width / 2.0, -height / 2.0, 0.0);
-
-        const GLdouble vertexArray[] = {
-            0.0, 0.0,
-            0.0, height + 1.0,
-            width + 1.0, height + 1.0,
-            width + 1.0, 0.0,
-        };
-
-        const GLdouble textureArray[] = {
-            regionS, regionT,
-            regionS, regionT2,
-            regionS2, regionT2,
-            regionS2, regionT,
-        };
-
-        glVertexPointer(2, GL_DOUBLE, 0, vertexArray);
-        glTexCoordPointer(2, GL_DOUBLE, 0, textureArray);
-        glDrawArrays(GL_QUADS, 0, 4);
-
-        glPopMatrix();
+        impl->draw(destX + width / 2.0, destY + height / 2.0, width + 1.0, height + 1.0,
+            width / 2.0, height / 2.0, 1.0, 1.0, angle,
+            sourceX, sourceY, sourceX2, sourceY2, Color(255, 255, 255, getOpacity()));
     }
 
     // Draws image, based on a transformation object (saves on complex arg passing)
     void Image::transformBlit(Transform* transform)
     {
+        profile::Zone zone("Image::transformBlit");
         double sourceX, sourceY, sourceX2, sourceY2;
         uint8_t r, g, b, a;
         transform->tint.channels(r, g, b, a);
@@ -323,49 +396,14 @@ namespace plum
             sourceY2 = impl->canvas.getHeight() - 1;
         }
 
-        double regionS = (double(sourceX)) / impl->canvas.getTrueWidth();
-        double regionT = (double(sourceY)) / impl->canvas.getTrueHeight();
-        double regionS2 = (double(sourceX2) + 1) / impl->canvas.getTrueWidth();
-        double regionT2 = (double(sourceY2) + 1) / impl->canvas.getTrueHeight();
-
         double width = double(sourceX2 - sourceX);
         double height = double(sourceY2 - sourceY);
 
         useHardwareBlender(transform->mode);
-        glColor4ub(r, g, b, a * getOpacity() / 255);
-
-        glPushMatrix();
         bind();
-
-        glTranslated(transform->position->x + transform->pivot->x, transform->position->y + transform->pivot->y, 0.0);
-        glScaled(transform->scale->x * (1 - transform->mirror * 2), transform->scale->y, 0.0);
-        glRotated(transform->angle, 0.0, 0.0, 1.0);
-        glTranslated(-transform->pivot->x, -transform->pivot->y, 0.0);
-
-        const GLdouble vertexArray[] = {
-            0.0, 0.0,
-            0.0, height + 1.0,
-            width + 1.0, height + 1.0,
-            width + 1.0, 0.0,
-        };
-
-        const GLdouble textureArray[] = {
-            regionS, regionT,
-            regionS, regionT2,
-            regionS2, regionT2,
-            regionS2, regionT,
-        };
-
-        glEnableClientState(GL_VERTEX_ARRAY);
-        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-
-        glVertexPointer(2, GL_DOUBLE, 0, vertexArray);
-        glTexCoordPointer(2, GL_DOUBLE, 0, textureArray);
-        glDrawArrays(GL_QUADS, 0, 4);
-        
-        glDisableClientState(GL_VERTEX_ARRAY);
-        glDisableClientState(GL_TEXTURE_COORD_ARRAY);
-
-        glPopMatrix();
+        impl->draw(transform->position->x + transform->pivot->x, transform->position->y + transform->pivot->y,
+            width + 1.0, height + 1.0, transform->pivot->x, transform->pivot->y,
+            transform->scale->x * (1 - transform->mirror * 2), transform->scale->y, transform->angle,
+            sourceX, sourceY, sourceX2, sourceY2, Color(r, g, b, a * getOpacity() / 255));
     }
 }
@@ -1,13 +1,27 @@
 #include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
 #include <GL/glfw3.h>
 
+#include "batch.h"
 #include "engine.h"
+#include "extensions.h"
+#include "../../core/log.h"
+#include "../../core/canvas.h"
 #include "../../core/screen.h"
+#include "../../core/profile.h"
 
 namespace plum
 {
     void useHardwareBlender(BlendMode mode)
     {
+        // Sprites queued up under the old mode need to go out before the state changes under them.
+        if(auto batch = SpriteBatch::current())
+        {
+            batch->setBlendMode(mode);
+        }
+
         switch(mode)
         {
             case BlendOpaque:
@@ -33,7 +47,7 @@ namespace plum
     {
         public:
             Impl(Engine& engine)
-                : engine(engine)
+                : engine(engine), dumpInterval(1), frame(0)
             {
                 hook = engine.addUpdateHook([this](){ update(); });
             }
@@ -44,18 +58,58 @@ namespace plum
 
             void update()
             {
+                profile::Zone zone("Screen::update");
+                flush();
+                if(!dumpPrefix.empty() && frame % dumpInterval == 0)
+                {
+                    dump();
+                }
+                ++frame;
+                profile::Zone swapZone("glfwSwapBuffers");
                 glfwSwapBuffers(context->window());
             }
 
+            // Reads back the finished frame at window size. GL rows start from the bottom, so it gets flipped.
+            void dump()
+            {
+                profile::Zone zone("Screen::dump");
+                Canvas canvas(trueWidth, trueHeight);
+                glPixelStorei(GL_PACK_ALIGNMENT, 1);
+                glReadPixels(0, 0, trueWidth, trueHeight, GL_RGBA, GL_UNSIGNED_BYTE, canvas.getData());
+                canvas.flip(false, true);
+
+                std::ostringstream filename;
+                filename << dumpPrefix << std::setw(6) << std::setfill('0') << frame << ".png";
+                if(!canvas.save(filename.str()))
+                {
+                    logFormat("Couldn't write frame dump '%s'.\n", filename.str().c_str());
+                }
+            }
+
+            // Called before any immediate-mode drawing, so it lands on top of the sprites queued before it.
+            void flush()
+            {
+                if(batch)
+                {
+                    batch->flush();
+                }
+            }
+
             Engine& engine;
             std::shared_ptr<Engine::UpdateHook> hook;
             std::shared_ptr<WindowContext> context;
+            // Declared after the context, so it gets released while the GL context is still alive.
+            std::shared_ptr<SpriteBatch> batch;
 
             bool windowed;
 
             int trueWidth, trueHeight;
             int width, height;
             int scale;
+
+            std::string dumpPrefix;
+            int dumpInterval;
+            unsigned int frame;
     };
 
     Screen::Screen(Engine& engine, int width, int height, int scale, bool win)
@@ -95,6 +149,9 @@ namespace plum
 
     void Screen::setResolution(int width, int height, int scale, bool win)
     {
+        // The batch's buffers belong to the old window's context.
+        impl->batch.reset();
+
         impl->windowed = win;
 
         impl->width = width;
@@ -139,20 +196,33 @@ namespace plum
         glfwSwapInterval(1);
         glfwShowWindow(window);
         impl->context = impl->engine.impl->registerWindow(window);
+
+        gl::loadExtensions();
+        impl->batch = std::make_shared<SpriteBatch>();
+    }
+
+    void Screen::setFrameDump(const std::string& prefix, int interval)
+    {
+        impl->dumpPrefix = prefix;
+        impl->dumpInterval = std::max(interval, 1);
     }
 
+    // Blits are always queued, but a batch keeps them queued across its whole body,
+    // so nested batches (a tilemap drawn inside a script's batch) don't cause a flush midway.
     void Screen::startBatch()
     {
-        glColor4ub(255, 255, 255, getOpacity());
-        glEnable(GL_TEXTURE_2D);
-        glEnableClientState(GL_VERTEX_ARRAY);
-        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+        if(impl->batch)
+        {
+            impl->batch->begin();
+        }
     }
 
     void Screen::endBatch()
     {
-        glDisableClientState(GL_VERTEX_ARRAY);
-        glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+        if(impl->batch)
+        {
+            impl->batch->end();
+        }
     }
 
     void Screen::clear(Color color)
@@ -163,6 +233,7 @@ namespace plum
                 g / 255.0f,
                 b / 255.0f,
                 a / 255.0f);
+        impl->flush();
         glClear(GL_COLOR_BUFFER_BIT);
         glMatrixMode(GL_MODELVIEW);
         glLoadIdentity();
@@ -179,6 +250,7 @@ namespace plum
         uint8_t r, g, b, a;
         color.channels(r, g, b, a);
 
+        impl->flush();
         useHardwareBlender(mode);
 
         const GLdouble vertexArray[] = { x, y, x2, y2 };
@@ -188,6 +260,7 @@ namespace plum
         glEnableClientState(GL_VERTEX_ARRAY);
         glVertexPointer(2, GL_DOUBLE, 0, vertexArray);
         glDrawArrays(GL_LINES, 0, 2);
+        profile::count(profile::CounterDrawCalls);
         glDisableClientState(GL_VERTEX_ARRAY);
     }
 
@@ -196,6 +269,7 @@ namespace plum
         uint8_t r, g, b, a;
         color.channels(r, g, b, a);
 
+        impl->flush();
         useHardwareBlender(mode);
 
         if(x > x2)
@@ -234,6 +308,7 @@ namespace plum
         glEnableClientState(GL_VERTEX_ARRAY);
         glVertexPointer(2, GL_DOUBLE, 0, vertexArray);
         glDrawArrays(GL_QUADS, 0, 16);
+        profile::count(profile::CounterDrawCalls);
         glDisableClientState(GL_VERTEX_ARRAY);
     }
 
@@ -242,6 +317,7 @@ namespace plum
         uint8_t r, g, b, a;
         color.channels(r, g, b, a);    
 
+        impl->flush();
         useHardwareBlender(mode);
 
         if(x > x2)
@@ -265,6 +341,7 @@ namespace plum
         glEnableClientState(GL_VERTEX_ARRAY);
         glVertexPointer(2, GL_DOUBLE, 0, vertexArray);
         glDrawArrays(GL_QUADS, 0, 4);
+        profile::count(profile::CounterDrawCalls);
         glDisableClientState(GL_VERTEX_ARRAY);
     }
 
@@ -275,6 +352,7 @@ namespace plum
         color.channels(r, g, b, a);
         color2.channels(r2, g2, b2, a2);
 
+        impl->flush();
         useHardwareBlender(mode);
 
         if(x > x2)
@@ -305,6 +383,7 @@ namespace plum
         glVertexPointer(2, GL_DOUBLE, 0, vertexArray);
         glColorPointer(4, GL_UNSIGNED_BYTE, 0, colorArray);
         glDrawArrays(GL_QUADS, 0, 4);
+        profile::count(profile::CounterDrawCalls);
         glDisableClientState(GL_COLOR_ARRAY);
         glDisableClientState(GL_VERTEX_ARRAY);
     }
@@ -316,6 +395,7 @@ namespace plum
         color.channels(r, g, b, a);
         color2.channels(r2, g2, b2, a2);
 
+        impl->flush();
         useHardwareBlender(mode);
 
         if(x > x2)
@@ -346,6 +426,7 @@ namespace plum
         glVertexPointer(2, GL_DOUBLE, 0, vertexArray);
         glColorPointer(4, GL_UNSIGNED_BYTE, 0, colorArray);
         glDrawArrays(GL_QUADS, 0, 4);
+        profile::count(profile::CounterDrawCalls);
         glDisableClientState(GL_COLOR_ARRAY);
         glDisableClientState(GL_VERTEX_ARRAY);
     }
@@ -355,6 +436,7 @@ namespace plum
         uint8_t r, g, b, a;
         color.channels(r, g, b, a);
 
+        impl->flush();
         useHardwareBlender(mode);
 
         double px = x;
@@ -375,6 +457,7 @@ namespace plum
         glEnableClientState(GL_VERTEX_ARRAY);
         glVertexPointer(2, GL_DOUBLE, 0, vertexArray);
         glDrawArrays(GL_LINE_LOOP, 0, 360);
+        profile::count(profile::CounterDrawCalls);
         glDisableClientState(GL_VERTEX_ARRAY);
     }
 
@@ -383,6 +466,7 @@ namespace plum
         uint8_t r, g, b, a;
         color.channels(r, g, b, a);
 
+        impl->flush();
         useHardwareBlender(mode);
 
         double px = x;
@@ -403,6 +487,7 @@ namespace plum
         glEnableClientState(GL_VERTEX_ARRAY);
         glVertexPointer(2, GL_DOUBLE, 0, vertexArray);
         glDrawArrays(GL_TRIANGLE_FAN, 0, 360);
+        profile::count(profile::CounterDrawCalls);
         glDisableClientState(GL_VERTEX_ARRAY);
     }
 }
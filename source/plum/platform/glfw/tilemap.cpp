@@ -0,0 +1,242 @@
+#include <algorithm>
+#include <GL/glfw3.h>
+
+#include "batch.h"
+#include "extensions.h"
+#include "../../core/screen.h"
+#include "../../core/sprite.h"
+#include "../../core/canvas.h"
+#include "../../core/tilemap.h"
+#include "../../core/profile.h"
+
+namespace plum
+{
+    // Keeps one vertex buffer per chunk of the map, so that drawing a layer is a handful
+    // of draw calls, and only chunks touched since the last draw have to be rebuilt.
+    class Tilemap::Cache
+    {
+        public:
+            struct Vertex
+            {
+                GLfloat x, y;
+                GLfloat s, t;
+            };
+
+            struct Chunk
+            {
+                GLuint bufferID;
+                GLsizei count;
+                // Only used when buffer objects aren't supported.
+                std::vector<Vertex> vertices;
+            };
+
+            Cache(int chunkCount)
+                : chunks(chunkCount), frameWidth(0), frameHeight(0), padding(0), columns(0)
+            {
+                for(auto it = chunks.begin(), end = chunks.end(); it != end; ++it)
+                {
+                    it->bufferID = 0;
+                    it->count = 0;
+                    if(gl::hasBufferObjects())
+                    {
+                        gl::genBuffers(1, &it->bufferID);
+                    }
+                }
+            }
+
+            ~Cache()
+            {
+                for(auto it = chunks.begin(), end = chunks.end(); it != end; ++it)
+                {
+                    if(it->bufferID)
+                    {
+                        gl::deleteBuffers(1, &it->bufferID);
+                    }
+                }
+            }
+
+            // Returns true if the sprite's frame layout doesn't match what the chunks were built with.
+            bool changed(Sprite& spr) const
+            {
+                return image != spr.image().impl
+                    || frameWidth != spr.getFrameWidth()
+                    || frameHeight != spr.getFrameHeight()
+                    || padding != spr.getPadding()
+                    || columns != spr.getColumns();
+            }
+
+            void reset(Sprite& spr)
+            {
+                image = spr.image().impl;
+                frameWidth = spr.getFrameWidth();
+                frameHeight = spr.getFrameHeight();
+                padding = spr.getPadding();
+                columns = spr.getColumns();
+            }
+
+            std::vector<Chunk> chunks;
+            std::vector<Vertex> scratch;
+
+            std::shared_ptr<Image::Impl> image;
+            int frameWidth, frameHeight;
+            int padding;
+            int columns;
+
+        private:
+            Cache(const Cache&);
+            void operator =(const Cache&);
+    };
+
+    void Tilemap::blit(Screen& screen, Sprite& spr, int worldX, int worldY, int destX, int destY, int tilesWide, int tilesHigh, BlendMode mode)
+    {
+        if(tilesWide < 0 || tilesHigh < 0 || !spr.getColumns()) return;
+        profile::Zone zone("Tilemap::blit");
+
+        int frameWidth = spr.getFrameWidth();
+        int frameHeight = spr.getFrameHeight();
+        int xofs = -(worldX % frameWidth);
+        int yofs = -(worldY % frameHeight);
+        int tileX = worldX / frameWidth;
+        int tileY = worldY / frameHeight;
+
+        // Clip the tile region to make sure things don't crash.
+        if(tileX < 0)
+        {
+            tileX = 0;
+        }
+        if(tileY < 0)
+        {
+            tileY = 0;
+        }
+        if(tileX + tilesWide > width)
+        {
+            tilesWide = width - tileX;
+        }
+        if(tileY + tilesHigh > height)
+        {
+            tilesHigh = height - tileY;
+        }
+        if(tilesWide <= 0 || tilesHigh <= 0) return;
+
+        if(!cache)
+        {
+            cache = std::make_shared<Cache>(chunksWide * chunksHigh);
+        }
+        if(cache->changed(spr))
+        {
+            cache->reset(spr);
+            dirty.assign(dirty.size(), true);
+        }
+
+        const Image& image(spr.image());
+        const Canvas& canvas(image.canvas());
+
+        screen.startBatch();
+        spr.bind();
+        useHardwareBlender(mode);
+
+        // The chunks skip the sprite batch, so anything queued before this needs to go first.
+        if(auto batch = SpriteBatch::current())
+        {
+            batch->flush();
+        }
+
+        // Tiles are only drawn inside the requested window, even though whole chunks get submitted.
+        double scaleX = double(screen.getTrueWidth()) / screen.getWidth();
+        double scaleY = double(screen.getTrueHeight()) / screen.getHeight();
+        int left = destX + xofs;
+        int top = destY + yofs;
+        glScissor(GLint(left * scaleX), GLint(screen.getTrueHeight() - (top + tilesHigh * frameHeight) * scaleY),
+            GLsizei(tilesWide * frameWidth * scaleX), GLsizei(tilesHigh * frameHeight * scaleY));
+
+        glColor4ub(255, 255, 255, getOpacity());
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+
+        glPushMatrix();
+        glTranslated(left - tileX * frameWidth, top - tileY * frameHeight, 0.0);
+
+        int chunkX = tileX / ChunkSize;
+        int chunkY = tileY / ChunkSize;
+        int chunkX2 = (tileX + tilesWide - 1) / ChunkSize;
+        int chunkY2 = (tileY + tilesHigh - 1) / ChunkSize;
+        for(int cy = chunkY; cy <= chunkY2; ++cy)
+        {
+            for(int cx = chunkX; cx <= chunkX2; ++cx)
+            {
+                int index = cy * chunksWide + cx;
+                auto& chunk(cache->chunks[index]);
+
+                if(dirty[index])
+                {
+                    // Same quads that rawBlitFrame would produce for each tile, just built in map space.
+                    auto& vertices(chunk.bufferID ? cache->scratch : chunk.vertices);
+                    vertices.clear();
+
+                    int tx2 = std::min((cx + 1) * ChunkSize, width);
+                    int ty2 = std::min((cy + 1) * ChunkSize, height);
+                    for(int ty = cy * ChunkSize; ty < ty2; ++ty)
+                    {
+                        for(int tx = cx * ChunkSize; tx < tx2; ++tx)
+                        {
+                            int sx, sy, sx2, sy2;
+                            spr.getFrameRegion(data[ty * width + tx], sx, sy, sx2, sy2);
+                            sx = std::min(std::max(0, sx), canvas.getWidth() - 1);
+                            sy = std::min(std::max(0, sy), canvas.getHeight() - 1);
+                            sx2 = std::min(std::max(0, sx2), canvas.getWidth() - 1);
+                            sy2 = std::min(std::max(0, sy2), canvas.getHeight() - 1);
+
+                            GLfloat x = GLfloat(tx * frameWidth);
+                            GLfloat y = GLfloat(ty * frameHeight);
+                            GLfloat x2 = x + GLfloat(sx2 - sx + 1);
+                            GLfloat y2 = y + GLfloat(sy2 - sy + 1);
+                            double s, t, s2, t2;
+                            image.mapTexture(sx, sy, s, t);
+                            image.mapTexture(sx2 + 1, sy2 + 1, s2, t2);
+
+                            const Cache::Vertex quad[] = {
+                                { x, y, GLfloat(s), GLfloat(t) },
+                                { x, y2, GLfloat(s), GLfloat(t2) },
+                                { x2, y2, GLfloat(s2), GLfloat(t2) },
+                                { x2, y, GLfloat(s2), GLfloat(t) },
+                            };
+                            vertices.insert(vertices.end(), quad, quad + 4);
+                        }
+                    }
+                    chunk.count = GLsizei(vertices.size());
+
+                    if(chunk.bufferID)
+                    {
+                        gl::bindBuffer(GL_ARRAY_BUFFER, chunk.bufferID);
+                        gl::bufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Cache::Vertex), vertices.data(), GL_STATIC_DRAW);
+                        profile::count(profile::CounterUploadBytes, vertices.size() * sizeof(Cache::Vertex));
+                    }
+                    dirty[index] = false;
+                }
+
+                const char* base = (const char*) chunk.vertices.data();
+                if(chunk.bufferID)
+                {
+                    gl::bindBuffer(GL_ARRAY_BUFFER, chunk.bufferID);
+                    base = nullptr;
+                }
+                glVertexPointer(2, GL_FLOAT, sizeof(Cache::Vertex), base + offsetof(Cache::Vertex, x));
+                glTexCoordPointer(2, GL_FLOAT, sizeof(Cache::Vertex), base + offsetof(Cache::Vertex, s));
+                glDrawArrays(GL_QUADS, 0, chunk.count);
+                profile::count(profile::CounterDrawCalls);
+            }
+        }
+
+        if(gl::hasBufferObjects())
+        {
+            gl::bindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+
+        glPopMatrix();
+        glDisableClientState(GL_VERTEX_ARRAY);
+        glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+        glScissor(0, 0, screen.getTrueWidth(), screen.getTrueHeight());
+
+        screen.endBatch();
+    }
+}
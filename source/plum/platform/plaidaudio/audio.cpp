@@ -1,16 +1,20 @@
+#include <list>
+#include <cmath>
+#include <algorithm>
 #include <iostream>
+#include <unordered_map>
 #include <unordered_set>
 #include <functional>
 #include <plaid/audio.h>
 #include <plaid/audio/effects.h>
+#include <plaid/audio/implementation.h>
 
 #include "../../core/file.h"
 #include "../../core/audio.h"
 #include "../../core/engine.h"
-
-namespace
-{
-}
+#include "../../core/log.h"
+#include "../../core/profile.h"
+#include "prefetch.h"
 
 namespace plum
 {
@@ -22,12 +26,29 @@ namespace plum
             plaidgadget::Ref<plaidgadget::Pan> panfx;
             plaidgadget::Ref<plaidgadget::Pitch> pitchfx;
 
+            std::weak_ptr<Audio::Impl> owner;
+            std::shared_ptr<Sound::Impl> sound;
+            // Only set when playing a cached clip, which can be restarted at any point.
+            plaidgadget::Ref<plaidgadget::AudioClip> clip;
+            double duration;
+
             std::shared_ptr<bool> dispose;
             bool looped;
             double pan, pitch, volume;
 
+            // When the channel last started from the top, compared to other channels.
+            unsigned int serial;
+            // Seconds into the sound, kept whether or not it's being mixed.
+            double position;
+            // Stolen, so keeping time without being mixed.
+            bool virtualized;
+            // Stopped or stolen for good. The mixer still reports it as playing until it lets go of it.
+            bool stopped;
+            bool paused;
+
             Impl()
-                : audio(nullptr), master(nullptr), panfx(nullptr), pitchfx(nullptr), looped(false), pan(0.0), pitch(1.0), volume(1.0)
+                : audio(nullptr), master(nullptr), panfx(nullptr), pitchfx(nullptr), duration(0.0), looped(false), pan(0.0), pitch(1.0), volume(1.0),
+                serial(0), position(0.0), virtualized(false), stopped(false), paused(false)
             {
             }
 
@@ -46,39 +67,6 @@ namespace plum
         }
     }
 
-    void Channel::play()
-    {
-        if(impl->master)
-        {
-            impl->audio->play(impl->master);
-        }
-    }
-
-    void Channel::pause()
-    {
-        if(impl->master)
-        {
-            impl->audio->pause(impl->master);
-        }
-    }
-
-    void Channel::stop()
-    {
-        if(impl->master)
-        {
-            impl->audio->stop(impl->master);
-        }
-    }
-
-    bool Channel::isPlaying() const
-    {
-        if(impl->master)
-        {
-            return impl->audio->playing(impl->master);
-        }
-        return false;
-    }
-
     bool Channel::isLooped() const
     {
         return impl->looped;
@@ -119,8 +107,15 @@ namespace plum
     class Sound::Impl
     {
         public:
+            Impl()
+                : looped(false), priority(0), maxInstances(0)
+            {
+            }
+
             plaidgadget::String filename;
             bool looped;
+            int priority;
+            int maxInstances;
     };
 
     Sound::Sound()
@@ -132,6 +127,26 @@ namespace plum
     {
     }
 
+    int Sound::getPriority() const
+    {
+        return impl->priority;
+    }
+
+    void Sound::setPriority(int value)
+    {
+        impl->priority = value;
+    }
+
+    int Sound::getMaxInstances() const
+    {
+        return impl->maxInstances;
+    }
+
+    void Sound::setMaxInstances(int value)
+    {
+        impl->maxInstances = std::max(value, 0);
+    }
+
     namespace
     {
         // VS2010 doesn't supply std::hash<std::shared_ptr<T>>.
@@ -144,13 +159,69 @@ namespace plum
         };
     }
 
+    namespace
+    {
+        const size_t DefaultCacheBudget = 32 * 1024 * 1024;
+        const size_t DefaultCacheThreshold = 2 * 1024 * 1024;
+        const int DefaultPrefetchMilliseconds = 250;
+        const int DefaultVoiceLimit = 32;
+
+        // Hands plaidaudio's codecs the files that are sitting in a mounted archive.
+        class ArchivedFile : public plaidgadget::AudioFile
+        {
+            public:
+                ArchivedFile(File* file)
+                    : file(file)
+                {
+                }
+
+                virtual const void* data()
+                {
+                    return file->getData();
+                }
+
+                virtual plaidgadget::Uint32 size()
+                {
+                    return plaidgadget::Uint32(file->getSize());
+                }
+
+            private:
+                std::unique_ptr<File> file;
+        };
+
+        plaidgadget::AudioFile* openArchived(const plaidgadget::String& filename)
+        {
+            std::unique_ptr<File> file(new File(plaidgadget::ToStdString(filename), FileRead));
+            if(!file->getData())
+            {
+                // Not in memory, so the codec can read it off the disk itself.
+                return nullptr;
+            }
+            return new ArchivedFile(file.release());
+        }
+    }
+
     class Audio::Impl
     {
         public:
+            struct CachedClip
+            {
+                plaidgadget::Ref<plaidgadget::AudioClip> clip;
+                size_t size;
+                double seconds;
+                std::list<plaidgadget::String>::iterator position;
+            };
+
             Impl(Engine& engine, bool disabled)
                 : engine(engine), disabled(disabled), pan(0.0), pitch(1.0), volume(1.0),
-                audio(new plaidgadget::Audio(disabled))
+                audio(new plaidgadget::Audio(disabled)),
+                cacheBudget(DefaultCacheBudget), cacheThreshold(DefaultCacheThreshold), cacheUsage(0),
+                prefetcher(new Prefetcher(audio, 0, DefaultPrefetchMilliseconds)),
+                voiceLimit(DefaultVoiceLimit), voiceSteal(StealLowestPriority), serial(0), lastTime(0.0), activeVoices(0), virtualVoices(0),
+                statsInterval(0.0), nextStatsLog(0.0)
             {
+                plaidgadget::AudioCodec::SetOpener(openArchived);
+                lastTime = audio->time();
                 hook = engine.addUpdateHook([this](){ update(); });
             }
 
@@ -164,7 +235,14 @@ namespace plum
                 {
                     return;
                 }
+                profile::Zone zone("Audio::update");
 
+                double now = audio->time();
+                double elapsed = std::max(now - lastTime, 0.0);
+                lastTime = now;
+
+                activeVoices = 0;
+                virtualVoices = 0;
                 for(auto it = channels.begin(), end = channels.end(); it != end;)
                 {
                     const auto& c(*it);
@@ -173,17 +251,321 @@ namespace plum
                     // TODO: panning
                     c->panfx->level(float(c->volume * volume));
 
-                    if((!audio->playing(c->master) || c->looped) && *c->dispose)
+                    bool mixing = isMixing(*c);
+                    if(mixing || (c->virtualized && !c->paused))
+                    {
+                        c->position += elapsed * c->pitch * pitch;
+                        if(c->looped && c->duration > 0.0)
+                        {
+                            c->position = fmod(c->position, c->duration);
+                        }
+                        else if(c->virtualized && c->position >= c->duration)
+                        {
+                            // Ran out while nobody was listening.
+                            c->virtualized = false;
+                        }
+                    }
+
+                    if(((!mixing && !c->virtualized) || c->looped) && *c->dispose)
                     {
                         it = channels.erase(it);
                     }
                     else
                     {
+                        activeVoices += mixing;
+                        virtualVoices += c->virtualized;
                         ++it;
                     }
                 }
+                rebalance();
 
                 audio->update();
+                prefetcher->update();
+
+                if(statsInterval > 0.0 && now >= nextStatsLog)
+                {
+                    logStats();
+                    nextStatsLog = now + statsInterval;
+                }
+            }
+
+            AudioStats stats() const
+            {
+                auto s = audio->stats();
+                AudioStats result;
+                result.callbacks = s.callbacks;
+                std::copy(s.histogram, s.histogram + AudioStats::HistogramSize, result.callbackHistogram);
+                result.callbackAverage = s.average;
+                result.callbackLongest = s.longest;
+                result.load = s.load;
+                result.underflows = s.underflows;
+                result.overflows = s.overflows;
+                result.lostReports = s.lost;
+                result.mixedVoices = int(s.voices);
+                result.peakVoices = int(s.peakVoices);
+                result.activeVoices = activeVoices;
+                result.virtualVoices = virtualVoices;
+                result.pullAverage = s.pullAverage;
+                result.pullLongest = s.pullLongest;
+                result.scratchSize = s.scratchSize;
+                result.scratchPeak = s.scratchPeak;
+                result.scratchDenied = s.scratchDenied;
+                result.streamUnderruns = prefetcher->getUnderruns();
+                return result;
+            }
+
+            void logStats() const
+            {
+                auto s = stats();
+                logFormat("audio: %u callbacks, %.2f ms average, %.2f ms longest, %.0f%% load, %u underflows, %u overflows, %u lost reports\n",
+                    s.callbacks, s.callbackAverage * 1000.0, s.callbackLongest * 1000.0, s.load * 100.0, s.underflows, s.overflows, s.lostReports);
+                logFormat("audio: %d voices mixed (peak %d), %d active, %d virtual, %.1f us average pull, %.1f us longest pull\n",
+                    s.mixedVoices, s.peakVoices, s.activeVoices, s.virtualVoices, s.pullAverage * 1000000.0, s.pullLongest * 1000000.0);
+                logFormat("audio: scratch %u of %u samples at peak, %u denied, %u stream underruns\n",
+                    s.scratchPeak, s.scratchSize, s.scratchDenied, s.streamUnderruns);
+            }
+
+            bool isMixing(const Channel::Impl& c) const
+            {
+                return !c.virtualized && !c.stopped && c.master && audio->playing(c.master);
+            }
+
+            // Whether a deserves to keep its voice over b, going by the steal policy.
+            // Streams can't come back once stolen, so they're only given up when there's nothing else to take.
+            bool outranks(const Channel::Impl& a, const Channel::Impl& b) const
+            {
+                if(a.clip.null() != b.clip.null())
+                {
+                    return a.clip.null();
+                }
+                if(voiceSteal == StealLowestPriority && a.sound->priority != b.sound->priority)
+                {
+                    return a.sound->priority > b.sound->priority;
+                }
+                if(voiceSteal == StealQuietest && a.volume != b.volume)
+                {
+                    return a.volume > b.volume;
+                }
+                return a.serial > b.serial;
+            }
+
+            // Builds the effect chain that sits between a channel's stream and the mixer.
+            void attach(Channel::Impl& c, plaidgadget::Sound stream)
+            {
+                c.pitchfx = plaidgadget::Ref<plaidgadget::Pitch>(new plaidgadget::Pitch(stream));
+                c.panfx = plaidgadget::Ref<plaidgadget::Pan>(new plaidgadget::Pan(plaidgadget::Sound(c.pitchfx)));
+                c.master = plaidgadget::Sound(c.panfx);
+                c.pitchfx->rate(float(c.pitch * pitch));
+                c.panfx->level(float(c.volume * volume));
+            }
+
+            // Takes a channel out of the mix. Clips go virtual, but streams can't be picked up again, so they stop.
+            void steal(Channel::Impl& c)
+            {
+                audio->stop(c.master);
+                if(!c.clip.null())
+                {
+                    c.virtualized = true;
+                    c.paused = false;
+                    ++virtualVoices;
+                }
+                else
+                {
+                    c.stopped = true;
+                }
+            }
+
+            // Puts a virtual channel back in the mix, at wherever it would have got to.
+            void revive(Channel::Impl& c)
+            {
+                auto start = plaidgadget::Uint32(c.position * audio->format().rate);
+                attach(c, plaidgadget::Sound(c.clip->player(c.looped, start)));
+                c.virtualized = false;
+                c.stopped = false;
+                audio->play(c.master);
+            }
+
+            // Plays a channel, stealing a voice if the limit has been reached.
+            void start(const std::shared_ptr<Channel::Impl>& channel)
+            {
+                if(!channel->master || audio->playing(channel->master))
+                {
+                    return;
+                }
+                if(channel->virtualized)
+                {
+                    channel->paused = false;
+                    return;
+                }
+
+                // Unpausing doesn't count as a new instance.
+                if(!audio->has(channel->master))
+                {
+                    channel->serial = ++serial;
+                    for(int limit = channel->sound->maxInstances; limit > 0;)
+                    {
+                        int count = 0;
+                        Channel::Impl* oldest = nullptr;
+                        for(auto it = channels.begin(), end = channels.end(); it != end; ++it)
+                        {
+                            auto& c(**it);
+                            if(&c != channel.get() && c.sound == channel->sound && (isMixing(c) || c.virtualized))
+                            {
+                                ++count;
+                                if(!oldest || c.serial < oldest->serial)
+                                {
+                                    oldest = &c;
+                                }
+                            }
+                        }
+                        if(count < limit || !oldest)
+                        {
+                            break;
+                        }
+                        audio->stop(oldest->master);
+                        oldest->virtualized = false;
+                        oldest->stopped = true;
+                    }
+                }
+
+                if(voiceLimit > 0)
+                {
+                    int count = 0;
+                    Channel::Impl* victim = nullptr;
+                    for(auto it = channels.begin(), end = channels.end(); it != end; ++it)
+                    {
+                        auto& c(**it);
+                        if(&c != channel.get() && isMixing(c))
+                        {
+                            ++count;
+                            if(!victim || outranks(*victim, c))
+                            {
+                                victim = &c;
+                            }
+                        }
+                    }
+                    if(count >= voiceLimit && victim)
+                    {
+                        if(outranks(*victim, *channel))
+                        {
+                            // Everything playing matters more, so the new one is what gets stolen.
+                            steal(*channel);
+                            return;
+                        }
+                        steal(*victim);
+                    }
+                }
+                channel->stopped = false;
+                audio->play(channel->master);
+            }
+
+            // Steals voices while over the limit, and brings virtual voices back while under it.
+            void rebalance()
+            {
+                while(voiceLimit > 0 && activeVoices > voiceLimit)
+                {
+                    Channel::Impl* victim = nullptr;
+                    for(auto it = channels.begin(), end = channels.end(); it != end; ++it)
+                    {
+                        if(isMixing(**it) && (!victim || outranks(*victim, **it)))
+                        {
+                            victim = it->get();
+                        }
+                    }
+                    if(!victim)
+                    {
+                        break;
+                    }
+                    steal(*victim);
+                    --activeVoices;
+                }
+
+                while(virtualVoices > 0 && (voiceLimit <= 0 || activeVoices < voiceLimit))
+                {
+                    Channel::Impl* best = nullptr;
+                    for(auto it = channels.begin(), end = channels.end(); it != end; ++it)
+                    {
+                        if((*it)->virtualized && !(*it)->paused && (!best || outranks(**it, *best)))
+                        {
+                            best = it->get();
+                        }
+                    }
+                    if(!best)
+                    {
+                        break;
+                    }
+                    revive(*best);
+                    --virtualVoices;
+                    ++activeVoices;
+                }
+            }
+
+            // Returns the decoded clip for a file, decoding it first if it's small enough to keep around.
+            // Returns a null ref when the sound should be streamed instead.
+            plaidgadget::Ref<plaidgadget::AudioClip> fetchClip(const plaidgadget::String& filename, double* duration = nullptr)
+            {
+                auto found = clips.find(filename);
+                if(found != clips.end())
+                {
+                    recent.splice(recent.begin(), recent, found->second.position);
+                    if(duration)
+                    {
+                        *duration = found->second.seconds;
+                    }
+                    return found->second.clip;
+                }
+                if(!cacheBudget || !cacheThreshold || streamed.find(filename) != streamed.end())
+                {
+                    return plaidgadget::Ref<plaidgadget::AudioClip>();
+                }
+
+                plaidgadget::Sound source(audio->stream(filename, false));
+                if(source.null())
+                {
+                    return plaidgadget::Ref<plaidgadget::AudioClip>();
+                }
+
+                // Clips store every sample in 32 bits, regardless of the sample type.
+                auto format = audio->format();
+                size_t bytesPerSecond = format.rate * format.channels * sizeof(plaidgadget::Sint32);
+                float limit = float(std::min(cacheThreshold, cacheBudget)) / bytesPerSecond;
+
+                plaidgadget::Ref<plaidgadget::AudioClip> clip(new plaidgadget::AudioClip(format, plaidgadget::AudioClip::INT24));
+                float seconds = clip->load(*audio, source, limit);
+                if(seconds <= 0.0f || seconds >= limit)
+                {
+                    // Too long (or broken), so remember not to bother decoding it again.
+                    streamed.insert(filename);
+                    return plaidgadget::Ref<plaidgadget::AudioClip>();
+                }
+
+                recent.push_front(filename);
+                CachedClip& entry(clips[filename]);
+                entry.clip = clip;
+                entry.size = size_t(seconds * bytesPerSecond);
+                entry.seconds = seconds;
+                entry.position = recent.begin();
+                cacheUsage += entry.size;
+                if(duration)
+                {
+                    *duration = seconds;
+                }
+
+                evict(cacheBudget);
+                return clip;
+            }
+
+            // Drops least recently used clips until the cache fits in the given size.
+            // Channels still playing a dropped clip hold onto it until they finish.
+            void evict(size_t size)
+            {
+                while(cacheUsage > size && !recent.empty())
+                {
+                    auto it = clips.find(recent.back());
+                    cacheUsage -= it->second.size;
+                    clips.erase(it);
+                    recent.pop_back();
+                }
             }
 
             Engine& engine;
@@ -194,8 +576,76 @@ namespace plum
 
             std::shared_ptr<plaidgadget::Audio> audio;
             std::unordered_set<std::shared_ptr<Channel::Impl>, hash<Channel::Impl>> channels;
+
+            size_t cacheBudget;
+            size_t cacheThreshold;
+            size_t cacheUsage;
+            std::unordered_map<plaidgadget::String, CachedClip> clips;
+            // Most recently played first.
+            std::list<plaidgadget::String> recent;
+            std::unordered_set<plaidgadget::String> streamed;
+
+            std::shared_ptr<Prefetcher> prefetcher;
+
+            int voiceLimit;
+            VoiceSteal voiceSteal;
+            unsigned int serial;
+            // Audio clock at the last update, for advancing positions.
+            double lastTime;
+            int activeVoices;
+            int virtualVoices;
+
+            double statsInterval;
+            double nextStatsLog;
     };
 
+    void Channel::play()
+    {
+        if(auto owner = impl->owner.lock())
+        {
+            owner->start(impl);
+        }
+    }
+
+    void Channel::pause()
+    {
+        if(impl->virtualized)
+        {
+            impl->paused = true;
+        }
+        else if(impl->master)
+        {
+            impl->audio->pause(impl->master);
+        }
+    }
+
+    void Channel::stop()
+    {
+        impl->virtualized = false;
+        if(impl->master)
+        {
+            impl->audio->stop(impl->master);
+            impl->stopped = true;
+        }
+    }
+
+    bool Channel::isPlaying() const
+    {
+        if(impl->virtualized)
+        {
+            return !impl->paused;
+        }
+        if(impl->stopped)
+        {
+            return false;
+        }
+        if(impl->master)
+        {
+            return impl->audio->playing(impl->master);
+        }
+        return false;
+    }
+
     Audio::Audio(Engine& engine, bool disabled)
         : impl(new Impl(engine, disabled))
     {
@@ -214,6 +664,9 @@ namespace plum
         plaidgadget::String fn(filename.begin(), filename.end());
         sound.impl->filename = fn;
         sound.impl->looped = looped;
+
+        // Decode short sounds up front, so the first play doesn't hitch.
+        impl->fetchClip(fn);
     }
 
     void Audio::loadChannel(const Sound& sound, Channel& channel)
@@ -223,18 +676,27 @@ namespace plum
             return;
         }
 
-        plaidgadget::Sound stream(impl->audio->stream(sound.impl->filename, sound.impl->looped));
+        plaidgadget::Sound stream;
+        double duration = 0.0;
+        auto clip = impl->fetchClip(sound.impl->filename, &duration);
+        if(!clip.null())
+        {
+            stream = plaidgadget::Sound(clip->player(sound.impl->looped));
+        }
+        else
+        {
+            // Clips are decoded on this thread, but anything streamed gets decoded ahead of the audio callback.
+            stream = impl->prefetcher->wrap(impl->audio->stream(sound.impl->filename, sound.impl->looped));
+        }
         if(!stream.null())
         {
-            plaidgadget::Ref<plaidgadget::Pitch> pitchfx(new plaidgadget::Pitch(stream));
-            plaidgadget::Ref<plaidgadget::Pan> panfx(new plaidgadget::Pan(plaidgadget::Sound(pitchfx)));
-            plaidgadget::Sound master = plaidgadget::Sound(panfx);
-
             channel.impl->looped = sound.impl->looped;
             channel.impl->audio = impl->audio;
-            channel.impl->pitchfx = pitchfx;
-            channel.impl->panfx = panfx;
-            channel.impl->master = master;
+            channel.impl->owner = impl;
+            channel.impl->sound = sound.impl;
+            channel.impl->clip = clip;
+            channel.impl->duration = duration;
+            impl->attach(*channel.impl, stream);
             channel.impl->dispose.reset(new bool(false));
             impl->channels.insert(channel.impl);
         }
@@ -269,4 +731,100 @@ namespace plum
     {
         impl->volume = value;
     }
+
+    size_t Audio::getCacheBudget() const
+    {
+        return impl->cacheBudget;
+    }
+
+    size_t Audio::getCacheThreshold() const
+    {
+        return impl->cacheThreshold;
+    }
+
+    size_t Audio::getCacheUsage() const
+    {
+        return impl->cacheUsage;
+    }
+
+    void Audio::setCacheBudget(size_t bytes)
+    {
+        impl->cacheBudget = bytes;
+        impl->evict(bytes);
+        impl->streamed.clear();
+    }
+
+    void Audio::setCacheThreshold(size_t bytes)
+    {
+        impl->cacheThreshold = bytes;
+        impl->streamed.clear();
+    }
+
+    int Audio::getDecoderThreads() const
+    {
+        return impl->prefetcher->getThreadCount();
+    }
+
+    int Audio::getPrefetchMilliseconds() const
+    {
+        return impl->prefetcher->getMilliseconds();
+    }
+
+    void Audio::setDecoderThreads(int threadCount, int milliseconds)
+    {
+        // Streams that are already playing keep the old threads until they're done.
+        impl->prefetcher.reset(new Prefetcher(impl->audio, impl->disabled ? 0 : threadCount, milliseconds));
+    }
+
+    int Audio::getVoiceLimit() const
+    {
+        return impl->voiceLimit;
+    }
+
+    VoiceSteal Audio::getVoiceSteal() const
+    {
+        return impl->voiceSteal;
+    }
+
+    void Audio::setVoiceLimit(int count)
+    {
+        // Anything over the new limit gets stolen on the next update.
+        impl->voiceLimit = std::max(count, 0);
+    }
+
+    void Audio::setVoiceSteal(VoiceSteal policy)
+    {
+        impl->voiceSteal = policy;
+    }
+
+    int Audio::getActiveVoices() const
+    {
+        return impl->activeVoices;
+    }
+
+    int Audio::getVirtualVoices() const
+    {
+        return impl->virtualVoices;
+    }
+
+    unsigned int Audio::getUnderruns() const
+    {
+        return impl->prefetcher->getUnderruns();
+    }
+
+    AudioStats Audio::getStats() const
+    {
+        return impl->stats();
+    }
+
+    double Audio::getStatsLogInterval() const
+    {
+        return impl->statsInterval;
+    }
+
+    void Audio::setStatsLogInterval(double seconds)
+    {
+        impl->statsInterval = std::max(seconds, 0.0);
+        impl->nextStatsLog = impl->lastTime + impl->statsInterval;
+    }
 }
\ No newline at end of file
@@ -17,18 +17,19 @@ namespace
             {
                 {
                     std::unique_ptr<plum::File> file(new plum::File(plaidgadget::ToStdString(fn), plum::FileRead));
-                    // Get current position.
-                    unsigned int pos = file->tell();
-                    // Length to read = position of end - current.
-                    unsigned int length = 0;
-                    file->seek(pos, plum::SeekEnd);
-                    length = file->tell() - pos;
-                    file->seek(pos, plum::SeekStart);
-                    // Read fully.
-                    std::vector<uint8_t> data(length);
-                    file->readRaw(data.data(), data.size());
-                    // Load the mod.
-                    mod = ModPlug_Load(data.data(), data.size());
+                    // Files from an archive are already sitting in memory, so there's nothing to copy.
+                    if(auto contents = file->getData())
+                    {
+                        mod = ModPlug_Load(contents, int(file->getSize()));
+                    }
+                    else
+                    {
+                        // Read fully.
+                        std::vector<uint8_t> data(file->getSize());
+                        file->readRaw(data.data(), data.size());
+                        // Load the mod.
+                        mod = ModPlug_Load(data.data(), data.size());
+                    }
                 }
                 if(mod)
                 {
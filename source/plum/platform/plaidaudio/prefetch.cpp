@@ -0,0 +1,364 @@
+#include <vector>
+#include <algorithm>
+#include <plaid/thread/lockfree.h>
+
+#include "prefetch.h"
+#include "../../core/thread.h"
+#include "../../core/profile.h"
+
+namespace plum
+{
+    namespace
+    {
+        // Largest piece handed to the codec at once, in frames.
+        const plaidgadget::Uint32 BlockFrames = 2048;
+        // Smallest lookahead allowed, whatever the configured time.
+        const plaidgadget::Uint32 MinimumFrames = 1024;
+        // Zones the audio thread can time between updates. Any more are dropped.
+        const plaidgadget::Uint32 ZoneCapacity = 1024;
+
+        class PrefetchStream;
+    }
+
+    class Prefetcher::Impl
+    {
+        public:
+            Impl(const std::shared_ptr<plaidgadget::Audio>& audio, int milliseconds)
+                : audio(audio), milliseconds(milliseconds), quitting(false), underruns(0), missingFrames(0),
+                zones(ZoneCapacity, plaidgadget::QUEUE_REJECT)
+            {
+            }
+
+            ~Impl()
+            {
+                {
+                    Lock lock(mutex);
+                    quitting = true;
+                    wake.broadcast();
+                }
+                for(auto it = threads.begin(), end = threads.end(); it != end; ++it)
+                {
+                    (*it)->join();
+                }
+            }
+
+            void loop();
+            void add(PrefetchStream* stream);
+            void remove(PrefetchStream* stream);
+
+            // Audio thread only.
+            void underrun(plaidgadget::Uint32 frames)
+            {
+                plaidgadget::AtomicRelease(underruns, underruns + 1);
+                plaidgadget::AtomicRelease(missingFrames, missingFrames + frames);
+            }
+
+            // Audio thread only. The profiler takes locks, so zones wait here for the game thread to record them.
+            void timed(const char* name, uint64_t start, uint64_t end)
+            {
+                AudioZone zone = { name, start, end };
+                zones.push(zone);
+            }
+
+            std::shared_ptr<plaidgadget::Audio> audio;
+            int milliseconds;
+
+            std::vector<std::shared_ptr<Thread>> threads;
+            Mutex mutex;
+            // Workers sleep on this between passes. It's only a timeout, since the audio thread never signals it.
+            Condition wake;
+            // Broadcast whenever a worker puts a stream down.
+            Condition idle;
+            std::vector<PrefetchStream*> streams;
+            bool quitting;
+
+            volatile plaidgadget::Uint32 underruns;
+            volatile plaidgadget::Uint32 missingFrames;
+
+            struct AudioZone
+            {
+                const char* name;
+                uint64_t start;
+                uint64_t end;
+            };
+            plaidgadget::LockFreeQueue<AudioZone> zones;
+    };
+
+    namespace
+    {
+        // Planar ring of decoded samples, filled by one decoder thread at a time and drained by the audio thread.
+        class PrefetchStream : public plaidgadget::AudioStream
+        {
+            public:
+                PrefetchStream(const std::shared_ptr<Prefetcher::Impl>& owner, const plaidgadget::Sound& sound)
+                    : owner(owner), busy(false), source(sound), readPosition(0), writePosition(0), ended(0),
+                    finished(false), frame(0)
+                {
+                    sourceFormat = source.format();
+                    ahead = std::max(plaidgadget::Uint32((unsigned long long) sourceFormat.rate * owner->milliseconds / 1000), MinimumFrames);
+                    plaidgadget::Uint32 size = 1;
+                    while(size < ahead)
+                    {
+                        size <<= 1;
+                    }
+                    mask = size - 1;
+                    samples.resize(size * sourceFormat.channels);
+                }
+
+                ~PrefetchStream()
+                {
+                    owner->remove(this);
+                }
+
+                // Whether the ring has drained far enough to be worth topping up.
+                bool wants() const
+                {
+                    return !plaidgadget::AtomicAcquire(ended)
+                        && writePosition - plaidgadget::AtomicAcquire(readPosition) <= ahead - ahead / 4;
+                }
+
+                // Decodes until the ring holds the full lookahead. Only one thread may fill a stream at a time.
+                void fill()
+                {
+                    profile::Zone zone("PrefetchStream::fill");
+                    plaidgadget::Uint32 size = mask + 1;
+                    plaidgadget::Uint32 write = writePosition;
+                    while(!ended)
+                    {
+                        plaidgadget::Uint32 used = write - plaidgadget::AtomicAcquire(readPosition);
+                        if(used >= ahead)
+                        {
+                            break;
+                        }
+
+                        plaidgadget::Uint32 at = write & mask;
+                        plaidgadget::Uint32 length = std::min(std::min(ahead - used, size - at), BlockFrames);
+                        plaidgadget::Sint32* data[PG_MAX_CHANNELS] = {};
+                        for(plaidgadget::Uint32 c = 0; c < sourceFormat.channels; ++c)
+                        {
+                            data[c] = &samples[c * size + at];
+                        }
+
+                        plaidgadget::AudioChunk chunk(*owner->audio, sourceFormat, data, length, ++frame, 0.0f, 1.0f);
+                        source.tick(frame);
+                        source.pull(chunk);
+                        bool exhausted = source.exhausted();
+                        if(exhausted)
+                        {
+                            length = chunk.cutoff();
+                        }
+
+                        // Publish the samples before the end, so the audio thread never sees one without the other.
+                        write += length;
+                        plaidgadget::AtomicRelease(writePosition, write);
+                        if(exhausted)
+                        {
+                            plaidgadget::AtomicRelease(ended, plaidgadget::Uint32(1));
+                        }
+                    }
+                }
+
+                std::shared_ptr<Prefetcher::Impl> owner;
+                // Guarded by the owner's mutex.
+                bool busy;
+
+            protected:
+                plaidgadget::AudioFormat format()
+                {
+                    return sourceFormat;
+                }
+
+                // The source is ticked by whichever thread decodes it.
+                void tick(plaidgadget::Uint64)
+                {
+                }
+
+                bool exhausted()
+                {
+                    return finished;
+                }
+
+                void pull(plaidgadget::AudioChunk& chunk)
+                {
+                    if(finished)
+                    {
+                        chunk.silence();
+                        return;
+                    }
+                    // This is the only plum code running in the audio callback, which can't record zones itself.
+                    uint64_t start = profile::active ? profile::now() : 0;
+
+                    // Check for the end first, so that the write position read after it is final.
+                    bool done = plaidgadget::AtomicAcquire(ended) != 0;
+                    plaidgadget::Uint32 size = mask + 1;
+                    plaidgadget::Uint32 read = readPosition;
+                    plaidgadget::Uint32 length = chunk.length();
+                    plaidgadget::Uint32 count = std::min(plaidgadget::AtomicAcquire(writePosition) - read, length);
+
+                    plaidgadget::Uint32 at = read & mask;
+                    plaidgadget::Uint32 first = std::min(count, size - at);
+                    plaidgadget::Uint32 channels = std::min(chunk.channels(), sourceFormat.channels);
+                    for(plaidgadget::Uint32 c = 0; c < channels; ++c)
+                    {
+                        const plaidgadget::Sint32* ring = &samples[c * size];
+                        plaidgadget::Sint32* out = chunk.start(c);
+                        std::copy(ring + at, ring + at + first, out);
+                        std::copy(ring, ring + (count - first), out + first);
+                    }
+                    plaidgadget::AtomicRelease(readPosition, read + count);
+
+                    if(count < length)
+                    {
+                        if(done)
+                        {
+                            chunk.cutoff(count);
+                            finished = true;
+                        }
+                        else
+                        {
+                            // Decoding fell behind. Play silence rather than stalling the callback.
+                            chunk.silence(count);
+                            owner->underrun(length - count);
+                        }
+                    }
+
+                    if(start)
+                    {
+                        owner->timed("PrefetchStream::pull", start, profile::now());
+                    }
+                }
+
+            private:
+                plaidgadget::Signal source;
+                plaidgadget::AudioFormat sourceFormat;
+
+                std::vector<plaidgadget::Sint32> samples;
+                plaidgadget::Uint32 mask;
+                plaidgadget::Uint32 ahead;
+
+                // Positions count frames forever, and are only masked to index the ring.
+                volatile plaidgadget::Uint32 readPosition;
+                volatile plaidgadget::Uint32 writePosition;
+                volatile plaidgadget::Uint32 ended;
+
+                // Audio thread only.
+                bool finished;
+                // Decoder only.
+                plaidgadget::Uint64 frame;
+        };
+    }
+
+    void Prefetcher::Impl::loop()
+    {
+        // Often enough that a stream never gets near empty between passes.
+        int interval = std::max(milliseconds / 4, 1);
+        profile::setThreadName("Decoder");
+
+        Lock lock(mutex);
+        while(!quitting)
+        {
+            PrefetchStream* stream = nullptr;
+            for(auto it = streams.begin(), end = streams.end(); it != end; ++it)
+            {
+                if(!(*it)->busy && (*it)->wants())
+                {
+                    stream = *it;
+                    break;
+                }
+            }
+
+            if(!stream)
+            {
+                wake.wait(mutex, interval);
+                continue;
+            }
+
+            stream->busy = true;
+            mutex.unlock();
+            stream->fill();
+            mutex.lock();
+            stream->busy = false;
+            idle.broadcast();
+        }
+    }
+
+    void Prefetcher::Impl::add(PrefetchStream* stream)
+    {
+        Lock lock(mutex);
+        streams.push_back(stream);
+    }
+
+    void Prefetcher::Impl::remove(PrefetchStream* stream)
+    {
+        Lock lock(mutex);
+        auto it = std::find(streams.begin(), streams.end(), stream);
+        if(it != streams.end())
+        {
+            streams.erase(it);
+        }
+        while(stream->busy)
+        {
+            idle.wait(mutex);
+        }
+    }
+
+    Prefetcher::Prefetcher(const std::shared_ptr<plaidgadget::Audio>& audio, int threadCount, int milliseconds)
+        : impl(new Impl(audio, std::max(milliseconds, 1)))
+    {
+        // The threads only see the impl, which lives on as long as any stream that was wrapped by it.
+        auto prefetcher = impl.get();
+        for(int i = 0; i < threadCount; ++i)
+        {
+            impl->threads.push_back(std::make_shared<Thread>([prefetcher](){ prefetcher->loop(); }));
+        }
+    }
+
+    Prefetcher::~Prefetcher()
+    {
+    }
+
+    int Prefetcher::getThreadCount() const
+    {
+        return int(impl->threads.size());
+    }
+
+    int Prefetcher::getMilliseconds() const
+    {
+        return impl->milliseconds;
+    }
+
+    uint32_t Prefetcher::getUnderruns() const
+    {
+        return plaidgadget::AtomicAcquire(impl->underruns);
+    }
+
+    uint32_t Prefetcher::getMissingFrames() const
+    {
+        return plaidgadget::AtomicAcquire(impl->missingFrames);
+    }
+
+    void Prefetcher::update()
+    {
+        static int track = profile::addTrack("Audio");
+        Impl::AudioZone zone;
+        while(impl->zones.pull(zone))
+        {
+            profile::record(track, zone.name, zone.start, zone.end);
+        }
+    }
+
+    plaidgadget::Sound Prefetcher::wrap(const plaidgadget::Sound& source)
+    {
+        if(source.null() || impl->threads.empty())
+        {
+            return source;
+        }
+
+        plaidgadget::Ref<PrefetchStream> stream(new PrefetchStream(impl, source));
+        // Nothing else can see the stream yet, so the first fill can happen right here,
+        // and playback starts with a full ring instead of an underrun.
+        stream->fill();
+        impl->add(stream);
+        return plaidgadget::Sound(stream);
+    }
+}
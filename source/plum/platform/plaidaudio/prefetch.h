@@ -0,0 +1,43 @@
+#ifndef PLUM_PLAIDAUDIO_PREFETCH_H
+#define PLUM_PLAIDAUDIO_PREFETCH_H
+
+#include <memory>
+#include <cstdint>
+#include <plaid/audio.h>
+
+namespace plum
+{
+    // Decodes streamed sounds ahead of time on background threads, so that the audio callback
+    // only has to copy samples out of a ring buffer instead of running the codec itself.
+    class Prefetcher
+    {
+        public:
+            // Each stream is kept about the given number of milliseconds ahead of playback.
+            // With no threads, streams are handed back untouched, and decode in the audio callback.
+            Prefetcher(const std::shared_ptr<plaidgadget::Audio>& audio, int threadCount, int milliseconds);
+            ~Prefetcher();
+
+            int getThreadCount() const;
+            int getMilliseconds() const;
+
+            // Totals across every stream: pulls that found their ring short, and the frames of silence played instead.
+            uint32_t getUnderruns() const;
+            uint32_t getMissingFrames() const;
+
+            // Records the zones the audio thread timed since the last call. Game thread only.
+            void update();
+
+            // The source gets pulled from a decoder thread, so it must not allocate from the audio scratch pool.
+            // That rules out effects, but is fine for anything that comes straight from a codec.
+            plaidgadget::Sound wrap(const plaidgadget::Sound& source);
+
+            class Impl;
+            std::shared_ptr<Impl> impl;
+
+        private:
+            Prefetcher(const Prefetcher&);
+            void operator =(const Prefetcher&);
+    };
+}
+
+#endif
@@ -0,0 +1,119 @@
+#include <cstdio>
+#include <algorithm>
+
+#include "engine.h"
+#include "../../core/log.h"
+
+namespace plum
+{
+    namespace
+    {
+        template<typename T> void cleanup(std::vector<std::weak_ptr<T>>& hooks)
+        {
+            for(auto it = hooks.begin(); it != hooks.end();)
+            {
+                if(!it->lock())
+                {
+                    it = hooks.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+        }
+    }
+
+    // Nobody is around to click through a message box, so errors only go to stderr and the log.
+    void Engine::Impl::quit(const std::string& message)
+    {
+        if(message.length())
+        {
+            fprintf(stderr, "Exit Requested: %s", message.c_str());
+            logFormat("Exit Requested: %s", message.c_str());
+            throw SystemExit(1);
+        }
+        throw SystemExit(0);
+    }
+
+    void Engine::Impl::refresh()
+    {
+        if(profile::active)
+        {
+            profile::record("Script", lastRefresh, profile::now());
+        }
+        profile::Zone zone("Engine::refresh");
+
+        // Hand over anything the loader threads have finished with.
+        {
+            profile::Zone loaderZone("Loader::update");
+            loader->update();
+        }
+
+        {
+            profile::Zone hookZone("Update hooks");
+            for(auto it = updateHooks.begin(), end = updateHooks.end(); it != end; ++it)
+            {
+                if(auto f = it->lock())
+                {
+                    (*f)();
+                }
+            }
+            cleanup(updateHooks);
+            cleanup(eventHooks);
+        }
+
+        profile::frame();
+        lastRefresh = profile::now();
+    }
+
+    Engine::Engine()
+        : impl(new Impl())
+    {
+    }
+
+    Engine::~Engine()
+    {
+    }
+
+    void Engine::refresh()
+    {
+        impl->refresh();
+    }
+
+    void Engine::quit(const std::string& message)
+    {
+        impl->quit(message);
+    }
+
+    std::shared_ptr<Engine::EventHook> Engine::addEventHook(const EventHook& hook)
+    {
+        auto ptr = std::make_shared<Engine::EventHook>(hook);
+        impl->eventHooks.push_back(ptr);
+        return ptr;
+    }
+
+    std::shared_ptr<Engine::UpdateHook> Engine::addUpdateHook(const UpdateHook& hook)
+    {
+        auto ptr = std::make_shared<Engine::UpdateHook>(hook);
+        impl->updateHooks.push_back(ptr);
+        return ptr;
+    }
+
+    void Engine::setWorkerThreads(int count, int threshold)
+    {
+        impl->workers.reset();
+        if(count > 0)
+        {
+            impl->workers = std::make_shared<WorkerPool>(count, threshold);
+        }
+    }
+
+    void Engine::setLoaderThreads(int count)
+    {
+        auto loader = std::make_shared<Loader>(std::max(count, 0));
+        // Jobs still waiting on the old loader carry over, rather than being dropped.
+        loader->adopt(*impl->loader);
+        impl->loader = loader;
+    }
+}
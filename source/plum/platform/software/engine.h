@@ -0,0 +1,39 @@
+#ifndef PLUM_SOFTWARE_ENGINE_H
+#define PLUM_SOFTWARE_ENGINE_H
+
+#include <vector>
+
+#include "../../core/engine.h"
+#include "../../core/workers.h"
+#include "../../core/loader.h"
+#include "../../core/profile.h"
+
+namespace plum
+{
+    // There's no window to send anything, so event hooks are kept but never called.
+    class Engine::Impl
+    {
+        public:
+            std::vector<std::weak_ptr<EventHook>> eventHooks;
+            std::vector<std::weak_ptr<UpdateHook>> updateHooks;
+            std::shared_ptr<WorkerPool> workers;
+            std::shared_ptr<Loader> loader;
+            // When the last refresh returned to the script, so the time in between can be profiled as script time.
+            uint64_t lastRefresh;
+
+            Impl()
+                : loader(new Loader(0)), lastRefresh(0)
+            {
+                profile::setThreadName("Main");
+            }
+
+            ~Impl()
+            {
+            }
+
+            void quit(const std::string& message);
+            void refresh();
+    };
+}
+
+#endif
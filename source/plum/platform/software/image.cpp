@@ -0,0 +1,296 @@
+#include <cmath>
+#include <algorithm>
+
+#include "screen.h"
+#include "../../core/image.h"
+#include "../../core/profile.h"
+#include "../../core/transform.h"
+
+namespace plum
+{
+    namespace
+    {
+        // Draws part of a canvas onto the screen. Scaled copies go through scaleBlitRegion,
+        // rotated ones through rotateScaleBlitRegion, and everything else is a plain region blit.
+        // When rotating, the destination is where the middle of the region ends up, instead of its corner.
+        struct Blit
+        {
+            Blit(const Canvas& source, Canvas& dest, int sourceX, int sourceY, int sourceX2, int sourceY2, int destX, int destY)
+                : source(source), dest(dest),
+                sourceX(sourceX), sourceY(sourceY), sourceX2(sourceX2), sourceY2(sourceY2),
+                destX(destX), destY(destY),
+                width(sourceX2 - sourceX + 1), height(sourceY2 - sourceY + 1),
+                angle(0.0), scale(1.0)
+            {
+            }
+
+            template<BlendMode Blend> void run()
+            {
+                if(angle != 0.0)
+                {
+                    source.rotateScaleBlitRegion<Blend>(sourceX, sourceY, sourceX2, sourceY2, destX, destY, angle, scale, dest);
+                }
+                else if(width != sourceX2 - sourceX + 1 || height != sourceY2 - sourceY + 1)
+                {
+                    source.scaleBlitRegion<Blend>(sourceX, sourceY, sourceX2, sourceY2, destX, destY, width, height, dest);
+                }
+                else
+                {
+                    source.blitRegion<Blend>(sourceX, sourceY, sourceX2, sourceY2, destX, destY, dest);
+                }
+            }
+
+            const Canvas& source;
+            Canvas& dest;
+            int sourceX, sourceY, sourceX2, sourceY2;
+            int destX, destY;
+            int width, height;
+            double angle, scale;
+        };
+    }
+
+    class Image::Impl
+    {
+        public:
+            Impl(const Canvas& source)
+                : canvas(source.getWidth(), source.getHeight())
+            {
+                canvas.clear(0);
+                source.blit<BlendOpaque>(0, 0, canvas);
+            }
+
+            ~Impl()
+            {
+            }
+
+            // Clamps the region to the canvas, and puts the corners in order.
+            void clamp(int& sourceX, int& sourceY, int& sourceX2, int& sourceY2) const
+            {
+                if(sourceX > sourceX2)
+                {
+                    std::swap(sourceX, sourceX2);
+                }
+                if(sourceY > sourceY2)
+                {
+                    std::swap(sourceY, sourceY2);
+                }
+                sourceX = std::min(std::max(0, sourceX), canvas.getWidth() - 1);
+                sourceY = std::min(std::max(0, sourceY), canvas.getHeight() - 1);
+                sourceX2 = std::min(std::max(0, sourceX2), canvas.getWidth() - 1);
+                sourceY2 = std::min(std::max(0, sourceY2), canvas.getHeight() - 1);
+            }
+
+            // Same placement as the GL version: the unrotated region sits at the destination,
+            // and turns around its middle.
+            Blit rotated(Canvas& dest, int sourceX, int sourceY, int sourceX2, int sourceY2,
+                int destX, int destY, double angle, double scale) const
+            {
+                Blit blit(canvas, dest, sourceX, sourceY, sourceX2, sourceY2, destX, destY);
+                if(angle != 0.0)
+                {
+                    blit.angle = angle;
+                    blit.scale = scale;
+                    blit.destX = destX + int((sourceX2 - sourceX) * scale / 2);
+                    blit.destY = destY + int((sourceY2 - sourceY) * scale / 2);
+                }
+                else
+                {
+                    blit.width = int((sourceX2 - sourceX + 1) * scale);
+                    blit.height = int((sourceY2 - sourceY + 1) * scale);
+                }
+                return blit;
+            }
+
+            void draw(Blit blit, BlendMode mode)
+            {
+                software::withBlend(mode, blit);
+            }
+
+            // The image draws straight from this, so there's no copy to keep up to date.
+            Canvas canvas;
+    };
+
+    Image::Image(const Canvas& source)
+        : impl(new Impl(source))
+    {
+    }
+
+    Image::~Image()
+    {
+    }
+
+    Canvas& Image::canvas()
+    {
+        return impl->canvas;
+    }
+
+    const Canvas& Image::canvas() const
+    {
+        return impl->canvas;
+    }
+
+    void Image::refresh()
+    {
+    }
+
+    void Image::bind()
+    {
+    }
+
+    void Image::mapTexture(double x, double y, double& s, double& t) const
+    {
+        s = x / impl->canvas.getWidth();
+        t = y / impl->canvas.getHeight();
+    }
+
+    void Image::blit(int x, int y, BlendMode mode)
+    {
+        scaleBlitRegion(0, 0, impl->canvas.getWidth(), impl->canvas.getHeight(), x, y, impl->canvas.getWidth(), impl->canvas.getHeight(), mode);
+    }
+
+    void Image::scaleBlit(int x, int y, int width, int height, BlendMode mode)
+    {
+        scaleBlitRegion(0, 0, impl->canvas.getWidth(), impl->canvas.getHeight(), x, y, width, height, mode);
+    }
+
+    void Image::blitRegion(int sourceX, int sourceY, int sourceX2, int sourceY2,
+                    int destX, int destY, BlendMode mode)
+    {
+        scaleBlitRegion(sourceX, sourceY, sourceX2, sourceY2, destX, destY,
+            std::abs(sourceX2 - sourceX) + 1, std::abs(sourceY2 - sourceY) + 1, mode);
+    }
+
+    void Image::scaleBlitRegion(int sourceX, int sourceY, int sourceX2, int sourceY2,
+                    int destX, int destY, int scaledWidth, int scaledHeight, BlendMode mode)
+    {
+        profile::Zone zone("Image::scaleBlitRegion");
+        auto screen = Screen::Impl::current();
+        if(!screen) return;
+
+        impl->clamp(sourceX, sourceY, sourceX2, sourceY2);
+        Blit blit(impl->canvas, screen->canvas, sourceX, sourceY, sourceX2, sourceY2, destX, destY);
+        blit.width = scaledWidth;
+        blit.height = scaledHeight;
+        impl->draw(blit, mode);
+    }
+
+    void Image::rotateBlit(int x, int y, double angle, BlendMode mode)
+    {
+        rotateScaleBlitRegion(0, 0, impl->canvas.getWidth(), impl->canvas.getHeight(), x, y, angle, 1.0, mode);
+    }
+
+    void Image::rotateScaleBlit(int x, int y, double angle, double scale, BlendMode mode)
+    {
+        rotateScaleBlitRegion(0, 0, impl->canvas.getWidth(), impl->canvas.getHeight(), x, y, angle, scale, mode);
+    }
+
+    void Image::rotateBlitRegion(int sourceX, int sourceY, int sourceX2, int sourceY2,
+                    int destX, int destY, double angle, BlendMode mode)
+    {
+        rotateScaleBlitRegion(sourceX, sourceY, sourceX2, sourceY2, destX, destY, angle, 1.0, mode);
+    }
+
+    void Image::rotateScaleBlitRegion(int sourceX, int sourceY, int sourceX2, int sourceY2,
+                    int destX, int destY, double angle, double scale, BlendMode mode)
+    {
+        profile::Zone zone("Image::rotateScaleBlitRegion");
+        auto screen = Screen::Impl::current();
+        if(!screen) return;
+
+        impl->clamp(sourceX, sourceY, sourceX2, sourceY2);
+        impl->draw(impl->rotated(screen->canvas, sourceX, sourceY, sourceX2, sourceY2, destX, destY, angle, scale), mode);
+    }
+
+    // Uses whichever blend mode was last handed to useHardwareBlender, the way the GL version uses the bound state.
+    void Image::rawBlitRegion(int sourceX, int sourceY, int sourceX2, int sourceY2,
+                    int destX, int destY, double angle, double scale)
+    {
+        auto screen = Screen::Impl::current();
+        if(!screen) return;
+
+        sourceX = std::min(std::max(0, sourceX), impl->canvas.getWidth() - 1);
+        sourceY = std::min(std::max(0, sourceY), impl->canvas.getHeight() - 1);
+        sourceX2 = std::min(std::max(0, sourceX2), impl->canvas.getWidth() - 1);
+        sourceY2 = std::min(std::max(0, sourceY2), impl->canvas.getHeight() - 1);
+
+        impl->draw(impl->rotated(screen->canvas, sourceX, sourceY, sourceX2, sourceY2, destX, destY, angle, scale), screen->blendMode);
+    }
+
+    // Mirroring, uneven scaling and tinting have no canvas primitive, so the region is
+    // built up in a scratch canvas first, and that gets drawn like any other blit.
+    void Image::transformBlit(Transform* transform)
+    {
+        profile::Zone zone("Image::transformBlit");
+        auto screen = Screen::Impl::current();
+        if(!screen) return;
+
+        int sourceX, sourceY, sourceX2, sourceY2;
+        if(transform->clip)
+        {
+            sourceX = int(std::min<double>(std::max(0.0, transform->clip->x), impl->canvas.getWidth() - 1));
+            sourceY = int(std::min<double>(std::max(0.0, transform->clip->y), impl->canvas.getHeight() - 1));
+            sourceX2 = int(std::min<double>(sourceX + transform->clip->width, impl->canvas.getWidth())) - 1;
+            sourceY2 = int(std::min<double>(sourceY + transform->clip->height, impl->canvas.getHeight())) - 1;
+        }
+        else
+        {
+            sourceX = sourceY = 0;
+            sourceX2 = impl->canvas.getWidth() - 1;
+            sourceY2 = impl->canvas.getHeight() - 1;
+        }
+        if(sourceX2 < sourceX || sourceY2 < sourceY) return;
+
+        double scaleX = transform->scale->x;
+        double scaleY = transform->scale->y;
+        int width = std::max(int(std::abs((sourceX2 - sourceX + 1) * scaleX)), 1);
+        int height = std::max(int(std::abs((sourceY2 - sourceY + 1) * scaleY)), 1);
+
+        Canvas scratch(width, height);
+        scratch.clear(0);
+        {
+            // Opacity is applied once, when the scratch canvas goes onto the screen.
+            int opacity = getOpacity();
+            setOpacity(255);
+            impl->canvas.scaleBlitRegion<BlendOpaque>(sourceX, sourceY, sourceX2, sourceY2, 0, 0, width, height, scratch);
+            setOpacity(opacity);
+        }
+        if(transform->mirror != (scaleX < 0))
+        {
+            scratch.flip(true, false);
+        }
+        if(scaleY < 0)
+        {
+            scratch.flip(false, true);
+        }
+
+        uint8_t r, g, b, a;
+        transform->tint.channels(r, g, b, a);
+        if(r != 255 || g != 255 || b != 255 || a != 255)
+        {
+            Color* pixel = scratch.getData();
+            for(int i = 0, count = width * height; i < count; ++i, ++pixel)
+            {
+                uint8_t pr, pg, pb, pa;
+                pixel->channels(pr, pg, pb, pa);
+                *pixel = Color(uint8_t(pr * r / 255), uint8_t(pg * g / 255), uint8_t(pb * b / 255), uint8_t(pa * a / 255));
+            }
+        }
+
+        // The pivot lands on position + pivot, and the image turns around it.
+        double originX = transform->position->x + transform->pivot->x;
+        double originY = transform->position->y + transform->pivot->y;
+        double pivotX = transform->pivot->x * std::abs(scaleX);
+        double pivotY = transform->pivot->y * std::abs(scaleY);
+        Blit blit(scratch, screen->canvas, 0, 0, width - 1, height - 1, int(originX - pivotX), int(originY - pivotY));
+        if(transform->angle != 0.0)
+        {
+            double radians = transform->angle * M_PI / 180.0;
+            double centerX = (width - 1) / 2.0 - pivotX;
+            double centerY = (height - 1) / 2.0 - pivotY;
+            blit.angle = transform->angle;
+            blit.destX = int(originX + centerX * cos(radians) - centerY * sin(radians));
+            blit.destY = int(originY + centerX * sin(radians) + centerY * cos(radians));
+        }
+        impl->draw(blit, transform->mode);
+    }
+}
@@ -0,0 +1,100 @@
+#include "../../core/input.h"
+#include "../../core/engine.h"
+
+namespace plum
+{
+    // Nothing can be pressed without a window, but scripts can still poke the inputs,
+    // for instance to fake key presses when replaying a run.
+    class Keyboard::Impl
+    {
+        public:
+            Impl(Engine& engine)
+                : engine(engine)
+            {
+            }
+
+            ~Impl()
+            {
+            }
+
+            Engine& engine;
+            Input keys[KeyBreak + 1];
+    };
+
+    Keyboard::Keyboard(Engine& engine)
+        : impl(new Impl(engine))
+    {
+    }
+
+    Keyboard::~Keyboard()
+    {
+    }
+
+    Input& Keyboard::operator[](Key k)
+    {
+        return impl->keys[k];
+    }
+
+
+
+    class Mouse::Impl
+    {
+        public:
+            Impl(Engine& engine)
+                : engine(engine), x(0), y(0)
+            {
+            }
+
+            ~Impl()
+            {
+            }
+
+            Engine& engine;
+            Input l, m, r, wu, wd;
+            double x, y;
+    };
+
+    Mouse::Mouse(Engine& engine)
+        : impl(new Impl(engine))
+    {
+    }
+
+    Mouse::~Mouse()
+    {
+    }
+
+    Input& Mouse::getLeft()
+    {
+        return impl->l;
+    }
+
+    Input& Mouse::getMiddle()
+    {
+        return impl->m;
+    }
+
+    Input& Mouse::getRight()
+    {
+        return impl->r;
+    }
+
+    Input& Mouse::getWheelUp()
+    {
+        return impl->wu;
+    }
+
+    Input& Mouse::getWheelDown()
+    {
+        return impl->wd;
+    }
+
+    double Mouse::getX()
+    {
+        return impl->x;
+    }
+
+    double Mouse::getY()
+    {
+        return impl->y;
+    }
+}
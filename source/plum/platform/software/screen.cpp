@@ -0,0 +1,240 @@
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+
+#include "screen.h"
+#include "../../core/log.h"
+#include "../../core/profile.h"
+
+namespace plum
+{
+    namespace
+    {
+        Screen::Impl* activeScreen = nullptr;
+
+        // One of the canvas primitives. Ellipses take a center and radii in place of the two corners.
+        struct Shape
+        {
+            enum Kind
+            {
+                Line,
+                Rect,
+                SolidRect,
+                Ellipse,
+                SolidEllipse
+            };
+
+            Shape(Kind kind, Canvas& canvas, int x, int y, int x2, int y2, Color color)
+                : kind(kind), canvas(canvas), x(x), y(y), x2(x2), y2(y2), color(color)
+            {
+            }
+
+            template<BlendMode Blend> void run()
+            {
+                switch(kind)
+                {
+                    case Line: canvas.line<Blend>(x, y, x2, y2, color); break;
+                    case Rect: canvas.rect<Blend>(x, y, x2, y2, color); break;
+                    case SolidRect: canvas.fillRect<Blend>(x, y, x2, y2, color); break;
+                    case Ellipse: canvas.ellipse<Blend>(x, y, x2, y2, color); break;
+                    case SolidEllipse: canvas.fillEllipse<Blend>(x, y, x2, y2, color); break;
+                }
+            }
+
+            Kind kind;
+            Canvas& canvas;
+            int x, y, x2, y2;
+            Color color;
+        };
+
+        void draw(Shape::Kind kind, int x, int y, int x2, int y2, Color color, BlendMode mode)
+        {
+            if(auto screen = Screen::Impl::current())
+            {
+                Shape shape(kind, screen->canvas, x, y, x2, y2, color);
+                software::withBlend(mode, shape);
+            }
+        }
+
+        Color mix(Color color, Color color2, int step, int steps)
+        {
+            uint8_t r, g, b, a;
+            uint8_t r2, g2, b2, a2;
+            color.channels(r, g, b, a);
+            color2.channels(r2, g2, b2, a2);
+            return Color(uint8_t(r + (r2 - r) * step / steps),
+                uint8_t(g + (g2 - g) * step / steps),
+                uint8_t(b + (b2 - b) * step / steps),
+                uint8_t(a + (a2 - a) * step / steps));
+        }
+    }
+
+    // Nothing to set up without a GL context, but raw blits still need to know the mode.
+    void useHardwareBlender(BlendMode mode)
+    {
+        if(auto screen = Screen::Impl::current())
+        {
+            screen->blendMode = mode;
+        }
+    }
+
+    void useHardwareColor(int r, int g, int b, int a)
+    {
+    }
+
+    Screen::Impl::Impl(Engine& engine)
+        : engine(engine), width(0), height(0), scale(1), blendMode(BlendPreserve), dumpInterval(1), frame(0)
+    {
+        hook = engine.addUpdateHook([this](){ update(); });
+        activeScreen = this;
+    }
+
+    Screen::Impl::~Impl()
+    {
+        if(activeScreen == this)
+        {
+            activeScreen = nullptr;
+        }
+    }
+
+    Screen::Impl* Screen::Impl::current()
+    {
+        return activeScreen;
+    }
+
+    void Screen::Impl::update()
+    {
+        profile::Zone zone("Screen::update");
+        if(!dumpPrefix.empty() && frame % dumpInterval == 0)
+        {
+            std::ostringstream filename;
+            filename << dumpPrefix << std::setw(6) << std::setfill('0') << frame << ".png";
+            if(!canvas.save(filename.str()))
+            {
+                logFormat("Couldn't write frame dump '%s'.\n", filename.str().c_str());
+            }
+        }
+        ++frame;
+    }
+
+    Screen::Screen(Engine& engine, int width, int height, int scale, bool win)
+        : impl(new Impl(engine))
+    {
+        setResolution(width, height, scale, win);
+    }
+
+    Screen::~Screen()
+    {
+    }
+
+    int Screen::getWidth() const
+    {
+        return impl->width;
+    }
+
+    int Screen::getHeight() const
+    {
+        return impl->height;
+    }
+
+    int Screen::getTrueWidth() const
+    {
+        return impl->width * impl->scale;
+    }
+
+    int Screen::getTrueHeight() const
+    {
+        return impl->height * impl->scale;
+    }
+
+    void Screen::setTitle(const std::string& title)
+    {
+        impl->title = title;
+    }
+
+    // There's no window, so scale and fullscreen only affect the reported true size. Frames stay at the logical size.
+    void Screen::setResolution(int width, int height, int scale, bool win)
+    {
+        impl->width = width;
+        impl->height = height;
+        impl->scale = scale;
+        impl->canvas = Canvas(width, height);
+    }
+
+    void Screen::setFrameDump(const std::string& prefix, int interval)
+    {
+        impl->dumpPrefix = prefix;
+        impl->dumpInterval = std::max(interval, 1);
+    }
+
+    // Drawing goes straight into the canvas, so there's nothing to batch.
+    void Screen::startBatch()
+    {
+    }
+
+    void Screen::endBatch()
+    {
+    }
+
+    void Screen::clear(Color color)
+    {
+        impl->canvas.clear(color);
+    }
+
+    void Screen::setPixel(int x, int y, Color color, BlendMode mode)
+    {
+        solidRect(x, y, x, y, color, mode);
+    }
+
+    void Screen::line(int x, int y, int x2, int y2, Color color, BlendMode mode)
+    {
+        draw(Shape::Line, x, y, x2, y2, color, mode);
+    }
+
+    void Screen::rect(int x, int y, int x2, int y2, Color color, BlendMode mode)
+    {
+        draw(Shape::Rect, x, y, x2, y2, color, mode);
+    }
+
+    void Screen::solidRect(int x, int y, int x2, int y2, Color color, BlendMode mode)
+    {
+        draw(Shape::SolidRect, x, y, x2, y2, color, mode);
+    }
+
+    // Runs from color2 on the left to color on the right, the same way round as the GL version.
+    void Screen::horizontalGradientRect(int x, int y, int x2, int y2, Color color, Color color2, BlendMode mode)
+    {
+        if(x > x2)
+        {
+            std::swap(x, x2);
+        }
+        int steps = std::max(x2 - x, 1);
+        for(int i = x; i <= x2; ++i)
+        {
+            draw(Shape::SolidRect, i, y, i, y2, mix(color2, color, i - x, steps), mode);
+        }
+    }
+
+    void Screen::verticalGradientRect(int x, int y, int x2, int y2, Color color, Color color2, BlendMode mode)
+    {
+        if(y > y2)
+        {
+            std::swap(y, y2);
+        }
+        int steps = std::max(y2 - y, 1);
+        for(int i = y; i <= y2; ++i)
+        {
+            draw(Shape::SolidRect, x, i, x2, i, mix(color, color2, i - y, steps), mode);
+        }
+    }
+
+    void Screen::circle(int x, int y, int horizontalRadius, int verticalRadius, Color color, BlendMode mode)
+    {
+        draw(Shape::Ellipse, x, y, horizontalRadius, verticalRadius, color, mode);
+    }
+
+    void Screen::solidCircle(int x, int y, int horizontalRadius, int verticalRadius, Color color, BlendMode mode)
+    {
+        draw(Shape::SolidEllipse, x, y, horizontalRadius, verticalRadius, color, mode);
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef PLUM_SOFTWARE_SCREEN_H
+#define PLUM_SOFTWARE_SCREEN_H
+
+#include <string>
+
+#include "../../core/canvas.h"
+#include "../../core/screen.h"
+#include "../../core/engine.h"
+
+namespace plum
+{
+    // Everything that would go to a window is drawn into this canvas instead,
+    // with the same blit templates that canvases use everywhere else.
+    class Screen::Impl
+    {
+        public:
+            Impl(Engine& engine);
+            ~Impl();
+
+            // The screen being drawn to, or nullptr if there isn't one.
+            static Impl* current();
+
+            void update();
+
+            Engine& engine;
+            std::shared_ptr<Engine::UpdateHook> hook;
+
+            Canvas canvas;
+            int width, height;
+            int scale;
+            std::string title;
+
+            // The mode raw blits are drawn with, since there's no GL state to hold onto it.
+            BlendMode blendMode;
+
+            std::string dumpPrefix;
+            int dumpInterval;
+            unsigned int frame;
+    };
+
+    namespace software
+    {
+        // Calls op.run<Blend>() with the template argument matching the mode.
+        template<typename Op> void withBlend(BlendMode mode, Op& op)
+        {
+            switch(mode)
+            {
+                case BlendOpaque: op.template run<BlendOpaque>(); break;
+                case BlendMerge: op.template run<BlendMerge>(); break;
+                case BlendPreserve: op.template run<BlendPreserve>(); break;
+                case BlendAdd: op.template run<BlendAdd>(); break;
+                case BlendSubtract: op.template run<BlendSubtract>(); break;
+            }
+        }
+    }
+}
+
+#endif
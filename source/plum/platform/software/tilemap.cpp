@@ -0,0 +1,90 @@
+#include <algorithm>
+
+#include "screen.h"
+#include "../../core/sprite.h"
+#include "../../core/canvas.h"
+#include "../../core/tilemap.h"
+#include "../../core/profile.h"
+
+namespace plum
+{
+    namespace
+    {
+        // Draws every visible tile as a region blit, clipped to the window the map was asked to fill.
+        struct TileBlit
+        {
+            TileBlit(const Tilemap& map, const unsigned int* data, Sprite& spr, Canvas& dest,
+                int tileX, int tileY, int tilesWide, int tilesHigh, int left, int top)
+                : map(map), data(data), spr(spr), source(spr.image().canvas()), dest(dest),
+                tileX(tileX), tileY(tileY), tilesWide(tilesWide), tilesHigh(tilesHigh), left(left), top(top)
+            {
+            }
+
+            template<BlendMode Blend> void run()
+            {
+                int frameWidth = spr.getFrameWidth();
+                int frameHeight = spr.getFrameHeight();
+                for(int ty = 0; ty < tilesHigh; ++ty)
+                {
+                    for(int tx = 0; tx < tilesWide; ++tx)
+                    {
+                        int sx, sy, sx2, sy2;
+                        spr.getFrameRegion(data[(tileY + ty) * map.getWidth() + tileX + tx], sx, sy, sx2, sy2);
+                        sx = std::min(std::max(0, sx), source.getWidth() - 1);
+                        sy = std::min(std::max(0, sy), source.getHeight() - 1);
+                        sx2 = std::min(std::max(0, sx2), source.getWidth() - 1);
+                        sy2 = std::min(std::max(0, sy2), source.getHeight() - 1);
+                        source.blitRegion<Blend>(sx, sy, sx2, sy2, left + tx * frameWidth, top + ty * frameHeight, dest);
+                    }
+                }
+            }
+
+            const Tilemap& map;
+            const unsigned int* data;
+            Sprite& spr;
+            const Canvas& source;
+            Canvas& dest;
+            int tileX, tileY, tilesWide, tilesHigh;
+            int left, top;
+        };
+    }
+
+    // Tiles are cheap enough to blit one at a time here, so there's no chunk cache to keep.
+    void Tilemap::blit(Screen& screen, Sprite& spr, int worldX, int worldY, int destX, int destY, int tilesWide, int tilesHigh, BlendMode mode)
+    {
+        if(tilesWide < 0 || tilesHigh < 0 || !spr.getColumns()) return;
+        profile::Zone zone("Tilemap::blit");
+
+        auto impl = Screen::Impl::current();
+        if(!impl) return;
+
+        int frameWidth = spr.getFrameWidth();
+        int frameHeight = spr.getFrameHeight();
+        int xofs = -(worldX % frameWidth);
+        int yofs = -(worldY % frameHeight);
+        int tileX = worldX / frameWidth;
+        int tileY = worldY / frameHeight;
+
+        // Clip the tile region to make sure things don't crash.
+        if(tileX < 0)
+        {
+            tileX = 0;
+        }
+        if(tileY < 0)
+        {
+            tileY = 0;
+        }
+        if(tileX + tilesWide > width)
+        {
+            tilesWide = width - tileX;
+        }
+        if(tileY + tilesHigh > height)
+        {
+            tilesHigh = height - tileY;
+        }
+        if(tilesWide <= 0 || tilesHigh <= 0) return;
+
+        TileBlit op(*this, data, spr, impl->canvas, tileX, tileY, tilesWide, tilesHigh, destX + xofs, destY + yofs);
+        software::withBlend(mode, op);
+    }
+}
@@ -0,0 +1,17 @@
+#include "../../core/timer.h"
+#include "../../core/profile.h"
+
+namespace plum
+{
+    uint64_t Timer::now()
+    {
+        return profile::now();
+    }
+
+    // Every refresh is exactly one fixed step, whatever the wall clock says, so a headless
+    // run plays out the same way each time. Real frame times are still measured for the stats.
+    uint64_t Timer::advance(uint64_t frameTime, unsigned int rate)
+    {
+        return 1000000;
+    }
+}
@@ -3,6 +3,8 @@
 #include "core/screen.h"
 #include "core/config.h"
 #include "core/engine.h"
+#include "core/archive.h"
+#include "core/workers.h"
 #include "core/timer.h"
 #include "core/input.h"
 #include "script/script.h"
@@ -21,13 +23,59 @@ int main(int argc, char** argv)
         auto scale = std::max(config.get<int>("scale", 2), 1);
         auto silent = config.get<bool>("silent", false);
         auto windowed = config.get<bool>("windowed", true);
+        auto soundCache = config.get<int>("sound_cache_kb", -1);
+        auto soundCacheThreshold = config.get<int>("sound_cache_threshold_kb", -1);
+        auto workerThreads = std::max(config.get<int>("worker_threads", 0), 0);
+        auto workerThreshold = std::max(config.get<int>("worker_threshold", plum::WorkerPool::DefaultThreshold), 0);
+        auto loaderThreads = std::max(config.get<int>("loader_threads", 1), 0);
+        auto decoderThreads = std::max(config.get<int>("audio_decode_threads", 1), 0);
+        auto prefetchTime = std::max(config.get<int>("audio_prefetch_ms", 250), 1);
+        auto voiceLimit = std::max(config.get<int>("audio_voices", 32), 0);
+        auto voiceSteal = config.get<std::string>("audio_voice_steal", "priority");
+        auto audioStatsInterval = std::max(config.get<int>("audio_stats_log_seconds", 0), 0);
+        auto timerRate = std::max(config.get<int>("timer_rate", plum::Timer::DefaultRate), 1);
+        auto frameDump = config.get<std::string>("frame_dump", "");
+        auto frameDumpInterval = std::max(config.get<int>("frame_dump_interval", 1), 1);
+        auto archives = config.get<std::string>("archives", "data.pit");
+
+        // Comma-separated, and later archives take priority. Missing ones are skipped, so loose files still work.
+        for(size_t start = 0; start < archives.size();)
+        {
+            size_t end = std::min(archives.find(',', start), archives.size());
+            auto name = archives.substr(start, end - start);
+            name.erase(0, name.find_first_not_of(' '));
+            name.erase(name.find_last_not_of(' ') + 1);
+            if(!name.empty())
+            {
+                plum::Archive::mount(name);
+            }
+            start = end + 1;
+        }
 
         plum::Engine engine;
+        engine.setWorkerThreads(workerThreads, workerThreshold);
+        engine.setLoaderThreads(loaderThreads);
         plum::Keyboard keyboard(engine);
         plum::Mouse mouse(engine);
         plum::Timer timer(engine);
+        timer.setRate(timerRate);
         plum::Audio audio(engine, silent);
+        if(soundCache >= 0)
+        {
+            audio.setCacheBudget(size_t(soundCache) * 1024);
+        }
+        if(soundCacheThreshold >= 0)
+        {
+            audio.setCacheThreshold(size_t(soundCacheThreshold) * 1024);
+        }
+        audio.setDecoderThreads(decoderThreads, prefetchTime);
+        audio.setVoiceLimit(voiceLimit);
+        audio.setVoiceSteal(voiceSteal == "quietest" ? plum::StealQuietest
+            : voiceSteal == "oldest" ? plum::StealOldest
+            : plum::StealLowestPriority);
+        audio.setStatsLogInterval(audioStatsInterval);
         plum::Screen screen(engine, xres, yres, scale, windowed);
+        screen.setFrameDump(frameDump, frameDumpInterval);
 
         auto hook = engine.addUpdateHook([&]() {
             if(keyboard[plum::KeyTilde].isPressed())
@@ -0,0 +1,349 @@
+#include <vector>
+#include <stdexcept>
+
+#include "script.h"
+#include "../core/file.h"
+#include "../core/font.h"
+#include "../core/image.h"
+#include "../core/audio.h"
+#include "../core/canvas.h"
+#include "../core/loader.h"
+
+namespace plum
+{
+    enum AssetKind
+    {
+        AssetCanvas,
+        AssetImage,
+        AssetFont,
+        AssetSong,
+    };
+
+    // Something being loaded in the background on behalf of a script.
+    // The state is shared with the loader's job, since the handle can be collected before the job is done.
+    class Asset
+    {
+        public:
+            struct State
+            {
+                // The thread the asset is finished on: the main thread, unless a script is waiting for it.
+                lua_State* L;
+                AssetKind kind;
+                std::string filename;
+                std::string error;
+                Canvas canvas;
+                int valueRef;
+                int callbackRef;
+                bool finished;
+                bool abandoned;
+            };
+
+            std::shared_ptr<State> state;
+            std::shared_ptr<Loader::Request> request;
+    };
+
+    namespace script
+    {
+        template<> const char* meta<Asset>()
+        {
+            return "plum.Asset";
+        }
+    }
+
+    namespace
+    {
+        typedef Asset Self;
+
+        // Runs on a loader thread, so it mustn't touch Lua or the screen.
+        void loadAsset(Asset::State& state)
+        {
+            try
+            {
+                if(state.kind == AssetSong)
+                {
+                    // Songs are streamed from disk by the audio thread, so the best that can be done here
+                    // is reading the file once, so that opening it later doesn't wait on the disk.
+                    File f(state.filename, FileRead);
+                    if(!f.isActive())
+                    {
+                        throw std::runtime_error("Couldn't open song '" + state.filename + "'!\r\n");
+                    }
+                    std::vector<char> buffer(64 * 1024);
+                    while(f.readRaw(buffer.data(), buffer.size()) == buffer.size())
+                    {
+                    }
+                }
+                else
+                {
+                    state.canvas = Canvas::load(state.filename);
+                }
+            }
+            catch(const std::exception& e)
+            {
+                state.error = e.what();
+            }
+        }
+
+        // Runs on the main thread, or in wait(), where the finished asset can be wrapped up for Lua.
+        void finishAsset(Asset::State& state)
+        {
+            auto L = state.L;
+            state.finished = true;
+
+            if(state.error.empty())
+            {
+                try
+                {
+                    switch(state.kind)
+                    {
+                        case AssetCanvas:
+                            script::push(L, new Canvas(std::move(state.canvas)), LUA_NOREF);
+                            break;
+                        case AssetImage:
+                            script::push(L, new Image(state.canvas), LUA_NOREF);
+                            break;
+                        case AssetFont:
+                            script::push(L, new Font(state.canvas), LUA_NOREF);
+                            break;
+                        case AssetSong:
+                        {
+                            Sound sound;
+                            script::instance(L).audio().loadSound(state.filename, true, sound);
+                            auto chan = new Channel();
+                            script::instance(L).audio().loadChannel(sound, *chan);
+                            script::push(L, chan, LUA_NOREF);
+                            break;
+                        }
+                    }
+                }
+                catch(const std::exception& e)
+                {
+                    state.error = e.what();
+                }
+            }
+            state.canvas = Canvas();
+
+            if(!state.error.empty())
+            {
+                lua_pushnil(L);
+            }
+            if(!state.abandoned)
+            {
+                lua_pushvalue(L, -1);
+                state.valueRef = luaL_ref(L, LUA_REGISTRYINDEX);
+            }
+
+            if(state.callbackRef != LUA_NOREF)
+            {
+                lua_rawgeti(L, LUA_REGISTRYINDEX, state.callbackRef);
+                lua_pushvalue(L, -2);
+                if(state.error.empty())
+                {
+                    lua_pushnil(L);
+                }
+                else
+                {
+                    script::push(L, state.error.c_str());
+                }
+                luaL_unref(L, LUA_REGISTRYINDEX, state.callbackRef);
+                state.callbackRef = LUA_NOREF;
+
+                if(lua_pcall(L, 2, 0, 0))
+                {
+                    std::string message(lua_tostring(L, -1));
+                    lua_pop(L, 2);
+                    throw std::runtime_error("Error found in script:\r\n" + message);
+                }
+            }
+            lua_pop(L, 1);
+        }
+
+        int load(lua_State* L, AssetKind kind)
+        {
+            auto filename = script::get<const char*>(L, 1);
+            if(!lua_isnoneornil(L, 2))
+            {
+                luaL_checktype(L, 2, LUA_TFUNCTION);
+            }
+
+            auto state = std::make_shared<Asset::State>();
+            // Jobs finished by the loader go through the main thread, since the coroutine that asked might be long gone.
+            lua_rawgeti(L, LUA_REGISTRYINDEX, LUA_RIDX_MAINTHREAD);
+            state->L = lua_tothread(L, -1);
+            lua_pop(L, 1);
+            state->kind = kind;
+            state->filename = filename;
+            state->valueRef = LUA_NOREF;
+            state->callbackRef = LUA_NOREF;
+            state->finished = false;
+            state->abandoned = false;
+            if(!lua_isnoneornil(L, 2))
+            {
+                lua_pushvalue(L, 2);
+                state->callbackRef = luaL_ref(L, LUA_REGISTRYINDEX);
+            }
+
+            auto asset = new Asset();
+            asset->state = state;
+            asset->request = Loader::current()->queue(
+                [state]() { loadAsset(*state); },
+                [state]() { finishAsset(*state); }
+            );
+            script::push(L, asset, LUA_NOREF);
+            return 1;
+        }
+
+        int loadCanvas(lua_State* L)
+        {
+            return load(L, AssetCanvas);
+        }
+
+        int loadImage(lua_State* L)
+        {
+            return load(L, AssetImage);
+        }
+
+        int loadFont(lua_State* L)
+        {
+            return load(L, AssetFont);
+        }
+
+        int loadSong(lua_State* L)
+        {
+            return load(L, AssetSong);
+        }
+
+        int gc(lua_State* L)
+        {
+            auto asset = script::ptr<Self>(L, 1);
+            auto& state(*asset->state);
+            if(state.finished)
+            {
+                luaL_unref(L, LUA_REGISTRYINDEX, state.valueRef);
+                state.valueRef = LUA_NOREF;
+            }
+            else
+            {
+                // The job still runs its callback, but nobody is left to hold onto the result.
+                state.abandoned = true;
+            }
+            return script::wrapped<Self>(L, 1)->gc(L);
+        }
+
+        int index(lua_State* L)
+        {
+            return script::wrapped<Self>(L, 1)->index(L);
+        }
+
+        int newindex(lua_State* L)
+        {
+            return script::wrapped<Self>(L, 1)->newindex(L);
+        }
+
+        int tostring(lua_State* L)
+        {
+            return script::wrapped<Self>(L, 1)->tostring(L);
+        }
+
+        int isReady(lua_State* L)
+        {
+            auto asset = script::ptr<Self>(L, 1);
+            script::push(L, asset->state->finished);
+            return 1;
+        }
+
+        int get_value(lua_State* L)
+        {
+            auto asset = script::ptr<Self>(L, 1);
+            lua_rawgeti(L, LUA_REGISTRYINDEX, asset->state->valueRef);
+            return 1;
+        }
+
+        int get_error(lua_State* L)
+        {
+            auto asset = script::ptr<Self>(L, 1);
+            if(asset->state->error.empty())
+            {
+                lua_pushnil(L);
+            }
+            else
+            {
+                script::push(L, asset->state->error.c_str());
+            }
+            return 1;
+        }
+
+        int get_filename(lua_State* L)
+        {
+            auto asset = script::ptr<Self>(L, 1);
+            script::push(L, asset->state->filename.c_str());
+            return 1;
+        }
+
+        // Returns the loaded value, or nil and an error message if it couldn't be loaded.
+        int wait(lua_State* L)
+        {
+            auto asset = script::ptr<Self>(L, 1);
+            auto& state(*asset->state);
+            if(!state.finished)
+            {
+                if(auto loader = Loader::current())
+                {
+                    // Finished on the thread that's waiting, since the main thread may be suspended in a coroutine.resume.
+                    auto main = state.L;
+                    state.L = L;
+                    loader->wait(asset->request);
+                    state.L = main;
+                }
+            }
+            get_value(L);
+            get_error(L);
+            return 2;
+        }
+    }
+
+    namespace script
+    {
+        void initAssetObject(lua_State* L)
+        {
+            luaL_newmetatable(L, meta<Self>());
+            // Duplicate the metatable on the stack.
+            lua_pushvalue(L, -1);
+            // metatable.__index = metatable
+            lua_setfield(L, -2, "__index");
+
+            // Put the members into the metatable.
+            const luaL_Reg functions[] = {
+                {"__gc", gc},
+                {"__index", index},
+                {"__newindex", newindex},
+                {"__tostring", tostring},
+                {"isReady", isReady},
+                {"wait", wait},
+                {"get_value", get_value},
+                {"get_error", get_error},
+                {"get_filename", get_filename},
+                {nullptr, nullptr}
+            };
+            luaL_setfuncs(L, functions, 0);
+
+            lua_pop(L, 1);
+
+            // Push plum namespace.
+            lua_getglobal(L, "plum");
+
+            // plum.loadX = <function loadX>
+            const luaL_Reg loaders[] = {
+                {"loadCanvas", loadCanvas},
+                {"loadImage", loadImage},
+                {"loadFont", loadFont},
+                {"loadSong", loadSong},
+                {nullptr, nullptr}
+            };
+            luaL_setfuncs(L, loaders, 0);
+
+            // Pop plum namespace.
+            lua_pop(L, 1);
+        }
+    }
+}
@@ -0,0 +1,66 @@
+#include "../core/audio.h"
+#include "script.h"
+
+namespace plum
+{
+    namespace
+    {
+        template<typename T> void setField(lua_State* L, const char* name, T value)
+        {
+            script::push(L, value);
+            lua_setfield(L, -2, name);
+        }
+
+        int stats(lua_State* L)
+        {
+            auto s = script::instance(L).audio().getStats();
+
+            lua_newtable(L);
+            setField(L, "callbacks", s.callbacks);
+            setField(L, "callbackAverage", s.callbackAverage);
+            setField(L, "callbackLongest", s.callbackLongest);
+            setField(L, "load", s.load);
+            setField(L, "underflows", s.underflows);
+            setField(L, "overflows", s.overflows);
+            setField(L, "lostReports", s.lostReports);
+            setField(L, "mixedVoices", s.mixedVoices);
+            setField(L, "peakVoices", s.peakVoices);
+            setField(L, "activeVoices", s.activeVoices);
+            setField(L, "virtualVoices", s.virtualVoices);
+            setField(L, "pullAverage", s.pullAverage);
+            setField(L, "pullLongest", s.pullLongest);
+            setField(L, "scratchSize", s.scratchSize);
+            setField(L, "scratchPeak", s.scratchPeak);
+            setField(L, "scratchDenied", s.scratchDenied);
+            setField(L, "streamUnderruns", s.streamUnderruns);
+
+            // Indexed from 1, where bucket i counts callbacks under 2^(i-1) microseconds.
+            lua_createtable(L, AudioStats::HistogramSize, 0);
+            for(int i = 0; i < AudioStats::HistogramSize; ++i)
+            {
+                script::push(L, s.callbackHistogram[i]);
+                lua_rawseti(L, -2, i + 1);
+            }
+            lua_setfield(L, -2, "callbackHistogram");
+            return 1;
+        }
+    }
+
+    namespace script
+    {
+        void initAudioModule(lua_State* L)
+        {
+            // Push plum namespace.
+            lua_getglobal(L, "plum");
+
+            // Create audio namespace
+            lua_newtable(L);
+            lua_pushcfunction(L, stats);
+            lua_setfield(L, -2, "stats");
+            lua_setfield(L, -2, "audio");
+
+            // Pop plum namespace.
+            lua_pop(L, 1);
+        }
+    }
+}
@@ -1,5 +1,6 @@
 #include "script.h"
 #include "../core/canvas.h"
+#include "../core/pixelbuffer.h"
 
 namespace plum
 {
@@ -107,6 +108,97 @@ namespace plum
             return 0;
         }
 
+        int getPixels(lua_State* L)
+        {
+            auto canvas = script::ptr<Self>(L, 1);
+            auto x = script::get<int>(L, 2);
+            auto y = script::get<int>(L, 3);
+            auto w = std::max(script::get<int>(L, 4), 0);
+            auto h = std::max(script::get<int>(L, 5), 0);
+            if(!PixelBuffer::fits(w, h))
+            {
+                luaL_error(L, "Attempt to call plum.Canvas:getPixels with a size of %dx%d, which is too large.", w, h);
+                return 0;
+            }
+
+            auto buffer = new PixelBuffer(w, h);
+            canvas->getPixels(x, y, buffer->getWidth(), buffer->getHeight(), buffer->getData());
+            script::push(L, buffer, LUA_NOREF);
+            return 1;
+        }
+
+        int getPixelString(lua_State* L)
+        {
+            auto canvas = script::ptr<Self>(L, 1);
+            auto x = script::get<int>(L, 2);
+            auto y = script::get<int>(L, 3);
+            auto w = std::max(script::get<int>(L, 4), 0);
+            auto h = std::max(script::get<int>(L, 5), 0);
+            if(!PixelBuffer::fits(w, h))
+            {
+                luaL_error(L, "Attempt to call plum.Canvas:getPixelString with a size of %dx%d, which is too large.", w, h);
+                return 0;
+            }
+            size_t size = size_t(w) * size_t(h) * sizeof(Color);
+
+            luaL_Buffer b;
+            auto bytes = (Color*) luaL_buffinitsize(L, &b, size);
+            canvas->getPixels(x, y, w, h, bytes);
+            luaL_pushresultsize(&b, size);
+            return 1;
+        }
+
+        void setPixelBlock(Canvas* canvas, int x, int y, int w, int h, const Color* source, BlendMode mode)
+        {
+            switch(mode)
+            {
+                case BlendOpaque: canvas->setPixels<BlendOpaque>(x, y, w, h, source); break;
+                case BlendMerge: canvas->setPixels<BlendMerge>(x, y, w, h, source); break;
+                case BlendPreserve: canvas->setPixels<BlendPreserve>(x, y, w, h, source); break;
+                case BlendAdd: canvas->setPixels<BlendAdd>(x, y, w, h, source); break;
+                case BlendSubtract: canvas->setPixels<BlendSubtract>(x, y, w, h, source); break;
+            }
+        }
+
+        int setPixels(lua_State* L)
+        {
+            auto canvas = script::ptr<Self>(L, 1);
+            auto x = script::get<int>(L, 2);
+            auto y = script::get<int>(L, 3);
+            auto buffer = script::ptr<PixelBuffer>(L, 4);
+            auto mode = BlendMode(script::get<int>(L, 5, BlendOpaque));
+
+            setPixelBlock(canvas, x, y, buffer->getWidth(), buffer->getHeight(), buffer->getData(), mode);
+            return 0;
+        }
+
+        int setPixelString(lua_State* L)
+        {
+            auto canvas = script::ptr<Self>(L, 1);
+            auto x = script::get<int>(L, 2);
+            auto y = script::get<int>(L, 3);
+            auto w = std::max(script::get<int>(L, 4), 0);
+            auto h = std::max(script::get<int>(L, 5), 0);
+            size_t length;
+            auto bytes = luaL_checklstring(L, 6, &length);
+            auto mode = BlendMode(script::get<int>(L, 7, BlendOpaque));
+
+            if(!PixelBuffer::fits(w, h))
+            {
+                luaL_error(L, "Attempt to call plum.Canvas:setPixelString with a size of %dx%d, which is too large.", w, h);
+                return 0;
+            }
+            size_t expected = size_t(w) * size_t(h) * sizeof(Color);
+            if(length != expected)
+            {
+                luaL_error(L, "Attempt to call plum.Canvas:setPixelString with a string of %d bytes, but a %dx%d region needs %d.",
+                    int(length), w, h, int(expected));
+                return 0;
+            }
+            setPixelBlock(canvas, x, y, w, h, (const Color*) bytes, mode);
+            return 0;
+        }
+
         int clear(lua_State* L)
         {
             auto canvas = script::ptr<Self>(L, 1);
@@ -471,6 +563,10 @@ namespace plum
                 {"setClipRegion", setClipRegion},
                 {"getPixel", getPixel},
                 {"setPixel", setPixel},
+                {"getPixels", getPixels},
+                {"getPixelString", getPixelString},
+                {"setPixels", setPixels},
+                {"setPixelString", setPixelString},
                 {"clear", clear},
                 {"flip", flip},
                 {"replaceColor", replaceColor},
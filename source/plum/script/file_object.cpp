@@ -1,6 +1,12 @@
 
+#include <vector>
+#include <limits>
+#include <cstring>
+#include <algorithm>
+
 #include "script.h"
 #include "../core/file.h"
+#include "../core/archive.h"
 
 namespace plum
 {
@@ -33,9 +39,13 @@ namespace plum
             {
                 mode = FileAppend;
             }
+            else if(modeString[0] == 'm')
+            {
+                mode = FileMap;
+            }
             else
             {
-                luaL_error(L, "Attempt to call plum.File constructor with invalid mode argument (argument #2).\r\nMust be 'r', 'w' or 'a'.");
+                luaL_error(L, "Attempt to call plum.File constructor with invalid mode argument (argument #2).\r\nMust be 'r', 'w', 'a' or 'm'.");
                 return 0;
             }
 
@@ -51,6 +61,33 @@ namespace plum
             return 1;
         }
 
+        int mountArchive(lua_State* L)
+        {
+            auto filename = script::get<const char*>(L, 1);
+            script::push(L, Archive::mount(filename));
+            return 1;
+        }
+
+        // plum.writeArchive(filename, { files... } [, compress = true])
+        int writeArchive(lua_State* L)
+        {
+            auto filename = script::get<const char*>(L, 1);
+            luaL_checktype(L, 2, LUA_TTABLE);
+            auto compress = lua_isnoneornil(L, 3) || script::get<bool>(L, 3);
+
+            std::vector<std::string> files;
+            int count = int(lua_rawlen(L, 2));
+            for(int i = 1; i <= count; ++i)
+            {
+                lua_rawgeti(L, 2, i);
+                files.push_back(script::get<const char*>(L, -1));
+                lua_pop(L, 1);
+            }
+
+            script::push(L, Archive::write(filename, files, compress));
+            return 1;
+        }
+
         int gc(lua_State* L)
         {
             return script::wrapped<Self>(L, 1)->gc(L);
@@ -220,6 +257,16 @@ namespace plum
                 return 0;
             }
 
+            // Files from an archive can go straight into the string, without a read.
+            if(auto data = file->getData())
+            {
+                size_t size = file->getSize();
+                size_t start = std::min<size_t>(pos, size);
+                file->seek(int(size), SeekStart);
+                lua_pushlstring(L, (const char*) data + start, size - start);
+                return 1;
+            }
+
             // Length to read = position of end - current.
             unsigned int length = 0;
             if(!file->seek(pos, SeekEnd))
@@ -242,6 +289,123 @@ namespace plum
             return 0;
         }
 
+        // Limits a count passed in by a script to the records left in the file, before anything is allocated for them.
+        // The result never needs more bytes than the file has left, so it can't overflow once multiplied back out.
+        size_t clampCount(File* file, size_t recordSize, int count)
+        {
+            int position = file->tell();
+            size_t size = file->getSize();
+            size_t remaining = position >= 0 && size_t(position) < size ? size - size_t(position) : 0;
+            return std::min(size_t(count), remaining / recordSize);
+        }
+
+        // file:readU16Array(count) and friends return a table of up to count values, read in one go.
+        template<typename T> int readArray(lua_State* L)
+        {
+            auto file = script::ptr<File>(L, 1);
+            auto count = script::get<int>(L, 2);
+            luaL_argcheck(L, count >= 0, 2, "count can't be negative");
+
+            std::vector<T> values(clampCount(file, sizeof(T), count));
+            size_t read = file->readArray(values.data(), sizeof(T), values.size());
+
+            lua_createtable(L, int(read), 0);
+            for(size_t i = 0; i < read; ++i)
+            {
+                lua_pushnumber(L, lua_Number(values[i]));
+                lua_rawseti(L, -2, int(i + 1));
+            }
+            return 1;
+        }
+
+        // Sizes of the fields that can appear in a readRecords format, or 0 for anything else.
+        size_t fieldSize(char c)
+        {
+            switch(c)
+            {
+                case 'b': case 'B': return 1;
+                case 'h': case 'H': return 2;
+                case 'i': case 'I': case 'f': return 4;
+                case 'd': return 8;
+                default: return 0;
+            }
+        }
+
+        template<typename T> lua_Number decodeField(const uint8_t* p)
+        {
+            T value;
+            std::memcpy(&value, p, sizeof(T));
+            return lua_Number(value);
+        }
+
+        // file:readRecords(format, count) reads count packed records, and returns them as a table of tables.
+        // Each character of the format is one field: b/B = int8/u8, h/H = int16/u16, i/I = int32/u32, f = float, d = double.
+        int readRecords(lua_State* L)
+        {
+            auto file = script::ptr<File>(L, 1);
+            std::string format(script::get<const char*>(L, 2));
+            auto count = script::get<int>(L, 3);
+            luaL_argcheck(L, count >= 0, 3, "count can't be negative");
+
+            size_t recordSize = 0;
+            for(auto it = format.begin(), end = format.end(); it != end; ++it)
+            {
+                auto size = fieldSize(*it);
+                luaL_argcheck(L, size != 0, 2, "format can only contain the characters bBhHiIfd");
+                recordSize += size;
+            }
+            luaL_argcheck(L, recordSize > 0, 2, "format can't be empty");
+
+            size_t records = clampCount(file, recordSize, count);
+            std::vector<uint8_t> bytes(recordSize * records);
+            size_t read = file->readArray(bytes.data(), recordSize, records);
+
+            lua_createtable(L, int(read), 0);
+            const uint8_t* p = bytes.data();
+            for(size_t i = 0; i < read; ++i)
+            {
+                lua_createtable(L, int(format.size()), 0);
+                for(size_t j = 0; j < format.size(); ++j)
+                {
+                    lua_Number value = 0;
+                    switch(format[j])
+                    {
+                        case 'b': value = decodeField<int8_t>(p); break;
+                        case 'B': value = decodeField<uint8_t>(p); break;
+                        case 'h': value = decodeField<int16_t>(p); break;
+                        case 'H': value = decodeField<uint16_t>(p); break;
+                        case 'i': value = decodeField<int32_t>(p); break;
+                        case 'I': value = decodeField<uint32_t>(p); break;
+                        case 'f': value = decodeField<float>(p); break;
+                        case 'd': value = decodeField<double>(p); break;
+                    }
+                    lua_pushnumber(L, value);
+                    lua_rawseti(L, -2, int(j + 1));
+                    p += fieldSize(format[j]);
+                }
+                lua_rawseti(L, -2, int(i + 1));
+            }
+            return 1;
+        }
+
+        // Returns part of a mapped or archived file as a string, without moving the read position.
+        int view(lua_State* L)
+        {
+            auto file = script::ptr<File>(L, 1);
+            auto offset = script::get<int>(L, 2);
+            auto length = script::get<int>(L, 3);
+
+            if(offset >= 0 && length >= 0)
+            {
+                if(auto data = file->view(offset, length))
+                {
+                    lua_pushlstring(L, (const char*) data, length);
+                    return 1;
+                }
+            }
+            return 0;
+        }
+
         int writeU8(lua_State* L)
         {
             auto file = script::ptr<File>(L, 1);
@@ -314,6 +478,38 @@ namespace plum
             return 1;
         }
 
+        // file:writeU16Array(values) and friends write a whole table of values in one go.
+        template<typename T> int writeArray(lua_State* L)
+        {
+            auto file = script::ptr<File>(L, 1);
+            luaL_checktype(L, 2, LUA_TTABLE);
+
+            std::vector<T> values(lua_rawlen(L, 2));
+            for(size_t i = 0; i < values.size(); ++i)
+            {
+                lua_rawgeti(L, 2, int(i + 1));
+                values[i] = std::numeric_limits<T>::is_integer ? T(lua_tointeger(L, -1)) : T(lua_tonumber(L, -1));
+                lua_pop(L, 1);
+            }
+
+            script::push(L, file->writeArray(values.data(), sizeof(T), values.size()) == values.size());
+            return 1;
+        }
+
+        int flush(lua_State* L)
+        {
+            auto file = script::ptr<File>(L, 1);
+            script::push(L, file->flush());
+            return 1;
+        }
+
+        int get_size(lua_State* L)
+        {
+            auto file = script::ptr<File>(L, 1);
+            script::push(L, int(file->getSize()));
+            return 1;
+        }
+
         int writeString(lua_State* L)
         {
             auto file = script::ptr<File>(L, 1);
@@ -363,6 +559,16 @@ namespace plum
                 {"readString", readString},
                 {"readLine", readLine},
                 {"readFully", readFully},
+                {"readU8Array", readArray<uint8_t>},
+                {"readU16Array", readArray<uint16_t>},
+                {"readU32Array", readArray<uint32_t>},
+                {"readInt8Array", readArray<int8_t>},
+                {"readInt16Array", readArray<int16_t>},
+                {"readInt32Array", readArray<int32_t>},
+                {"readFloatArray", readArray<float>},
+                {"readDoubleArray", readArray<double>},
+                {"readRecords", readRecords},
+                {"view", view},
                 {"writeU8", writeU8},
                 {"writeU16", writeU16},
                 {"writeU32", writeU32},
@@ -373,6 +579,16 @@ namespace plum
                 {"writeDouble", writeDouble},
                 {"writeString", writeString},
                 {"writeLine", writeLine},
+                {"writeU8Array", writeArray<uint8_t>},
+                {"writeU16Array", writeArray<uint16_t>},
+                {"writeU32Array", writeArray<uint32_t>},
+                {"writeInt8Array", writeArray<int8_t>},
+                {"writeInt16Array", writeArray<int16_t>},
+                {"writeInt32Array", writeArray<int32_t>},
+                {"writeFloatArray", writeArray<float>},
+                {"writeDoubleArray", writeArray<double>},
+                {"flush", flush},
+                {"get_size", get_size},
                 {nullptr, nullptr},
             };
             luaL_setfuncs(L, functions, 0);
@@ -387,6 +603,16 @@ namespace plum
             lua_pushcfunction(L, create);
             lua_settable(L, -3);
 
+            // plum.mountArchive = <function mountArchive>
+            script::push(L, "mountArchive");
+            lua_pushcfunction(L, mountArchive);
+            lua_settable(L, -3);
+
+            // plum.writeArchive = <function writeArchive>
+            script::push(L, "writeArchive");
+            lua_pushcfunction(L, writeArchive);
+            lua_settable(L, -3);
+
             // Pop plum namespace.
             lua_pop(L, 1);
         }
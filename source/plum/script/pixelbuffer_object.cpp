@@ -0,0 +1,215 @@
+#include <cstring>
+
+#include "../core/pixelbuffer.h"
+#include "script.h"
+
+namespace plum
+{
+    namespace script
+    {
+        template<> const char* meta<PixelBuffer>()
+        {
+            return "plum.PixelBuffer";
+        }
+    }
+
+    namespace
+    {
+        typedef PixelBuffer Self;
+
+        int create(lua_State* L)
+        {
+            auto w = std::max(script::get<int>(L, 1), 0);
+            auto h = std::max(script::get<int>(L, 2), 0);
+            if(!PixelBuffer::fits(w, h))
+            {
+                luaL_error(L, "Attempt to call plum.PixelBuffer constructor with a size of %dx%d, which is too large.", w, h);
+                return 0;
+            }
+            size_t expected = size_t(w) * size_t(h) * sizeof(Color);
+
+            // Every argument is checked before the buffer exists, since an error here jumps straight out without unwinding.
+            const char* bytes = nullptr;
+            Color color(0);
+            if(lua_type(L, 3) == LUA_TSTRING)
+            {
+                size_t length;
+                bytes = lua_tolstring(L, 3, &length);
+                if(length != expected)
+                {
+                    luaL_error(L, "Attempt to call plum.PixelBuffer constructor with a string of %d bytes, but a %dx%d buffer needs %d.",
+                        int(length), w, h, int(expected));
+                    return 0;
+                }
+            }
+            else
+            {
+                color = Color(script::get<int>(L, 3, 0));
+            }
+
+            auto buffer = new PixelBuffer(w, h);
+            if(bytes)
+            {
+                if(expected)
+                {
+                    std::memcpy(buffer->getData(), bytes, expected);
+                }
+            }
+            else
+            {
+                buffer->fill(color);
+            }
+
+            script::push(L, buffer, LUA_NOREF);
+            return 1;
+        }
+
+        int gc(lua_State* L)
+        {
+            return script::wrapped<Self>(L, 1)->gc(L);
+        }
+
+        int index(lua_State* L)
+        {
+            return script::wrapped<Self>(L, 1)->index(L);
+        }
+
+        int newindex(lua_State* L)
+        {
+            return script::wrapped<Self>(L, 1)->newindex(L);
+        }
+
+        int tostring(lua_State* L)
+        {
+            return script::wrapped<Self>(L, 1)->tostring(L);
+        }
+
+        int len(lua_State* L)
+        {
+            auto buffer = script::ptr<Self>(L, 1);
+            script::push(L, buffer->getSize());
+            return 1;
+        }
+
+        int getColor(lua_State* L)
+        {
+            auto buffer = script::ptr<Self>(L, 1);
+            auto x = script::get<int>(L, 2);
+            auto y = script::get<int>(L, 3);
+            script::push(L, int(buffer->get(x, y)));
+            return 1;
+        }
+
+        int setColor(lua_State* L)
+        {
+            auto buffer = script::ptr<Self>(L, 1);
+            auto x = script::get<int>(L, 2);
+            auto y = script::get<int>(L, 3);
+            auto color = Color(script::get<int>(L, 4));
+            buffer->set(x, y, color);
+            return 0;
+        }
+
+        int fill(lua_State* L)
+        {
+            auto buffer = script::ptr<Self>(L, 1);
+            auto color = Color(script::get<int>(L, 2));
+            buffer->fill(color);
+            return 0;
+        }
+
+        int toString(lua_State* L)
+        {
+            auto buffer = script::ptr<Self>(L, 1);
+            lua_pushlstring(L, (const char*) buffer->getData(), buffer->getSize() * sizeof(Color));
+            return 1;
+        }
+
+        // Calls fn(color, x, y) on every pixel, row by row.
+        // If it returns a number, that becomes the pixel's new color.
+        int map(lua_State* L)
+        {
+            auto buffer = script::ptr<Self>(L, 1);
+            luaL_checktype(L, 2, LUA_TFUNCTION);
+
+            auto data = buffer->getData();
+            int w = buffer->getWidth();
+            int h = buffer->getHeight();
+            for(int y = 0; y < h; ++y)
+            {
+                auto row = data + y * w;
+                for(int x = 0; x < w; ++x)
+                {
+                    lua_pushvalue(L, 2);
+                    lua_pushinteger(L, int(row[x]));
+                    lua_pushinteger(L, x);
+                    lua_pushinteger(L, y);
+                    lua_call(L, 3, 1);
+                    if(lua_type(L, -1) == LUA_TNUMBER)
+                    {
+                        row[x] = Color(uint32_t(lua_tointeger(L, -1)));
+                    }
+                    lua_pop(L, 1);
+                }
+            }
+            return 0;
+        }
+
+        int get_width(lua_State* L)
+        {
+            auto buffer = script::ptr<Self>(L, 1);
+            script::push(L, buffer->getWidth());
+            return 1;
+        }
+
+        int get_height(lua_State* L)
+        {
+            auto buffer = script::ptr<Self>(L, 1);
+            script::push(L, buffer->getHeight());
+            return 1;
+        }
+    }
+
+    namespace script
+    {
+        void initPixelBufferObject(lua_State* L)
+        {
+            luaL_newmetatable(L, meta<Self>());
+            // Duplicate the metatable on the stack.
+            lua_pushvalue(L, -1);
+            // metatable.__index = metatable
+            lua_setfield(L, -2, "__index");
+
+            // Put the members into the metatable.
+            const luaL_Reg functions[] = {
+                {"__gc", gc},
+                {"__index", index},
+                {"__newindex", newindex},
+                {"__tostring", tostring},
+                {"__len", len},
+                {"get", getColor},
+                {"set", setColor},
+                {"fill", fill},
+                {"toString", toString},
+                {"map", map},
+                {"get_width", get_width},
+                {"get_height", get_height},
+                {nullptr, nullptr}
+            };
+            luaL_setfuncs(L, functions, 0);
+
+            lua_pop(L, 1);
+
+            // Push plum namespace.
+            lua_getglobal(L, "plum");
+
+            // plum[classname] = create
+            script::push(L, "PixelBuffer");
+            lua_pushcfunction(L, create);
+            lua_settable(L, -3);
+
+            // Pop plum namespace.
+            lua_pop(L, 1);
+        }
+    }
+}
@@ -183,6 +183,8 @@ namespace plum
             // Load all the submodule and object definitions contained within Plum.
             initVideoModule(L);
             initTimerModule(L);
+            initAudioModule(L);
+            initProfileModule(L);
 
             initInputObject(L);
             initKeyboardModule(L);
@@ -193,6 +195,7 @@ namespace plum
             initSongObject(L);
             initFileObject(L);
             initCanvasObject(L);
+            initPixelBufferObject(L);
             initPointObject(L);
             initRectObject(L);
             initTransformObject(L);
@@ -200,6 +203,8 @@ namespace plum
             initSpriteObject(L);
             initFontObject(L);
             initTilemapObject(L);
+            initSpatialHashObject(L);
+            initAssetObject(L);
         }
     }
 }
\ No newline at end of file
@@ -50,36 +50,6 @@ namespace plum
             return 1;
         }
 
-        int get_x(lua_State* L)
-        {
-            auto p = script::ptr<Point>(L, 1);
-            script::push(L, p->x);
-            return 1;
-        }
-
-        int get_y(lua_State* L)
-        {
-            auto p = script::ptr<Point>(L, 1);
-            script::push(L, p->y);
-            return 1;
-        }
-
-        int set_x(lua_State* L)
-        {
-            auto p = script::ptr<Point>(L, 1);
-            auto val = script::get<double>(L, 2);
-            p->x = val;
-            return 0;
-        }
-
-        int set_y(lua_State* L)
-        {
-            auto p = script::ptr<Point>(L, 1);
-            auto val = script::get<double>(L, 2);
-            p->y = val;
-            return 0;
-        }
-
         int setPoint(lua_State* L)
         {
             auto p = script::ptr<Point>(L, 1);
@@ -108,10 +78,10 @@ namespace plum
                 {"__index", index},
                 {"__newindex", newindex},
                 {"__tostring", tostring},
-                {"get_x", get_x},
-                {"get_y", get_y},
-                {"set_x", set_x},
-                {"set_y", set_y},
+                {"get_x", script::FieldAccessor<Self, double, &Self::x>::get},
+                {"get_y", script::FieldAccessor<Self, double, &Self::y>::get},
+                {"set_x", script::FieldAccessor<Self, double, &Self::x>::set},
+                {"set_y", script::FieldAccessor<Self, double, &Self::y>::set},
                 {"setPoint", setPoint},
                 {nullptr, nullptr},
             };
@@ -0,0 +1,73 @@
+#include "../core/profile.h"
+#include "script.h"
+
+namespace plum
+{
+    namespace
+    {
+        int begin(lua_State* L)
+        {
+            profile::begin(script::get<int>(L, 1, profile::DefaultCapacity));
+            return 0;
+        }
+
+        // Returns the number of zones written, or nil if the file couldn't be written.
+        int finish(lua_State* L)
+        {
+            int zones = profile::finish(script::get<const char*>(L, 1));
+            if(zones < 0)
+            {
+                lua_pushnil(L);
+            }
+            else
+            {
+                script::push(L, zones);
+            }
+            return 1;
+        }
+
+        int active(lua_State* L)
+        {
+            script::push(L, bool(profile::active));
+            return 1;
+        }
+
+        // Totals for the last complete frame, whether or not a capture is running.
+        int counters(lua_State* L)
+        {
+            lua_newtable(L);
+            script::push(L, double(profile::getCounter(profile::CounterDrawCalls)));
+            lua_setfield(L, -2, "drawCalls");
+            script::push(L, double(profile::getCounter(profile::CounterTextureBinds)));
+            lua_setfield(L, -2, "textureBinds");
+            script::push(L, double(profile::getCounter(profile::CounterUploadBytes)));
+            lua_setfield(L, -2, "uploadBytes");
+            return 1;
+        }
+
+        const luaL_Reg functions[] = {
+            { "begin", begin },
+            { "finish", finish },
+            { "active", active },
+            { "counters", counters },
+            { nullptr, nullptr }
+        };
+    }
+
+    namespace script
+    {
+        void initProfileModule(lua_State* L)
+        {
+            // Push plum namespace.
+            lua_getglobal(L, "plum");
+
+            // Create profile namespace
+            lua_newtable(L);
+            luaL_setfuncs(L, functions, 0);
+            lua_setfield(L, -2, "profile");
+
+            // Pop plum namespace.
+            lua_pop(L, 1);
+        }
+    }
+}
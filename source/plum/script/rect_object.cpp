@@ -52,20 +52,6 @@ namespace plum
             return 1;
         }
 
-        int get_x(lua_State* L)
-        {
-            auto r = script::ptr<Self>(L, 1);
-            script::push(L, r->x);
-            return 1;
-        }
-
-        int get_y(lua_State* L)
-        {
-            auto r = script::ptr<Self>(L, 1);
-            script::push(L, r->y);
-            return 1;
-        }
-
         int get_x2(lua_State* L)
         {
             auto r = script::ptr<Self>(L, 1);
@@ -80,36 +66,6 @@ namespace plum
             return 1;
         }
 
-        int get_width(lua_State* L)
-        {
-            auto r = script::ptr<Self>(L, 1);
-            script::push(L, r->width);
-            return 1;
-        }
-
-        int get_height(lua_State* L)
-        {
-            auto r = script::ptr<Self>(L, 1);
-            script::push(L, r->height);
-            return 1;
-        }
-
-        int set_x(lua_State* L)
-        {
-            auto r = script::ptr<Self>(L, 1);
-            auto val = script::get<double>(L, 2);
-            r->x = val;
-            return 0;
-        }
-
-        int set_y(lua_State* L)
-        {
-            auto r = script::ptr<Self>(L, 1);
-            auto val = script::get<double>(L, 2);
-            r->y = val;
-            return 0;
-        }
-
         int set_x2(lua_State* L)
         {
             auto r = script::ptr<Self>(L, 1);
@@ -126,22 +82,6 @@ namespace plum
             return 0;
         }
 
-        int set_width(lua_State* L)
-        {
-            auto r = script::ptr<Self>(L, 1);
-            auto val = script::get<double>(L, 2);
-            r->width = val;
-            return 1;
-        }
-
-        int set_height(lua_State* L)
-        {
-            auto r = script::ptr<Self>(L, 1);
-            auto val = script::get<double>(L, 2);
-            r->height = val;
-            return 1;
-        }
-
         int setOrigin(lua_State* L)
         {
             auto r = script::ptr<Self>(L, 1);
@@ -216,18 +156,18 @@ namespace plum
                 {"__index", index},
                 {"__newindex", newindex},
                 {"__tostring", tostring},
-                {"get_x", get_x},
-                {"get_y", get_y},
+                {"get_x", script::FieldAccessor<Self, double, &Self::x>::get},
+                {"get_y", script::FieldAccessor<Self, double, &Self::y>::get},
                 {"get_x2", get_x2},
                 {"get_y2", get_y2},
-                {"get_width", get_width},
-                {"get_height", get_height},
-                {"set_x", set_x},
-                {"set_y", set_y},
+                {"get_width", script::FieldAccessor<Self, double, &Self::width>::get},
+                {"get_height", script::FieldAccessor<Self, double, &Self::height>::get},
+                {"set_x", script::FieldAccessor<Self, double, &Self::x>::set},
+                {"set_y", script::FieldAccessor<Self, double, &Self::y>::set},
                 {"set_x2", set_x2},
                 {"set_y2", set_y2},
-                {"set_width", set_width},
-                {"set_height", set_height},
+                {"set_width", script::FieldAccessor<Self, double, &Self::width>::set},
+                {"set_height", script::FieldAccessor<Self, double, &Self::height>::set},
                 {"setOrigin", setOrigin},
                 {"setSize", setSize},
                 {"setRegion", setRegion},
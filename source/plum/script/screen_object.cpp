@@ -10,39 +10,30 @@ namespace plum
         int index(lua_State* L)
         {
             luaL_checkudata(L, 1, Meta);
-            std::string fieldName(script::get<const char*>(L, 2));
-            if(luaL_getmetafield(L, 1, std::string("get_" + fieldName).c_str()))
-            {
-                lua_pushvalue(L, 1);
-                lua_call(L, 1, 1);
-                return 1;
-            }
-            return luaL_getmetafield(L, 1, fieldName.c_str());
+            return script::indexProperty(L);
         }
 
         int newindex(lua_State* L)
         {
             luaL_checkudata(L, 1, Meta);
-            std::string fieldName(script::get<const char*>(L, 2));
             /* L, 3 is the value to set. */
-            if(luaL_getmetafield(L, 1, std::string("set_" + fieldName).c_str()))
+            if(auto setter = script::findSetter(L))
             {
-                lua_pushvalue(L, 1);
-                lua_pushvalue(L, 3);
-                lua_call(L, 2, 0);
+                lua_remove(L, 2);
+                lua_settop(L, 2);
+                setter(L);
                 return 0;
             }
-            if(luaL_getmetafield(L, 1, std::string("get_" + fieldName).c_str()))
+            const char* fieldName = lua_tostring(L, 2);
+            if(script::findGetter(L))
             {
-                luaL_error(L, "Attempt to modify readonly field '%s' on plum_video.", fieldName.c_str());
-                lua_pop(L, 1);
+                luaL_error(L, "Attempt to modify readonly field '%s' on plum_video.", fieldName);
                 return 0;
             }
-            luaL_error(L, "Attempt to modify unknown field '%s' on plum_video.", fieldName.c_str());
+            luaL_error(L, "Attempt to modify unknown field '%s' on plum_video.", fieldName);
             return 0;
         }
 
-
         int tostring(lua_State* L)
         {
             luaL_checkudata(L, 1, Meta);
@@ -1,5 +1,7 @@
 #include <vector>
-#include <unordered_map>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
 #include "../core/file.h"
 #include "../core/engine.h"
@@ -9,11 +11,99 @@ namespace plum
 {
     namespace
     {
-        std::unordered_map<lua_State*, Script*> instances;
+        // Same allocator and panic handler as luaL_newstate. The allocator's userdata pointer
+        // is the Script, since it's the only per-state slot that coroutines share with the main thread.
+        void* allocate(void* ud, void* ptr, size_t oldSize, size_t newSize)
+        {
+            if(newSize == 0)
+            {
+                free(ptr);
+                return nullptr;
+            }
+            return realloc(ptr, newSize);
+        }
+
+        int panic(lua_State* L)
+        {
+            fprintf(stderr, "PANIC: unprotected error in call to Lua API (%s)\n", lua_tostring(L, -1));
+            return 0;
+        }
+
+        lua_State* createState(Script* script)
+        {
+            auto L = lua_newstate(allocate, script);
+            if(L)
+            {
+                lua_atpanic(L, panic);
+            }
+            return L;
+        }
+
+        // Integer keys in an object's metatable, where its property tables live.
+        enum
+        {
+            GetterTable = 1,
+            SetterTable = 2,
+        };
+
+        // Splits the get_/set_ entries of the metatable at the given index into the property tables.
+        void buildPropertyTables(lua_State* L, int metatable)
+        {
+            lua_createtable(L, 0, 8);
+            lua_createtable(L, 0, 8);
+            lua_pushnil(L);
+            while(lua_next(L, metatable))
+            {
+                // Only look at string keys, since lua_tostring would change a number key under lua_next.
+                if(lua_type(L, -2) == LUA_TSTRING && lua_tocfunction(L, -1))
+                {
+                    // Stack is: getters, setters, key, value.
+                    auto name = lua_tostring(L, -2);
+                    int table = 0;
+                    if(!strncmp(name, "get_", 4))
+                    {
+                        table = -4;
+                    }
+                    else if(!strncmp(name, "set_", 4))
+                    {
+                        table = -3;
+                    }
+                    if(table)
+                    {
+                        lua_pushstring(L, name + 4);
+                        lua_pushvalue(L, -2);
+                        lua_rawset(L, table - 2);
+                    }
+                }
+                lua_pop(L, 1);
+            }
+            lua_rawseti(L, metatable, SetterTable);
+            lua_rawseti(L, metatable, GetterTable);
+        }
+
+        lua_CFunction findAccessor(lua_State* L, int kind)
+        {
+            lua_CFunction f = nullptr;
+            if(lua_getmetatable(L, 1))
+            {
+                lua_rawgeti(L, -1, kind);
+                if(lua_isnil(L, -1))
+                {
+                    lua_pop(L, 1);
+                    buildPropertyTables(L, lua_gettop(L));
+                    lua_rawgeti(L, -1, kind);
+                }
+                lua_pushvalue(L, 2);
+                lua_rawget(L, -2);
+                f = lua_tocfunction(L, -1);
+                lua_pop(L, 3);
+            }
+            return f;
+        }
     }
 
     Script::Script(Engine& engine, Timer& timer, Keyboard& keyboard, Mouse& mouse, Audio& audio, Screen& screen)
-        : L(luaL_newstate()),
+        : L(createState(this)),
         engine_(engine),
         timer_(timer),
         keyboard_(keyboard),
@@ -25,10 +115,6 @@ namespace plum
 
         lua_gc(L, LUA_GCSETSTEPMUL, 400);
 
-        // Allow the static script methods to be able to use instance variables,
-        // by looking up with the lua_State.
-        instances[L] = this;
-
         // Load library functions.
         script::initLibrary(L);
 
@@ -62,7 +148,6 @@ namespace plum
     Script::~Script()
     {
         lua_close(L);
-        instances.erase(L);
     }
 
     void Script::run(const std::string& filename)
@@ -91,7 +176,50 @@ namespace plum
     {
         Script& instance(lua_State* L)
         {
-            return *instances[L];
+            // Allow the static script methods to be able to use instance variables.
+            void* ud = nullptr;
+            lua_getallocf(L, &ud);
+            return *(Script*) ud;
+        }
+
+        lua_CFunction findGetter(lua_State* L)
+        {
+            return findAccessor(L, GetterTable);
+        }
+
+        lua_CFunction findSetter(lua_State* L)
+        {
+            return findAccessor(L, SetterTable);
+        }
+
+        int indexProperty(lua_State* L)
+        {
+            if(auto getter = findGetter(L))
+            {
+                lua_settop(L, 1);
+                return getter(L);
+            }
+            // Not a property, so try for a method instead. Only string keys, since the metatable's
+            // integer keys hold the property tables.
+            if(lua_type(L, 2) == LUA_TSTRING && lua_getmetatable(L, 1))
+            {
+                lua_pushvalue(L, 2);
+                lua_rawget(L, -2);
+                return 1;
+            }
+            return 0;
+        }
+
+        int newindexProperty(lua_State* L)
+        {
+            /* L, 3 is the value to set. */
+            if(auto setter = findSetter(L))
+            {
+                lua_remove(L, 2);
+                lua_settop(L, 2);
+                setter(L);
+            }
+            return 0;
         }
     }
 }
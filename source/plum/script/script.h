@@ -76,6 +76,17 @@ namespace plum
     {
         Script& instance(lua_State* L);
 
+        // Properties on wrapped objects are the get_<name> and set_<name> functions in the metatable.
+        // These are gathered once per metatable into lookup tables keyed by <name>, so that a field access
+        // is a raw lookup on the interned key string, followed by a direct call into the accessor.
+        // All of these expect the object at index 1 and the key at index 2.
+        lua_CFunction findGetter(lua_State* L);
+        lua_CFunction findSetter(lua_State* L);
+        int indexProperty(lua_State* L);
+        int newindexProperty(lua_State* L);
+
+        template<typename T> const char* meta();
+
         template<typename T> struct Wrapper
         {
             T* data;
@@ -138,28 +149,12 @@ namespace plum
 
             int index(lua_State* L)
             {
-                std::string fieldName(get<const char*>(L, 2));
-                if(luaL_getmetafield(L, 1, std::string("get_" + fieldName).c_str()))
-                {
-                    lua_pushvalue(L, 1);
-                    lua_call(L, 1, 1);
-                    return 1;
-                }
-                return luaL_getmetafield(L, 1, fieldName.c_str());
+                return indexProperty(L);
             }
 
             int newindex(lua_State* L)
             {
-                std::string fieldName(get<const char*>(L, 2));
-                /* L, 3 is the value to set. */
-                if(luaL_getmetafield(L, 1, std::string("set_" + fieldName).c_str()))
-                {
-                    lua_pushvalue(L, 1);
-                    lua_pushvalue(L, 3);
-                    lua_call(L, 2, 0);
-                    return 0;
-                }
-                return 0;
+                return newindexProperty(L);
             }
 
             int tostring(lua_State* L)
@@ -169,7 +164,6 @@ namespace plum
             }
         };
 
-        template<typename T> const char* meta();
         template<typename T> T get(lua_State* L, int index);
         template<typename T> T get(lua_State* L, int index, T fallback);
         template<typename T> T push(lua_State* L, T value);
@@ -354,10 +348,45 @@ namespace plum
             return w;
         }
 
+        // Accessors for a plain data member, with the argument conversions picked at compile time.
+        // eg. {"get_x", script::FieldAccessor<Rect, double, &Rect::x>::get}
+        template<typename T, typename V, V T::*Field> struct FieldAccessor
+        {
+            static int get(lua_State* L)
+            {
+                push(L, ptr<T>(L, 1)->*Field);
+                return 1;
+            }
+
+            static int set(lua_State* L)
+            {
+                ptr<T>(L, 1)->*Field = script::get<V>(L, 2);
+                return 0;
+            }
+        };
+
+        // Same as FieldAccessor, but going through a getter/setter pair on the object.
+        template<typename T, typename V, V (T::*Get)() const, void (T::*Set)(V)> struct PropertyAccessor
+        {
+            static int get(lua_State* L)
+            {
+                push(L, (ptr<T>(L, 1)->*Get)());
+                return 1;
+            }
+
+            static int set(lua_State* L)
+            {
+                (ptr<T>(L, 1)->*Set)(script::get<V>(L, 2));
+                return 0;
+            }
+        };
+
         void initLibrary(lua_State* L);
 
         void initVideoModule(lua_State* L);
         void initTimerModule(lua_State* L);
+        void initAudioModule(lua_State* L);
+        void initProfileModule(lua_State* L);
 
         void initInputObject(lua_State* L);
         void initKeyboardModule(lua_State* L);
@@ -368,6 +397,7 @@ namespace plum
         void initSongObject(lua_State* L);
         void initFileObject(lua_State* L);
         void initCanvasObject(lua_State* L);
+        void initPixelBufferObject(lua_State* L);
         void initPointObject(lua_State* L);
         void initRectObject(lua_State* L);
         void initTransformObject(lua_State* L);
@@ -375,6 +405,8 @@ namespace plum
         void initSpriteObject(lua_State* L);
         void initFontObject(lua_State* L);
         void initTilemapObject(lua_State* L);
+        void initSpatialHashObject(lua_State* L);
+        void initAssetObject(lua_State* L);
     }
 
 }
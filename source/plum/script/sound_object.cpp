@@ -73,6 +73,10 @@ namespace plum
                 {"__tostring", tostring},
                 {"__gc", gc},
                 {"play", play},
+                {"get_priority", script::PropertyAccessor<Self, int, &Self::getPriority, &Self::setPriority>::get},
+                {"set_priority", script::PropertyAccessor<Self, int, &Self::getPriority, &Self::setPriority>::set},
+                {"get_maxInstances", script::PropertyAccessor<Self, int, &Self::getMaxInstances, &Self::setMaxInstances>::get},
+                {"set_maxInstances", script::PropertyAccessor<Self, int, &Self::getMaxInstances, &Self::setMaxInstances>::set},
                 {nullptr, nullptr}
             };
             luaL_setfuncs(L, functions, 0);
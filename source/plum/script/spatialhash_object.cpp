@@ -0,0 +1,390 @@
+#include "../core/spatialhash.h"
+#include "script.h"
+
+namespace plum
+{
+    namespace script
+    {
+        template<> const char* meta<SpatialHash>()
+        {
+            return "plum.SpatialHash";
+        }
+    }
+
+    namespace
+    {
+        typedef SpatialHash Self;
+
+        // Scripts add their own values, which are found by handle in one attribute table and by value in the other.
+        enum
+        {
+            ValuesAttribute = 1,
+            HandlesAttribute = 2
+        };
+
+        // Reused between queries, so a query every frame doesn't allocate.
+        std::vector<int> found;
+        std::vector<std::pair<int, int>> pairs;
+
+        int create(lua_State* L)
+        {
+            auto cellSize = script::get<double>(L, 1, SpatialHash::DefaultCellSize);
+            if(!(cellSize > 0))
+            {
+                luaL_error(L, "Attempt to call plum.SpatialHash constructor with a cell size of %f.\r\nMust be greater than zero.", cellSize);
+            }
+            script::push(L, new Self(cellSize), LUA_NOREF);
+            return 1;
+        }
+
+        int gc(lua_State* L)
+        {
+            return script::wrapped<Self>(L, 1)->gc(L);
+        }
+
+        int index(lua_State* L)
+        {
+            return script::wrapped<Self>(L, 1)->index(L);
+        }
+
+        int newindex(lua_State* L)
+        {
+            return script::wrapped<Self>(L, 1)->newindex(L);
+        }
+
+        int tostring(lua_State* L)
+        {
+            return script::wrapped<Self>(L, 1)->tostring(L);
+        }
+
+        // False for infinities and NaN, which would put an entry in no sensible cell.
+        bool isFinite(double value)
+        {
+            return value - value == 0;
+        }
+
+        void checkFinite(lua_State* L, const char* name, double x, double y)
+        {
+            if(!isFinite(x) || !isFinite(y))
+            {
+                luaL_error(L, "Attempt to call plum.SpatialHash:%s with values of (%f, %f).\r\nMust be finite.", name, x, y);
+            }
+        }
+
+        // Reads either a plum.Rect or four numbers starting at the index.
+        Rect checkRect(lua_State* L, int index, const char* name)
+        {
+            Rect rect;
+            if(script::is<Rect>(L, index))
+            {
+                rect = *script::ptr<Rect>(L, index);
+            }
+            else
+            {
+                auto x = script::get<double>(L, index);
+                auto y = script::get<double>(L, index + 1);
+                auto w = script::get<double>(L, index + 2);
+                auto h = script::get<double>(L, index + 3);
+                rect = Rect(x, y, w, h);
+            }
+            checkFinite(L, name, rect.x, rect.y);
+            checkFinite(L, name, rect.width, rect.height);
+            return rect;
+        }
+
+        // The handle for the value at the index, or InvalidHandle if it was never added.
+        int findHandle(lua_State* L, int index)
+        {
+            auto w = script::wrapped<Self>(L, 1);
+            lua_pushvalue(L, index);
+            w->getAttribute(L, HandlesAttribute);
+            int handle = SpatialHash::InvalidHandle;
+            if(lua_istable(L, -1))
+            {
+                lua_pushvalue(L, -2);
+                lua_rawget(L, -2);
+                if(lua_isnumber(L, -1))
+                {
+                    handle = (int) lua_tointeger(L, -1);
+                }
+                lua_pop(L, 1);
+            }
+            lua_pop(L, 2);
+            return handle;
+        }
+
+        // Pushes one of the attribute tables, creating it on first use.
+        void pushTable(lua_State* L, int key)
+        {
+            auto w = script::wrapped<Self>(L, 1);
+            w->getAttribute(L, key);
+            if(!lua_istable(L, -1))
+            {
+                lua_pop(L, 1);
+                lua_newtable(L);
+                w->setAttribute(L, key);
+            }
+        }
+
+        // Uses the table at the index if one was passed, or a new one, and leaves it on top of the stack.
+        // Old entries past the end of the new results are cleared.
+        void pushResults(lua_State* L, int index, const std::vector<int>& handles)
+        {
+            if(lua_istable(L, index))
+            {
+                lua_pushvalue(L, index);
+            }
+            else
+            {
+                lua_createtable(L, int(handles.size()), 0);
+            }
+            int results = lua_gettop(L);
+
+            pushTable(L, ValuesAttribute);
+            int i = 1;
+            for(auto it = handles.begin(), end = handles.end(); it != end; ++it, ++i)
+            {
+                lua_rawgeti(L, -1, *it + 1);
+                lua_rawseti(L, results, i);
+            }
+            lua_pop(L, 1);
+
+            for(;; ++i)
+            {
+                lua_rawgeti(L, results, i);
+                bool empty = lua_isnil(L, -1) != 0;
+                lua_pop(L, 1);
+                if(empty)
+                {
+                    break;
+                }
+                lua_pushnil(L);
+                lua_rawseti(L, results, i);
+            }
+        }
+
+        int get_count(lua_State* L)
+        {
+            auto h = script::ptr<Self>(L, 1);
+            script::push(L, h->getCount());
+            return 1;
+        }
+
+        int get_cellSize(lua_State* L)
+        {
+            auto h = script::ptr<Self>(L, 1);
+            script::push(L, h->getCellSize());
+            return 1;
+        }
+
+        int len(lua_State* L)
+        {
+            auto h = script::ptr<Self>(L, 1);
+            script::push(L, h->getCount());
+            return 1;
+        }
+
+        // add(value, rect) or add(value, x, y, w, h). Adding a value that's already there moves it instead.
+        int add(lua_State* L)
+        {
+            auto h = script::ptr<Self>(L, 1);
+            luaL_checkany(L, 2);
+            if(lua_isnil(L, 2))
+            {
+                luaL_error(L, "Attempt to call plum.SpatialHash:add with a nil value.");
+            }
+            auto rect = checkRect(L, 3, "add");
+
+            int handle = findHandle(L, 2);
+            if(handle != SpatialHash::InvalidHandle)
+            {
+                h->update(handle, rect);
+                return 0;
+            }
+
+            handle = h->insert(rect);
+            pushTable(L, ValuesAttribute);
+            lua_pushvalue(L, 2);
+            lua_rawseti(L, -2, handle + 1);
+            lua_pop(L, 1);
+
+            pushTable(L, HandlesAttribute);
+            lua_pushvalue(L, 2);
+            lua_pushinteger(L, handle);
+            lua_rawset(L, -3);
+            lua_pop(L, 1);
+            return 0;
+        }
+
+        int update(lua_State* L)
+        {
+            auto h = script::ptr<Self>(L, 1);
+            int handle = findHandle(L, 2);
+            if(handle == SpatialHash::InvalidHandle)
+            {
+                luaL_error(L, "Attempt to call plum.SpatialHash:update with a value that was never added.");
+            }
+            h->update(handle, checkRect(L, 3, "update"));
+            return 0;
+        }
+
+        int remove(lua_State* L)
+        {
+            auto h = script::ptr<Self>(L, 1);
+            int handle = findHandle(L, 2);
+            if(handle == SpatialHash::InvalidHandle)
+            {
+                return 0;
+            }
+            h->remove(handle);
+
+            pushTable(L, ValuesAttribute);
+            lua_pushnil(L);
+            lua_rawseti(L, -2, handle + 1);
+            lua_pop(L, 1);
+
+            pushTable(L, HandlesAttribute);
+            lua_pushvalue(L, 2);
+            lua_pushnil(L);
+            lua_rawset(L, -3);
+            lua_pop(L, 1);
+            return 0;
+        }
+
+        int clear(lua_State* L)
+        {
+            auto h = script::ptr<Self>(L, 1);
+            auto w = script::wrapped<Self>(L, 1);
+            h->clear();
+            lua_newtable(L);
+            w->setAttribute(L, ValuesAttribute);
+            lua_newtable(L);
+            w->setAttribute(L, HandlesAttribute);
+            lua_pop(L, 2);
+            return 0;
+        }
+
+        int has(lua_State* L)
+        {
+            script::push(L, findHandle(L, 2) != SpatialHash::InvalidHandle);
+            return 1;
+        }
+
+        int getRect(lua_State* L)
+        {
+            auto h = script::ptr<Self>(L, 1);
+            int handle = findHandle(L, 2);
+            if(handle == SpatialHash::InvalidHandle)
+            {
+                script::push(L, nullptr);
+                return 1;
+            }
+            script::push(L, new Rect(h->getRect(handle)), LUA_NOREF);
+            return 1;
+        }
+
+        // queryRect(rect, [results]) or queryRect(x, y, w, h, [results]). Returns the values touching it and how many there are.
+        int queryRect(lua_State* L)
+        {
+            auto h = script::ptr<Self>(L, 1);
+            int resultIndex = script::is<Rect>(L, 2) ? 3 : 6;
+            found.clear();
+            h->queryRect(checkRect(L, 2, "queryRect"), found);
+            pushResults(L, resultIndex, found);
+            script::push(L, (int) found.size());
+            return 2;
+        }
+
+        // queryPoint(point, [results]) or queryPoint(x, y, [results]).
+        int queryPoint(lua_State* L)
+        {
+            auto h = script::ptr<Self>(L, 1);
+            int resultIndex;
+            double x, y;
+            if(script::is<Point>(L, 2))
+            {
+                auto p = script::ptr<Point>(L, 2);
+                x = p->x;
+                y = p->y;
+                resultIndex = 3;
+            }
+            else
+            {
+                x = script::get<double>(L, 2);
+                y = script::get<double>(L, 3);
+                resultIndex = 4;
+            }
+            checkFinite(L, "queryPoint", x, y);
+            found.clear();
+            h->queryPoint(x, y, found);
+            pushResults(L, resultIndex, found);
+            script::push(L, (int) found.size());
+            return 2;
+        }
+
+        // queryPairs([results]). Every touching pair, flattened as a, b, a, b, ..., and the number of pairs.
+        int queryPairs(lua_State* L)
+        {
+            auto h = script::ptr<Self>(L, 1);
+            pairs.clear();
+            h->queryPairs(pairs);
+
+            found.clear();
+            for(auto it = pairs.begin(), end = pairs.end(); it != end; ++it)
+            {
+                found.push_back(it->first);
+                found.push_back(it->second);
+            }
+            pushResults(L, 2, found);
+            script::push(L, (int) pairs.size());
+            return 2;
+        }
+    }
+
+    namespace script
+    {
+        void initSpatialHashObject(lua_State* L)
+        {
+            luaL_newmetatable(L, meta<Self>());
+            // Duplicate the metatable on the stack.
+            lua_pushvalue(L, -1);
+            // metatable.__index = metatable
+            lua_setfield(L, -2, "__index");
+
+            // Put the members into the metatable.
+            const luaL_Reg functions[] = {
+                {"__gc", gc},
+                {"__len", len},
+                {"__index", index},
+                {"__newindex", newindex},
+                {"__tostring", tostring},
+                {"get_count", get_count},
+                {"get_cellSize", get_cellSize},
+                {"add", add},
+                {"update", update},
+                {"remove", remove},
+                {"clear", clear},
+                {"has", has},
+                {"getRect", getRect},
+                {"queryRect", queryRect},
+                {"queryPoint", queryPoint},
+                {"queryPairs", queryPairs},
+                {nullptr, nullptr},
+            };
+            luaL_setfuncs(L, functions, 0);
+
+            lua_pop(L, 1);
+
+            // Push plum namespace.
+            lua_getglobal(L, "plum");
+
+            // plum.Self = <function create>
+            script::push(L, "SpatialHash");
+            lua_pushcfunction(L, create);
+            lua_settable(L, -3);
+
+            // Pop plum namespace.
+            lua_pop(L, 1);
+        }
+    }
+}
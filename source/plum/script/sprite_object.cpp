@@ -88,62 +88,6 @@ namespace plum
             script::push(L, pixel);
             return 1;
         }
-
-        int get_frameWidth(lua_State* L)
-        {
-            auto spr = script::ptr<Sprite>(L, 1);
-            script::push(L, spr->getFrameWidth());
-            return 1;
-        }
-
-        int set_frameWidth(lua_State* L)
-        {
-            auto spr = script::ptr<Sprite>(L, 1);
-            spr->setFrameWidth(script::get<int>(L, 2));
-            return 0;
-        }
-
-        int get_frameHeight(lua_State* L)
-        {
-            auto spr = script::ptr<Sprite>(L, 1);
-            script::push(L, spr->getFrameHeight());
-            return 1;
-        }
-
-        int set_frameHeight(lua_State* L)
-        {
-            auto spr = script::ptr<Sprite>(L, 1);
-            spr->setFrameHeight(script::get<int>(L, 2));
-            return 0;
-        }
-
-        int get_padding(lua_State* L)
-        {
-            auto spr = script::ptr<Sprite>(L, 1);
-            script::push(L, spr->getPadding());
-            return 1;
-        }
-
-        int set_padding(lua_State* L)
-        {
-            auto spr = script::ptr<Sprite>(L, 1);
-            spr->setPadding(script::get<int>(L, 2));
-            return 0;
-        }
-
-        int get_columns(lua_State* L)
-        {
-            auto spr = script::ptr<Sprite>(L, 1);
-            script::push(L, spr->getColumns());
-            return 1;
-        }
-
-        int set_columns(lua_State* L)
-        {
-            auto spr = script::ptr<Sprite>(L, 1);
-            spr->setColumns(script::get<int>(L, 2));
-            return 0;
-        }
     }
 
     namespace script
@@ -164,14 +108,14 @@ namespace plum
                 {"__tostring", tostring},
                 {"blitFrame", blitFrame},
                 {"getFramePixel", getFramePixel},
-                {"get_frameWidth", get_frameWidth},
-                {"set_frameWidth", set_frameWidth},
-                {"get_frameHeight", get_frameHeight},
-                {"set_frameHeight", set_frameHeight},
-                {"get_padding", get_padding},
-                {"set_padding", set_padding},
-                {"get_columns", get_columns},
-                {"set_columns", set_columns},
+                {"get_frameWidth", script::PropertyAccessor<Self, int, &Self::getFrameWidth, &Self::setFrameWidth>::get},
+                {"set_frameWidth", script::PropertyAccessor<Self, int, &Self::getFrameWidth, &Self::setFrameWidth>::set},
+                {"get_frameHeight", script::PropertyAccessor<Self, int, &Self::getFrameHeight, &Self::setFrameHeight>::get},
+                {"set_frameHeight", script::PropertyAccessor<Self, int, &Self::getFrameHeight, &Self::setFrameHeight>::set},
+                {"get_padding", script::PropertyAccessor<Self, int, &Self::getPadding, &Self::setPadding>::get},
+                {"set_padding", script::PropertyAccessor<Self, int, &Self::getPadding, &Self::setPadding>::set},
+                {"get_columns", script::PropertyAccessor<Self, int, &Self::getColumns, &Self::setColumns>::get},
+                {"set_columns", script::PropertyAccessor<Self, int, &Self::getColumns, &Self::setColumns>::set},
                 {"get_image", get_image},
                 {nullptr, nullptr}
             };
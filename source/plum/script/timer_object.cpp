@@ -21,6 +21,13 @@ namespace plum
         int timerSetField(lua_State* L)
         {
             std::string fieldName(script::get<const char*>(L, 2));
+            if(luaL_getmetafield(L, 1, std::string("set_" + fieldName).c_str()))
+            {
+                lua_pushvalue(L, 1);
+                lua_pushvalue(L, 3);
+                lua_call(L, 2, 0);
+                return 0;
+            }
             if(luaL_getmetafield(L, 1, std::string("get_" + fieldName).c_str()))
             {
                 luaL_error(L, "Attempt to modify readonly field '%s' on plum_timer.", fieldName.c_str());
@@ -55,6 +62,43 @@ namespace plum
             return 1;
         }
 
+        int timerGetAlpha(lua_State* L)
+        {
+            script::push(L, script::instance(L).timer().getAlpha());
+            return 1;
+        }
+
+        int timerGetRate(lua_State* L)
+        {
+            script::push(L, script::instance(L).timer().getRate());
+            return 1;
+        }
+
+        int timerSetRate(lua_State* L)
+        {
+            script::instance(L).timer().setRate(script::get<int>(L, 2));
+            return 0;
+        }
+
+        // Frame times are handed to scripts in milliseconds.
+        int timerGetFrameTime(lua_State* L)
+        {
+            script::push(L, script::instance(L).timer().getFrameTime() / 1000.0);
+            return 1;
+        }
+
+        int timerPercentile(lua_State* L)
+        {
+            script::push(L, script::instance(L).timer().getFrameTimePercentile(script::get<double>(L, 2)) / 1000.0);
+            return 1;
+        }
+
+        template<int Percentile> int timerGetPercentile(lua_State* L)
+        {
+            script::push(L, script::instance(L).timer().getFrameTimePercentile(Percentile) / 1000.0);
+            return 1;
+        }
+
         const luaL_Reg functions[] = {
             { "__index", timerGetField },
             { "__newindex", timerSetField },
@@ -62,6 +106,14 @@ namespace plum
             { "get_time", timerGetTime },
             { "get_gap", timerGetGap },
             { "get_fps", timerGetFPS },
+            { "get_alpha", timerGetAlpha },
+            { "get_rate", timerGetRate },
+            { "set_rate", timerSetRate },
+            { "get_frameTime", timerGetFrameTime },
+            { "get_p50", timerGetPercentile<50> },
+            { "get_p95", timerGetPercentile<95> },
+            { "get_p99", timerGetPercentile<99> },
+            { "percentile", timerPercentile },
             { nullptr, nullptr }
         };
     }